@@ -28,6 +28,90 @@
 
 using namespace arduino;
 
+static inline size_t tx_ring_size(size_t size) {
+	// One slot always stays empty to tell a full ring from an empty one
+	return size == 0 ? 0 : (size + 1 + 31) & ~31;
+}
+
+#ifdef SERIAL_HAS_DMA
+
+#include "PeripheralPins.h"
+
+#define SERIAL_DMA_IRQ_PRIORITY		2
+
+/*
+ * The UARTs routed to the Portenta connectors, each with a fixed pair of DMA1 streams
+ * (DMA2_Stream3 is owned by the camera). UARTs not listed here keep the interrupt driven path.
+ */
+typedef struct {
+	UARTName uart;
+	IRQn_Type uart_irq;
+	uint32_t rx_request;
+	DMA_Stream_TypeDef* rx_stream;
+	IRQn_Type rx_irq;
+	uint32_t tx_request;
+	DMA_Stream_TypeDef* tx_stream;
+	IRQn_Type tx_irq;
+} uart_dma_map_t;
+
+static const uart_dma_map_t uart_dma_map[] = {
+	{ UART_1, USART1_IRQn, DMA_REQUEST_USART1_RX, DMA1_Stream0, DMA1_Stream0_IRQn, DMA_REQUEST_USART1_TX, DMA1_Stream1, DMA1_Stream1_IRQn },
+	{ UART_4, UART4_IRQn,  DMA_REQUEST_UART4_RX,  DMA1_Stream2, DMA1_Stream2_IRQn, DMA_REQUEST_UART4_TX,  DMA1_Stream3, DMA1_Stream3_IRQn },
+	{ UART_7, UART7_IRQn,  DMA_REQUEST_UART7_RX,  DMA1_Stream4, DMA1_Stream4_IRQn, DMA_REQUEST_UART7_TX,  DMA1_Stream5, DMA1_Stream5_IRQn },
+	{ UART_8, UART8_IRQn,  DMA_REQUEST_UART8_RX,  DMA1_Stream6, DMA1_Stream6_IRQn, DMA_REQUEST_UART8_TX,  DMA1_Stream7, DMA1_Stream7_IRQn },
+};
+
+#define UART_DMA_SLOTS		(sizeof(uart_dma_map) / sizeof(uart_dma_map[0]))
+
+static UART* uart_dma_owner[UART_DMA_SLOTS];
+static DMA_HandleTypeDef uart_dma_rx_handle[UART_DMA_SLOTS];
+static DMA_HandleTypeDef uart_dma_tx_handle[UART_DMA_SLOTS];
+
+template<int N> static void uart_dma_uart_irq() {
+	uart_dma_owner[N]->_uart_irq();
+}
+
+template<int N> static void uart_dma_rx_irq() {
+	HAL_DMA_IRQHandler(&uart_dma_rx_handle[N]);
+}
+
+template<int N> static void uart_dma_tx_irq() {
+	HAL_DMA_IRQHandler(&uart_dma_tx_handle[N]);
+}
+
+static const uint32_t uart_dma_uart_vectors[UART_DMA_SLOTS] = {
+	(uint32_t)&uart_dma_uart_irq<0>, (uint32_t)&uart_dma_uart_irq<1>,
+	(uint32_t)&uart_dma_uart_irq<2>, (uint32_t)&uart_dma_uart_irq<3>,
+};
+
+static const uint32_t uart_dma_rx_vectors[UART_DMA_SLOTS] = {
+	(uint32_t)&uart_dma_rx_irq<0>, (uint32_t)&uart_dma_rx_irq<1>,
+	(uint32_t)&uart_dma_rx_irq<2>, (uint32_t)&uart_dma_rx_irq<3>,
+};
+
+static const uint32_t uart_dma_tx_vectors[UART_DMA_SLOTS] = {
+	(uint32_t)&uart_dma_tx_irq<0>, (uint32_t)&uart_dma_tx_irq<1>,
+	(uint32_t)&uart_dma_tx_irq<2>, (uint32_t)&uart_dma_tx_irq<3>,
+};
+
+static void uart_dma_rx_half_cb(DMA_HandleTypeDef* hdma) {
+	((UART*)hdma->Parent)->_dma_rx_event(false);
+}
+
+static void uart_dma_rx_cplt_cb(DMA_HandleTypeDef* hdma) {
+	((UART*)hdma->Parent)->_dma_rx_event(true);
+}
+
+static void uart_dma_tx_cplt_cb(DMA_HandleTypeDef* hdma) {
+	((UART*)hdma->Parent)->_dma_tx_event();
+}
+
+static inline USART_TypeDef* uart_instance(int slot) {
+	return (USART_TypeDef*)uart_dma_map[slot].uart;
+}
+
+#endif
+
 void UART::begin(unsigned long baudrate, uint16_t config) {
 	begin(baudrate);
 	int bits = 8;
@@ -72,6 +156,19 @@ void UART::begin(unsigned long baudrate, uint16_t config) {
 	_serial->format(bits, parity, stop_bits);
 }
 
+void UART::begin(unsigned long baudrate, uint16_t config, size_t rx_buffer_size, size_t tx_buffer_size) {
+	begin(baudrate, config);
+	if (tx_ring_size(tx_buffer_size) != _tx_size) {
+		tx_end();
+		tx_begin(tx_buffer_size);
+	}
+#ifdef SERIAL_HAS_DMA
+	if (_rx_dma == NULL && rx_buffer_size > 0) {
+		dma_rx_begin(rx_buffer_size);
+	}
+#endif
+}
+
 void UART::begin(unsigned long baudrate) {
 	if (_serial == NULL) {
 		_serial = new mbed::UnbufferedSerial(tx, rx, baudrate);
@@ -81,6 +178,14 @@ void UART::begin(unsigned long baudrate) {
 	if (rts != NC) {
 		_serial->set_flow_control(mbed::SerialBase::Flow::RTSCTS, rts, cts);
 	}
+	if (_tx_buf == NULL) {
+		tx_begin(SERIAL_TX_BUFFER_SIZE);
+	}
+#ifdef SERIAL_HAS_DMA
+	if (_rx_dma != NULL) {
+		return;
+	}
+#endif
 	if (_serial != NULL) {
 		_serial->attach(mbed::callback(this, &UART::on_rx), mbed::SerialBase::RxIrq);
 	}
@@ -90,11 +195,345 @@ void UART::on_rx() {
 	while(_serial->readable()) {
 		char c;
 		_serial->read(&c, 1);
+		if (rx_buffer.availableForStore() == 0) {
+			_rx_overruns++;
+		}
 		rx_buffer.store_char(c);
 	}
+	if (_rx_cb) {
+		_rx_cb();
+	}
+}
+
+void UART::onReceive(mbed::Callback<void()> cb) {
+	_rx_cb = cb;
+}
+
+uint32_t UART::rxOverruns() {
+	return _rx_overruns;
+}
+
+void UART::onWriteComplete(mbed::Callback<void()> cb) {
+	_tx_cb = cb;
+}
+
+bool UART::tx_begin(size_t size) {
+	if (size == 0) {
+		return true;
+	}
+	size = tx_ring_size(size);
+	_tx_alloc = new uint8_t[size + 31];
+	if (_tx_alloc == NULL) {
+		return false;
+	}
+	// Cache line aligned, so cleaning a chunk before a DMA transfer never spills onto other data
+	_tx_buf = (uint8_t*)(((uintptr_t)_tx_alloc + 31) & ~31);
+	_tx_size = size;
+	_tx_head = 0;
+	_tx_tail = 0;
+	_tx_active = false;
+#ifdef SERIAL_HAS_DMA
+	dma_tx_begin();
+#endif
+	return true;
+}
+
+void UART::tx_end() {
+	if (_tx_buf == NULL) {
+		return;
+	}
+	flush();
+#ifdef SERIAL_HAS_DMA
+	dma_tx_end();
+#endif
+	delete[] _tx_alloc;
+	_tx_alloc = NULL;
+	_tx_buf = NULL;
+	_tx_size = 0;
+}
+
+size_t UART::tx_space() {
+	return (_tx_tail + _tx_size - _tx_head - 1) % _tx_size;
+}
+
+void UART::tx_kick() {
+	core_util_critical_section_enter();
+	if (!_tx_active && _tx_head != _tx_tail) {
+		_tx_active = true;
+#ifdef SERIAL_HAS_DMA
+		if (_tx_dma != NULL) {
+			dma_tx_start();
+			core_util_critical_section_exit();
+			return;
+		}
+#endif
+		_serial->attach(mbed::callback(this, &UART::on_tx), mbed::SerialBase::TxIrq);
+	}
+	core_util_critical_section_exit();
+}
+
+void UART::on_tx() {
+	while (_tx_tail != _tx_head && _serial->writeable()) {
+		_serial->write(&_tx_buf[_tx_tail], 1);
+		_tx_tail = (_tx_tail + 1) % _tx_size;
+	}
+	if (_tx_tail == _tx_head) {
+		_serial->attach(mbed::Callback<void()>(), mbed::SerialBase::TxIrq);
+		_tx_active = false;
+		if (_tx_cb) {
+			_tx_cb();
+		}
+	}
+}
+
+#ifdef SERIAL_HAS_DMA
+
+int UART::dma_claim() {
+	if (_dma_slot >= 0) {
+		return _dma_slot;
+	}
+	UARTName uart = (UARTName)pinmap_peripheral(rx, PinMap_UART_RX);
+	for (size_t i = 0; i < UART_DMA_SLOTS; i++) {
+		if (uart_dma_map[i].uart == uart && uart_dma_owner[i] == NULL) {
+			uart_dma_owner[i] = this;
+			_dma_slot = i;
+			__HAL_RCC_DMA1_CLK_ENABLE();
+			break;
+		}
+	}
+	return _dma_slot;
+}
+
+void UART::dma_release() {
+	if (_dma_slot >= 0 && _rx_dma == NULL && _tx_dma == NULL) {
+		uart_dma_owner[_dma_slot] = NULL;
+		_dma_slot = -1;
+	}
+}
+
+bool UART::dma_tx_begin() {
+	int slot = dma_claim();
+	if (slot < 0) {
+		return false;
+	}
+
+	DMA_HandleTypeDef* hdma = &uart_dma_tx_handle[slot];
+	hdma->Instance                 = uart_dma_map[slot].tx_stream;
+	hdma->Init.Request             = uart_dma_map[slot].tx_request;
+	hdma->Init.Direction           = DMA_MEMORY_TO_PERIPH;
+	hdma->Init.PeriphInc           = DMA_PINC_DISABLE;
+	hdma->Init.MemInc              = DMA_MINC_ENABLE;
+	hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+	hdma->Init.Mode                = DMA_NORMAL;
+	hdma->Init.Priority            = DMA_PRIORITY_MEDIUM;
+	hdma->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+	hdma->Parent                   = this;
+	HAL_DMA_Init(hdma);
+	hdma->XferCpltCallback = uart_dma_tx_cplt_cb;
+	_tx_dma = hdma;
+	_tx_dma_len = 0;
+
+	NVIC_SetVector(uart_dma_map[slot].tx_irq, uart_dma_tx_vectors[slot]);
+	HAL_NVIC_SetPriority(uart_dma_map[slot].tx_irq, SERIAL_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(uart_dma_map[slot].tx_irq);
+
+	uart_instance(slot)->CR3 |= USART_CR3_DMAT;
+	return true;
+}
+
+void UART::dma_tx_end() {
+	if (_tx_dma == NULL) {
+		return;
+	}
+	uart_instance(_dma_slot)->CR3 &= ~USART_CR3_DMAT;
+	HAL_NVIC_DisableIRQ(uart_dma_map[_dma_slot].tx_irq);
+	HAL_DMA_Abort(_tx_dma);
+	HAL_DMA_DeInit(_tx_dma);
+	_tx_dma = NULL;
+	_tx_active = false;
+	dma_release();
+}
+
+void UART::dma_tx_start() {
+	size_t head = _tx_head;
+	size_t len = head >= _tx_tail ? head - _tx_tail : _tx_size - _tx_tail;
+	if (len == 0) {
+		_tx_active = false;
+		return;
+	}
+	uint8_t* src = &_tx_buf[_tx_tail];
+#ifdef CORE_CM7
+	uint32_t start = (uint32_t)src & ~31;
+	SCB_CleanDCache_by_Addr((uint32_t*)start, ((uint32_t)src + len - start + 31) & ~31);
+#endif
+	_tx_dma_len = len;
+	HAL_DMA_Start_IT(_tx_dma, (uint32_t)src, (uint32_t)&uart_instance(_dma_slot)->TDR, len);
+}
+
+void UART::_dma_tx_event() {
+	_tx_tail = (_tx_tail + _tx_dma_len) % _tx_size;
+	_tx_dma_len = 0;
+	if (_tx_tail != _tx_head) {
+		dma_tx_start();
+		return;
+	}
+	_tx_active = false;
+	if (_tx_cb) {
+		_tx_cb();
+	}
+}
+
+bool UART::dma_rx_begin(size_t size) {
+	int slot = dma_claim();
+	if (slot < 0) {
+		return false;
+	}
+
+	// Whole cache lines, so invalidating the ring never touches a neighbour's data
+	size = (size + 31) & ~31;
+	_rx_dma_alloc = new uint8_t[size + 31];
+	if (_rx_dma_alloc == NULL) {
+		// Give the streams back, unless the transmit side is using them
+		dma_release();
+		return false;
+	}
+	_rx_dma_buf = (uint8_t*)(((uintptr_t)_rx_dma_alloc + 31) & ~31);
+	_rx_dma_size = size;
+	_rx_dma_tail = 0;
+	_rx_dma_consumed = 0;
+	_rx_dma_wraps = 0;
+	_rx_dma_overrun = false;
+
+	// Stop mbed from servicing RXNE, the DMA reads RDR from now on
+	_serial->attach(mbed::Callback<void()>(), mbed::SerialBase::RxIrq);
+
+	USART_TypeDef* instance = uart_instance(slot);
+
+	DMA_HandleTypeDef* hdma = &uart_dma_rx_handle[slot];
+	hdma->Instance                 = uart_dma_map[slot].rx_stream;
+	hdma->Init.Request             = uart_dma_map[slot].rx_request;
+	hdma->Init.Direction           = DMA_PERIPH_TO_MEMORY;
+	hdma->Init.PeriphInc           = DMA_PINC_DISABLE;
+	hdma->Init.MemInc              = DMA_MINC_ENABLE;
+	hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+	hdma->Init.Mode                = DMA_CIRCULAR;
+	hdma->Init.Priority            = DMA_PRIORITY_HIGH;
+	hdma->Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+	hdma->Parent                   = this;
+	HAL_DMA_Init(hdma);
+	hdma->XferHalfCpltCallback = uart_dma_rx_half_cb;
+	hdma->XferCpltCallback     = uart_dma_rx_cplt_cb;
+	_rx_dma = hdma;
+
+	NVIC_SetVector(uart_dma_map[slot].rx_irq, uart_dma_rx_vectors[slot]);
+	HAL_NVIC_SetPriority(uart_dma_map[slot].rx_irq, SERIAL_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(uart_dma_map[slot].rx_irq);
+
+	HAL_DMA_Start_IT(hdma, (uint32_t)&instance->RDR, (uint32_t)_rx_dma_buf, _rx_dma_size);
+
+	// Idle line detection ends a burst without waiting for the next half/full ring event
+	instance->ICR = USART_ICR_IDLECF | USART_ICR_ORECF;
+	instance->CR3 |= USART_CR3_DMAR;
+	instance->CR1 |= USART_CR1_IDLEIE;
+
+	NVIC_SetVector(uart_dma_map[slot].uart_irq, uart_dma_uart_vectors[slot]);
+	HAL_NVIC_SetPriority(uart_dma_map[slot].uart_irq, SERIAL_DMA_IRQ_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(uart_dma_map[slot].uart_irq);
+	return true;
+}
+
+void UART::dma_rx_end() {
+	if (_rx_dma == NULL) {
+		return;
+	}
+	USART_TypeDef* instance = uart_instance(_dma_slot);
+	instance->CR1 &= ~USART_CR1_IDLEIE;
+	instance->CR3 &= ~USART_CR3_DMAR;
+	HAL_NVIC_DisableIRQ(uart_dma_map[_dma_slot].uart_irq);
+	HAL_NVIC_DisableIRQ(uart_dma_map[_dma_slot].rx_irq);
+	HAL_DMA_Abort(_rx_dma);
+	HAL_DMA_DeInit(_rx_dma);
+	_rx_dma = NULL;
+	dma_release();
+	delete[] _rx_dma_alloc;
+	_rx_dma_alloc = NULL;
+	_rx_dma_buf = NULL;
+	_rx_dma_size = 0;
+}
+
+void UART::_uart_irq() {
+	USART_TypeDef* instance = uart_instance(_dma_slot);
+	uint32_t isr = instance->ISR;
+	if (isr & USART_ISR_ORE) {
+		instance->ICR = USART_ICR_ORECF;
+		_rx_overruns++;
+	}
+	if (isr & USART_ISR_IDLE) {
+		instance->ICR = USART_ICR_IDLECF;
+		if (_rx_cb) {
+			_rx_cb();
+		}
+	}
+}
+
+void UART::_dma_rx_event(bool complete) {
+	uint32_t produced;
+	if (complete) {
+		_rx_dma_wraps++;
+		produced = _rx_dma_wraps * _rx_dma_size;
+	} else {
+		produced = _rx_dma_wraps * _rx_dma_size + _rx_dma_size / 2;
+	}
+	// The DMA is about to overwrite bytes the reader has not consumed yet
+	if (produced - _rx_dma_consumed > _rx_dma_size) {
+		_rx_dma_overrun = true;
+	}
+	if (_rx_cb) {
+		_rx_cb();
+	}
+}
+
+size_t UART::dma_rx_head() {
+	size_t head = _rx_dma_size - __HAL_DMA_GET_COUNTER(_rx_dma);
+	return head == _rx_dma_size ? 0 : head;
+}
+
+// Bytes the DMA has written since the ring was started, and where it writes next
+uint32_t UART::dma_rx_produced(size_t* head_out) {
+	core_util_critical_section_enter();
+	uint32_t wraps = _rx_dma_wraps;
+	size_t before = dma_rx_head();
+	bool pending = __HAL_DMA_GET_FLAG(_rx_dma, __HAL_DMA_GET_TC_FLAG_INDEX(_rx_dma));
+	size_t head = dma_rx_head();
+	if (pending || head < before) {
+		// The stream wrapped but its interrupt has not run yet
+		wraps++;
+	}
+	core_util_critical_section_exit();
+	if (head_out != NULL) {
+		*head_out = head;
+	}
+	return wraps * _rx_dma_size + head;
 }
 
+void UART::dma_rx_resync() {
+	// Everything in the ring may have been overwritten: drop it and restart from the write position
+	core_util_critical_section_enter();
+	_rx_overruns++;
+	_rx_dma_consumed = dma_rx_produced(&_rx_dma_tail);
+	_rx_dma_overrun = false;
+	core_util_critical_section_exit();
+}
+
+#endif
+
 void UART::end() {
+	tx_end();
+#ifdef SERIAL_HAS_DMA
+	dma_rx_end();
+#endif
 	if (_serial != NULL) {
 		delete _serial;
 		_serial = NULL;
@@ -102,32 +541,158 @@ void UART::end() {
 }
 
 int UART::available() {
+#ifdef SERIAL_HAS_DMA
+	if (_rx_dma != NULL) {
+		// From the byte counts, so that a full ring is not taken for an empty one
+		uint32_t count = dma_rx_produced() - _rx_dma_consumed;
+		if (_rx_dma_overrun || count > _rx_dma_size) {
+			dma_rx_resync();
+			return 0;
+		}
+		return count;
+	}
+#endif
 	return rx_buffer.available();
 }
 
 int UART::peek() {
+#ifdef SERIAL_HAS_DMA
+	if (_rx_dma != NULL) {
+		if (available() == 0) {
+			return -1;
+		}
+#ifdef CORE_CM7
+		SCB_InvalidateDCache_by_Addr((uint32_t*)((uint32_t)&_rx_dma_buf[_rx_dma_tail] & ~31), 32);
+#endif
+		return _rx_dma_buf[_rx_dma_tail];
+	}
+#endif
 	return rx_buffer.peek();
 }
 
 int UART::read() {
+#ifdef SERIAL_HAS_DMA
+	if (_rx_dma != NULL) {
+		uint8_t c;
+		return read(&c, 1) == 1 ? c : -1;
+	}
+#endif
 	return rx_buffer.read_char();
 }
 
+int UART::read(uint8_t* buf, size_t len) {
+#ifdef SERIAL_HAS_DMA
+	if (_rx_dma != NULL) {
+		size_t count = available();
+		if (count > len) {
+			count = len;
+		}
+		size_t done = 0;
+		while (done < count) {
+			size_t chunk = count - done;
+			if (chunk > _rx_dma_size - _rx_dma_tail) {
+				chunk = _rx_dma_size - _rx_dma_tail;
+			}
+			uint8_t* src = &_rx_dma_buf[_rx_dma_tail];
+#ifdef CORE_CM7
+			// The ring is only ever written by the DMA, so dropping these lines loses nothing
+			uint32_t start = (uint32_t)src & ~31;
+			SCB_InvalidateDCache_by_Addr((uint32_t*)start, ((uint32_t)src + chunk - start + 31) & ~31);
+#endif
+			memcpy(&buf[done], src, chunk);
+			done += chunk;
+			_rx_dma_tail = (_rx_dma_tail + chunk) % _rx_dma_size;
+		}
+		_rx_dma_consumed += count;
+		return count;
+	}
+#endif
+	size_t count = 0;
+	while (count < len && rx_buffer.available()) {
+		buf[count++] = rx_buffer.read_char();
+	}
+	return count;
+}
+
 void UART::flush() {
+	if (_serial == NULL) {
+		return;
+	}
+	while (_tx_active) {
+		yield();
+	}
+#ifdef SERIAL_HAS_DMA
+	// The ring is drained, now wait for the stop bit of the last byte to leave the shift register
+	// (TC), not just for the data register to empty (TXE), so RS-485 direction and sleep are safe
+	USART_TypeDef* instance = (_dma_slot >= 0) ? uart_instance(_dma_slot) : (USART_TypeDef*)pinmap_peripheral(tx, PinMap_UART_TX);
+	if (instance != NULL) {
+		while (!(instance->ISR & USART_ISR_TC)) {}
+		return;
+	}
+#endif
+	// The nRF52 UARTE only reports writeable once its last transfer has ended (ENDTX)
+	while (!_serial->writeable()) {}
+}
 
+int UART::availableForWrite() {
+	if (_tx_buf == NULL) {
+		return 0;
+	}
+	return tx_space();
 }
 
 size_t UART::write(uint8_t c) {
-	while (!_serial->writeable()) {}
-	int ret = _serial->write(&c, 1);
-	return ret == -1 ? 0 : 1;
+	return write(&c, 1);
 }
 
 size_t UART::write(const uint8_t* c, size_t len) {
-	while (!_serial->writeable()) {}
-	_serial->set_blocking(true);
-	int ret = _serial->write(c, len);
-	return ret == -1 ? 0 : len;
+	if (_tx_buf == NULL) {
+		while (!_serial->writeable()) {}
+		_serial->set_blocking(true);
+		int ret = _serial->write(c, len);
+		return ret == -1 ? 0 : len;
+	}
+
+	// Threads take turns on the whole write so their data does not interleave, an interrupt
+	// handler cannot wait for the mutex and reserves each chunk with interrupts held off instead
+	bool in_isr = core_util_is_isr_active() || core_util_in_critical_section();
+	if (!in_isr) {
+		_tx_mutex.lock();
+	}
+	size_t written = 0;
+	while (written < len) {
+		if (in_isr) {
+			core_util_critical_section_enter();
+		}
+		size_t space = tx_space();
+		if (space == 0) {
+			// Nobody can drain the ring while we hold off its interrupt, drop what does not fit
+			if (in_isr) {
+				core_util_critical_section_exit();
+				break;
+			}
+			yield();
+			continue;
+		}
+		size_t chunk = len - written;
+		if (chunk > space) {
+			chunk = space;
+		}
+		if (chunk > _tx_size - _tx_head) {
+			chunk = _tx_size - _tx_head;
+		}
+		memcpy(&_tx_buf[_tx_head], &c[written], chunk);
+		_tx_head = (_tx_head + chunk) % _tx_size;
+		if (in_isr) {
+			core_util_critical_section_exit();
+		}
+		written += chunk;
+		tx_kick();
+	}
+	if (!in_isr) {
+		_tx_mutex.unlock();
+	}
+	return written;
 }
 
 void UART::block_tx(int _a) {
@@ -24,9 +24,19 @@
 #include "Arduino.h"
 #include "api/HardwareSerial.h"
 #include "mbed/drivers/UnbufferedSerial.h"
+#include "mbed/rtos/Mutex.h"
 
 #ifdef __cplusplus
 
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE	256
+#endif
+
+#if defined(ARDUINO_PORTENTA_H7_M7) || defined(ARDUINO_PORTENTA_H7_M4)
+#define SERIAL_HAS_DMA		1
+struct __DMA_HandleTypeDef;
+#endif
+
 #ifndef __ARDUINO_UART_IMPLEMENTATION__
 #define __ARDUINO_UART_IMPLEMENTATION__
 
@@ -37,18 +47,73 @@ class UART : public HardwareSerial {
 		UART(int _tx, int _rx, int _rts, int _cts) : tx((PinName)_tx), rx((PinName)_rx), rts((PinName)_rts), cts((PinName)_cts) {};
 		void begin(unsigned long);
 		void begin(unsigned long baudrate, uint16_t config);
+		// Receive through a DMA circular buffer of rx_buffer_size bytes instead of one interrupt per byte,
+		// tx_buffer_size sets the transmit queue (0 makes write() block until the data is sent)
+		void begin(unsigned long baudrate, uint16_t config, size_t rx_buffer_size, size_t tx_buffer_size = SERIAL_TX_BUFFER_SIZE);
 		void end();
 		int available(void);
 		int peek(void);
 		int read(void);
+		int read(uint8_t* buf, size_t len);
+		// Called (from interrupt context) when the line goes idle or the DMA ring is half full
+		void onReceive(mbed::Callback<void()> cb);
+		uint32_t rxOverruns();
+		// Called (from interrupt context) when the transmit queue has been fully drained
+		void onWriteComplete(mbed::Callback<void()> cb);
 		void flush(void);
+		int availableForWrite(void);
 		size_t write(uint8_t c);
 		size_t write(const uint8_t*, size_t);
 		using Print::write; // pull in write(str) and write(buf, size) from Print
 		operator bool();
 
+#ifdef SERIAL_HAS_DMA
+		// Invoked by the UART/DMA interrupt trampolines, not meant to be called by sketches
+		void _uart_irq();
+		void _dma_rx_event(bool complete);
+		void _dma_tx_event();
+#endif
+
 	private:
 		void on_rx();
+		void on_tx();
+		bool tx_begin(size_t size);
+		void tx_end();
+		size_t tx_space();
+		void tx_kick();
+#ifdef SERIAL_HAS_DMA
+		int dma_claim();
+		void dma_release();
+		bool dma_tx_begin();
+		void dma_tx_end();
+		void dma_tx_start();
+		__DMA_HandleTypeDef* _tx_dma = NULL;
+		size_t _tx_dma_len = 0;
+		bool dma_rx_begin(size_t size);
+		void dma_rx_end();
+		size_t dma_rx_head();
+		uint32_t dma_rx_produced(size_t* head_out = NULL);
+		void dma_rx_resync();
+		int _dma_slot = -1;
+		__DMA_HandleTypeDef* _rx_dma = NULL;
+		uint8_t* _rx_dma_alloc = NULL;
+		uint8_t* _rx_dma_buf = NULL;
+		size_t _rx_dma_size = 0;
+		size_t _rx_dma_tail = 0;
+		uint32_t _rx_dma_consumed = 0;
+		volatile uint32_t _rx_dma_wraps = 0;
+		volatile bool _rx_dma_overrun = false;
+#endif
+		uint8_t* _tx_alloc = NULL;
+		uint8_t* _tx_buf = NULL;
+		size_t _tx_size = 0;
+		volatile size_t _tx_head = 0;
+		volatile size_t _tx_tail = 0;
+		volatile bool _tx_active = false;
+		rtos::Mutex _tx_mutex;
+		mbed::Callback<void()> _tx_cb;
+		mbed::Callback<void()> _rx_cb;
+		uint32_t _rx_overruns = 0;
 		void block_tx(int);
 		bool _block;
 		// See https://github.com/ARMmbed/mbed-os/blob/f5b5989fc81c36233dbefffa1d023d1942468d42/targets/TARGET_NORDIC/TARGET_NRF5x/TARGET_NRF52/serial_api.c#L76
@@ -60,6 +60,28 @@ uint32_t arduino::internal::PluggableUSBModule::write_finish(usb_ep_t endpoint)
     return PluggableUSBD().write_finish(endpoint);
 }
 
+void arduino::internal::PluggableUSBModule::sof_enable() {
+    lock();
+    if (!sofEnabled) {
+        sofEnabled = true;
+        if (PluggableUSBD().sofUsers++ == 0) {
+            PluggableUSBD().sof_enable();
+        }
+    }
+    unlock();
+}
+
+void arduino::internal::PluggableUSBModule::sof_disable() {
+    lock();
+    if (sofEnabled) {
+        sofEnabled = false;
+        if (--PluggableUSBD().sofUsers == 0) {
+            PluggableUSBD().sof_disable();
+        }
+    }
+    unlock();
+}
+
 arduino::PluggableUSBDevice::PluggableUSBDevice(uint16_t vendor_id, uint16_t product_id)
     : USBDevice(get_usb_phy(), vendor_id, product_id, 1 << 8)
 {
@@ -182,6 +204,16 @@ void arduino::PluggableUSBDevice::callback_set_interface(uint16_t interface, uin
     complete_set_interface(true);
 }
 
+void arduino::PluggableUSBDevice::callback_sof(int frame_number)
+{
+    arduino::internal::PluggableUSBModule* node;
+    for (node = rootNode; node; node = node->next) {
+        if (node->sofEnabled) {
+            node->callback_sof(frame_number);
+        }
+    }
+}
+
 const uint8_t *arduino::PluggableUSBDevice::device_desc()
 {
     uint8_t ep0_size = endpoint_max_packet_size(0x00);
@@ -47,6 +47,8 @@ public:
     uint32_t read_finish(usb_ep_t endpoint);
     bool write_start(usb_ep_t endpoint, uint8_t *buffer, uint32_t size);
     uint32_t write_finish(usb_ep_t endpoint);
+    void sof_enable();
+    void sof_disable();
 
 protected:
     virtual const uint8_t *configuration_desc(uint8_t index);
@@ -56,6 +58,11 @@ protected:
     virtual bool callback_request_xfer_done(const USBDevice::setup_packet_t *setup, bool aborted);
     virtual bool callback_set_configuration(uint8_t configuration);
     virtual void callback_set_interface(uint16_t interface, uint8_t alternate);
+    /*
+    * Called on every start of frame while sof_enable() is in effect
+    * Warning: Called in ISR context
+    */
+    virtual void callback_sof(int frame_number) {};
     virtual void init(EndpointResolver& resolver);
     virtual const uint8_t *string_iinterface_desc();
     virtual uint8_t getProductVersion() = 0;
@@ -66,6 +73,8 @@ protected:
 
     arduino::internal::PluggableUSBModule *next = NULL;
 
+    bool sofEnabled = false;
+
     friend class ::arduino::PluggableUSBDevice;
 };
 }
@@ -194,6 +203,7 @@ protected:
     virtual void callback_request_xfer_done(const setup_packet_t *setup, bool aborted);
     virtual void callback_set_configuration(uint8_t configuration);
     virtual void callback_set_interface(uint16_t interface, uint8_t alternate);
+    virtual void callback_sof(int frame_number);
 
 private:
     void init();
@@ -205,6 +215,8 @@ private:
 
     uint8_t lastIf;
     internal::PluggableUSBModule* rootNode;
+    // Modules that called sof_enable(), the interrupt is on while there are any
+    uint8_t sofUsers = 0;
     friend class ::arduino::internal::PluggableUSBModule;
 };
 }
@@ -47,6 +47,21 @@
 
 #define MAX_CALLBACKS_ON_IRQ    4
 
+// Room for a few packets, so the endpoint is not held up while the sketch reads
+#ifndef USBSERIAL_RX_BUFFER_SIZE
+#if CDC_MAX_PACKET_SIZE > 64
+#define USBSERIAL_RX_BUFFER_SIZE    (2 * CDC_MAX_PACKET_SIZE)
+#else
+#define USBSERIAL_RX_BUFFER_SIZE    256
+#endif
+#endif
+
+// Microseconds a partial packet waits for more data before it is sent, it
+// goes out on the first start of frame after that
+#ifndef USBSERIAL_TX_FLUSH_US
+#define USBSERIAL_TX_FLUSH_US       1000
+#endif
+
 namespace arduino {
 
 
@@ -231,48 +246,54 @@ public:
     }
 
     int read(void) {
-        onInterrupt();
-        return rx_buffer.read_char();
+        uint8_t c;
+        return (read(&c, 1) == 1) ? c : -1;
     }
 
-    void flush(void) {}
+    /**
+     * Read what is available, without waiting
+     *
+     * @returns the number of bytes read
+     */
+    int read(uint8_t *buf, size_t size);
+
+    /**
+     * Send the bytes that are waiting for a full packet
+     */
+    void flush(void);
 
+    /**
+     * Writes are collected into packets, a packet is sent when it is full,
+     * on flush(), or USBSERIAL_TX_FLUSH_US after its first byte
+     */
     size_t write(uint8_t c) {
-        if (!connected()) {
-            return 0;
-        }
-        return _putc(c);
+        return write(&c, 1);
     }
 
-    size_t write(const uint8_t* buf, size_t size) {
-        if (!connected()) {
-            return 0;
-        }
-        size_t sent = 0;
-        while (sent < size) {
-            size_t to_send = (size - sent) > CDC_MAX_PACKET_SIZE ? CDC_MAX_PACKET_SIZE : (size - sent);
-            send((uint8_t*)&buf[sent], to_send);
-            sent += to_send;
-        }
-        return sent;
-    }
+    size_t write(const uint8_t* buf, size_t size);
     using Print::write; // pull in write(str) and write(buf, size) from Print
 
     operator bool() {
+        if (connected()) {
+            return true;
+        }
         // call delay() to force rescheduing during while !Serial pattern
         delay(1);
-        return connected();
+        return false;
     }
 
 private:
-    RingBufferN<256> rx_buffer;
+    RingBufferN<USBSERIAL_RX_BUFFER_SIZE> rx_buffer;
     rtos::Thread t;
 
-    void onInterrupt() {
-        while (rx_buffer.availableForStore() && _available()) {
-            rx_buffer.store_char(_getc());
-        }
-    }
+    void onInterrupt();
+    bool sendTxPacket();
+
+    // The packet being collected, it is handed to USBCDC when it is sent
+    uint8_t _tx_packet[CDC_MAX_PACKET_SIZE];
+    uint32_t _tx_packet_size = 0;
+    bool _tx_packet_sending = false;    // A thread is waiting for USBCDC to take it
+    unsigned long _tx_packet_time = 0;  // micros() when the packet got its first byte
 
 protected:
     virtual void data_rx();
@@ -284,6 +305,7 @@ protected:
             _settings_changed_callback(baud, bits, parity, stop);
         }
     }
+    virtual void callback_sof(int frame_number);
 
 private:
     void (*_settings_changed_callback)(int baud, int bits, int parity, int stop);
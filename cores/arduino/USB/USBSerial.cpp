@@ -73,13 +73,127 @@ void USBSerial::begin(unsigned long) {
 
 int USBSerial::_putc(int c)
 {
-    if (send((uint8_t *)&c, 1)) {
+    // Through the packet, so it keeps its place among the other writes
+    uint8_t b = c;
+    if (write(&b, 1) == 1) {
         return c;
     } else {
         return -1;
     }
 }
 
+size_t USBSerial::write(const uint8_t* buf, size_t size)
+{
+    if (!connected()) {
+        return 0;
+    }
+
+    size_t written = 0;
+    USBCDC::lock();
+    while (written < size) {
+        if (_tx_packet_sending) {
+            // Another thread is sending the full packet
+            USBCDC::unlock();
+            delay(1);
+            USBCDC::lock();
+            continue;
+        }
+
+        uint32_t n = CDC_MAX_PACKET_SIZE - _tx_packet_size;
+        if (n > size - written) {
+            n = size - written;
+        }
+        if (_tx_packet_size == 0) {
+            _tx_packet_time = micros();
+        }
+        memcpy(&_tx_packet[_tx_packet_size], &buf[written], n);
+        _tx_packet_size += n;
+        written += n;
+
+        if (_tx_packet_size == CDC_MAX_PACKET_SIZE && !sendTxPacket()) {
+            // The packet is dropped, and with it the part of buf it held
+            written -= n;
+            break;
+        }
+    }
+    if (_tx_packet_size > 0) {
+        // The start of frame interrupt sends what is left
+        sof_enable();
+    }
+    USBCDC::unlock();
+    return written;
+}
+
+/*
+* Hand the packet to USBCDC, waiting while the previous one is on the bus.
+* Called locked, the lock is released while it waits.
+*/
+bool USBSerial::sendTxPacket()
+{
+    USBCDC::assert_locked();
+
+    _tx_packet_sending = true;
+    USBCDC::unlock();
+
+    bool ret = send(_tx_packet, _tx_packet_size);
+
+    USBCDC::lock();
+    _tx_packet_size = 0;
+    _tx_packet_sending = false;
+    return ret;
+}
+
+void USBSerial::flush()
+{
+    USBCDC::lock();
+    while (_tx_packet_sending) {
+        USBCDC::unlock();
+        delay(1);
+        USBCDC::lock();
+    }
+    if (_tx_packet_size > 0) {
+        sendTxPacket();
+    }
+    USBCDC::unlock();
+}
+
+/*
+* Sends a partial packet once it has waited USBSERIAL_TX_FLUSH_US. Start of
+* frame comes every 1ms at full speed and every 125us at high speed.
+* Warning: Called in ISR
+*/
+void USBSerial::callback_sof(int frame_number)
+{
+    USBCDC::assert_locked();
+
+    if (_tx_packet_sending) {
+        return;
+    }
+    if (!_terminal_connected) {
+        _tx_packet_size = 0;
+    }
+    if (_tx_packet_size == 0) {
+        sof_disable();
+        return;
+    }
+
+    if (micros() - _tx_packet_time < USBSERIAL_TX_FLUSH_US) {
+        return;
+    }
+    // Writes that are already waiting go first, then this is tried again
+    if (_tx_in_progress || !_tx_list.empty()) {
+        return;
+    }
+
+    uint32_t actual = 0;
+    send_nb(_tx_packet, _tx_packet_size, &actual, true);
+    _tx_packet_size -= actual;
+    memmove(_tx_packet, &_tx_packet[actual], _tx_packet_size);
+    if (_tx_packet_size == 0) {
+        sof_disable();
+    }
+}
+
 int USBSerial::_getc()
 {
     uint8_t c = 0;
@@ -104,6 +218,52 @@ void USBSerial::data_rx()
     }
 }
 
+/*
+* Move the received packet into rx_buffer, as much of it as fits.
+* The endpoint reads the next packet once this one is all taken.
+*/
+void USBSerial::onInterrupt()
+{
+    USBCDC::lock();
+
+    if (_terminal_connected && !_rx_in_progress && _rx_size > 0) {
+        uint32_t n = rx_buffer.availableForStore();
+        if (n > _rx_size) {
+            n = _rx_size;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            rx_buffer.store_char(_rx_buf[i]);
+        }
+        _rx_buf += n;
+        _rx_size -= n;
+        if (_rx_size == 0) {
+            _receive_isr_start();
+        }
+    }
+
+    USBCDC::unlock();
+}
+
+int USBSerial::read(uint8_t *buf, size_t size)
+{
+    size_t n = 0;
+
+    // rx_buffer is filled in the interrupt too
+    USBCDC::lock();
+    while (n < size) {
+        if (!rx_buffer.available()) {
+            onInterrupt();
+            if (!rx_buffer.available()) {
+                break;
+            }
+        }
+        buf[n++] = rx_buffer.read_char();
+    }
+    USBCDC::unlock();
+
+    return n;
+}
+
 uint8_t USBSerial::_available()
 {
     USBCDC::lock();
@@ -27,14 +27,34 @@
 #include "TLSSocket.h"
 #include "TCPSocket.h"
 
+// Bytes write() collects to send together, one TCP segment on a 1500 bytes MTU
+#ifndef ETHERNET_CLIENT_TX_BUFFER_SIZE
+#define ETHERNET_CLIENT_TX_BUFFER_SIZE  1460
+#endif
+
+// Milliseconds written data waits for more before it is sent anyway
+#ifndef ETHERNET_CLIENT_FLUSH_DELAY
+#define ETHERNET_CLIENT_FLUSH_DELAY     5
+#endif
+
 namespace arduino {
 
+class EthernetServer;
+
 class EthernetClient : public arduino::Client {
 
 public:
   EthernetClient();
+  EthernetClient(const EthernetClient& other);
+  EthernetClient& operator=(const EthernetClient& other);
   ~EthernetClient() {
-    stop();
+    // A client handed out by EthernetServer::available() stays open in the server
+    if (_server == NULL) {
+      stop();
+    } else {
+      flush();
+      freeTx();
+    }
   }
 
   uint8_t status();
@@ -54,7 +74,7 @@ public:
   void stop();
   uint8_t connected();
   operator bool() {
-    return sock != NULL;
+    return attached();
   }
 
   void setSocket(Socket* _sock) {
@@ -77,11 +97,38 @@ protected:
 private:
   static uint16_t _srcport;
   Socket* sock;
-  RingBufferN<256> rxBuffer;
+  // Received data not read yet, from _rx_pos to _rx_size. It is refilled
+  // straight from the socket once it is empty.
+  uint8_t _rx_buffer[256];
+  uint16_t _rx_pos;
+  uint16_t _rx_size;
   uint8_t _status;
   mbed::Callback<int(void)> beforeConnect;
+  EthernetServer* _server;  // Server that owns sock, NULL if the client does
+  uint32_t _generation; // Of the server slot sock was in when available() returned the client
+
+  // Data written but not sent yet, the clients with some are in a list the flush timer goes through.
+  // The buffer is allocated by the first write() that collects data and freed by stop().
+  uint8_t* _tx_buffer;
+  size_t _tx_size;
+  size_t _tx_sent;    // Part of it the flush timer got out so far
+  EthernetClient* _tx_next;
+  bool _tx_queued;
+  bool _tx_started;   // The flush timer tried to send it, it must not change
+  bool _tx_busy;      // A send from it is in progress
 
   void getStatus();
+  bool attached();
+  nsapi_size_or_error_t send(Socket* s, const uint8_t *buf, size_t size, unsigned long timeout);
+  void waitTx();
+  void unqueue();
+  bool sendBuffered();
+  bool trySend();
+  void kickTx();
+  void freeTx();
+  bool flushTx();
+  static void scheduleFlush();
+  static void flushPending();
 };
 
 }
@@ -1,4 +1,6 @@
 #include "EthernetUdp.h"
+#include "events/mbed_shared_queues.h"
+#include "platform/mbed_atomic.h"
 
 extern arduino::EthernetClass WiFi;
 
@@ -6,15 +8,27 @@ extern arduino::EthernetClass WiFi;
 #define ETHERNET_UDP_BUFFER_SIZE        508
 #endif
 
+// Event flag of _tx_flags
+#define ETHERNET_UDP_TX_READY           0x1
+
 arduino::EthernetUDP::EthernetUDP() {
-    _packet_buffer = new uint8_t[ETHERNET_UDP_BUFFER_SIZE];
+    _packet_buffer = new uint8_t[ETHERNET_UDP_BUFFER_SIZE * ETHERNET_UDP_RX_QUEUE_SIZE];
+    _tx_buffer = new uint8_t[ETHERNET_UDP_TX_BUFFER_SIZE];
+    _tx_size = 0;
+    _rx_head = 0;
+    _rx_tail = 0;
+    _rx_pending = false;
+    _rx_event = 0;
     _current_packet = NULL;
     _current_packet_size = 0;
-    // if this allocation fails then ::begin will fail
+    memset(&_stats, 0, sizeof(_stats));
+    // if these allocations fail then ::begin will fail
 }
 
 arduino::EthernetUDP::~EthernetUDP() {
+    stop();
     delete[] _packet_buffer;
+    delete[] _tx_buffer;
 }
 
 uint8_t arduino::EthernetUDP::begin(uint16_t port) {
@@ -29,11 +43,17 @@ uint8_t arduino::EthernetUDP::begin(uint16_t port) {
         return 0; //Failed to bind UDP Socket to port
     }
 
-    if (!_packet_buffer) {
+    if (!_packet_buffer || !_tx_buffer) {
         return 0;
     }
 
-    _socket.set_timeout(1000);
+    // Datagrams are queued as they arrive, parsePacket() never waits
+    _socket.set_blocking(false);
+    // The socket callback can only post to the shared queue once it exists
+    mbed_event_queue();
+    _socket.sigio(mbed::callback(this, &EthernetUDP::onSocketEvent));
+    // Something may have arrived before the callback was attached
+    onSocketEvent();
 
     return 1;
 }
@@ -55,11 +75,75 @@ uint8_t arduino::EthernetUDP::beginMulticast(IPAddress ip, uint16_t port) {
 }
 
 void arduino::EthernetUDP::stop() {
-    _socket.close();    
+    _socket.sigio(nullptr);
+    // Closed first, a receive() in progress stops at the next recvfrom()
+    _socket.close();
+    _rx_mutex.lock();
+    // A receive() that could not be cancelled has already been dispatched
+    // and waits for the mutex: let it run into the closed socket, so that
+    // nothing is left to touch the buffers once stop() returns
+    while (core_util_atomic_load_bool(&_rx_pending) && !mbed_event_queue()->cancel(_rx_event)) {
+        _rx_mutex.unlock();
+        delay(1);
+        _rx_mutex.lock();
+    }
+    _rx_event = 0;
+    _rx_pending = false;
+    _rx_head = 0;
+    _rx_tail = 0;
+    _current_packet = NULL;
+    _current_packet_size = 0;
+    _rx_mutex.unlock();
+}
+
+// Called by the network stack, which must not be kept waiting
+void arduino::EthernetUDP::onSocketEvent() {
+    _tx_flags.set(ETHERNET_UDP_TX_READY);
+    if (!core_util_atomic_exchange_bool(&_rx_pending, true)) {
+        _rx_event = mbed_event_queue()->call(this, &EthernetUDP::receive);
+        if (_rx_event == 0) {
+            _rx_pending = false;
+        }
+    }
+}
+
+// Moves everything the socket has into the receive queue
+void arduino::EthernetUDP::receive() {
+    _rx_mutex.lock();
+    // Cleared first, a signal from now on queues another pass
+    core_util_atomic_store_bool(&_rx_pending, false);
+
+    while (true) {
+        uint32_t head = _rx_head;
+        nsapi_size_or_error_t ret;
+
+        if (head - core_util_atomic_load_u32(&_rx_tail) < ETHERNET_UDP_RX_QUEUE_SIZE) {
+            rx_slot_t* slot = &_rx_slots[head % ETHERNET_UDP_RX_QUEUE_SIZE];
+            uint8_t* data = &_packet_buffer[(head % ETHERNET_UDP_RX_QUEUE_SIZE) * ETHERNET_UDP_BUFFER_SIZE];
+            ret = _socket.recvfrom(&slot->from, data, ETHERNET_UDP_BUFFER_SIZE);
+            if (ret < 0) {
+                break;
+            }
+            // Longer datagrams are truncated to ETHERNET_UDP_BUFFER_SIZE
+            slot->size = ((size_t)ret < ETHERNET_UDP_BUFFER_SIZE) ? ret : ETHERNET_UDP_BUFFER_SIZE;
+            core_util_atomic_store_u32(&_rx_head, head + 1);
+            _stats.queued++;
+        } else {
+            // The queue is full: drop the newest datagram rather than leave
+            // the stack with no room for the next ones
+            ret = _socket.recvfrom(NULL, NULL, 0);
+            if (ret < 0) {
+                break;
+            }
+            _stats.dropped++;
+        }
+    }
+    _rx_mutex.unlock();
 }
 
 int arduino::EthernetUDP::beginPacket(IPAddress ip, uint16_t port) {    
     _host = WiFi.socketAddressFromIpAddress(ip, port);
+    _tx_size = 0;
     //If IP is null and port is 0 the initialization failed
     return (_host.get_ip_address() == nullptr && _host.get_port() == 0) ? 0 : 1;
 }
@@ -67,114 +151,113 @@ int arduino::EthernetUDP::beginPacket(IPAddress ip, uint16_t port) {
 int arduino::EthernetUDP::beginPacket(const char *host, uint16_t port) {     
     _host = SocketAddress(host, port);
     Ethernet.getNetwork()->gethostbyname(host, &_host);
+    _tx_size = 0;
     //If IP is null and port is 0 the initialization failed
     return (_host.get_ip_address() == nullptr && _host.get_port() == 0) ? 0 : 1;
 }
 
 int arduino::EthernetUDP::endPacket() {
+    // The whole packet goes out as one datagram. The socket does not block, so that
+    // receive() never does: when the stack is out of buffers, wait for its next event
+    nsapi_size_or_error_t ret;
+    unsigned long start = millis();
+    while (true) {
+        _tx_flags.clear(ETHERNET_UDP_TX_READY);
+        ret = _socket.sendto(_host, _tx_buffer, _tx_size);
+        unsigned long elapsed = millis() - start;
+        if (ret != NSAPI_ERROR_WOULD_BLOCK || elapsed >= ETHERNET_UDP_TX_TIMEOUT) {
+            break;
+        }
+        _tx_flags.wait_any_for(ETHERNET_UDP_TX_READY, std::chrono::milliseconds(ETHERNET_UDP_TX_TIMEOUT - elapsed));
+    }
+    size_t size = _tx_size;
+    _tx_size = 0;
+
+    if (ret < 0 || (size_t)ret != size) {
+        return 0;
+    }
+    _stats.sent++;
     return 1;
 }
 
 // Write a single byte into the packet
 size_t arduino::EthernetUDP::write(uint8_t byte) {
-    uint8_t buffer[1] = { byte };    
-    return _socket.sendto(_host, buffer, 1);
+    return write(&byte, 1);
 }
 
 // Write size bytes from buffer into the packet
+// Returns the number of bytes that fit, the packet is never split
 size_t arduino::EthernetUDP::write(const uint8_t *buffer, size_t size) {    
-    return _socket.sendto(_host, buffer, size);
+    if (!_tx_buffer) {
+        return 0;
+    }
+
+    if (size > ETHERNET_UDP_TX_BUFFER_SIZE - _tx_size) {
+        size = ETHERNET_UDP_TX_BUFFER_SIZE - _tx_size;
+    }
+    memcpy(&_tx_buffer[_tx_size], buffer, size);
+    _tx_size += size;
+
+    return size;
 }
 
 int arduino::EthernetUDP::parsePacket() {
-    nsapi_size_or_error_t ret = _socket.recvfrom(&_remoteHost, _packet_buffer, ETHERNET_UDP_BUFFER_SIZE);
+    uint32_t tail = _rx_tail;
+
+    if (_current_packet != NULL) {
+        // Done with the current packet, its slot can take a new datagram
+        tail++;
+        core_util_atomic_store_u32(&_rx_tail, tail);
+        _current_packet = NULL;
+        _current_packet_size = 0;
+    }
 
-    if (ret == NSAPI_ERROR_WOULD_BLOCK) {
+    if (core_util_atomic_load_u32(&_rx_head) == tail) {
         // no data
         return 0;
-    } else if(ret == NSAPI_ERROR_NO_SOCKET){
-        // socket was not created correctly.
-        return -1;
-    }
-    // error codes below zero are errors
-    else if (ret <= 0) {
-        // something else went wrong, need some tracing info...
-        return -1;
     }
 
     // set current packet states
-    _current_packet = _packet_buffer;
-    _current_packet_size = ret;
+    rx_slot_t* slot = &_rx_slots[tail % ETHERNET_UDP_RX_QUEUE_SIZE];
+    _remoteHost = slot->from;
+    _current_packet = &_packet_buffer[(tail % ETHERNET_UDP_RX_QUEUE_SIZE) * ETHERNET_UDP_BUFFER_SIZE];
+    _current_packet_size = slot->size;
 
     return _current_packet_size;
 }
 
+// Number of bytes left in the current packet
 int arduino::EthernetUDP::available() {
     return _current_packet_size;
 }
 
 // Read a single byte from the current packet
 int arduino::EthernetUDP::read() {
-    // no current packet...
-    if (_current_packet == NULL) {
-        // try reading the next frame, if there is no data return
-        if (parsePacket() == 0) return -1;
+    if (_current_packet_size == 0) {
+        // no current packet or at its end, try the next one
+        if (parsePacket() <= 0) return -1;
     }
 
-    _current_packet++;
-
-    // check for overflow
-    if (_current_packet > _packet_buffer + _current_packet_size) {
-        // try reading the next packet...
-        if (parsePacket() > 0) {
-            // if so, read first byte of next packet;
-            return read();
-        }
-        else {
-            // no new data... not sure what to return here now
-            return -1;
-        }
-    }
-
-    return _current_packet[0];
+    _current_packet_size--;
+    return *_current_packet++;
 }
 
 // Read up to len bytes from the current packet and place them into buffer
 // Returns the number of bytes read, or 0 if none are available
 int arduino::EthernetUDP::read(unsigned char* buffer, size_t len) {
     // Q: does Arduino read() function handle fragmentation? I won't for now...
-    if (_current_packet == NULL) {
-        if (parsePacket() == 0) return 0;
+    if (_current_packet_size == 0) {
+        // no current packet or at its end, try the next one
+        if (parsePacket() <= 0) return 0;
     }
 
-    // how much data do we have in the current packet?
-    int offset = _current_packet - _packet_buffer;
-    if (offset < 0) {
-        return 0;
-    }
-
-    int max_bytes = _current_packet_size - offset;
-    if (max_bytes < 0) {
-        return 0;
-    }
-
-    // at the end of the packet?
-    if (max_bytes == 0) {
-        // try read next packet...
-        if (parsePacket() > 0) {
-            return read(buffer, len);
-        }
-        else {
-            return 0;
-        }
-    }
-
-    if (len > max_bytes) len = max_bytes;
+    if (len > _current_packet_size) len = _current_packet_size;
 
     // copy to target buffer
     memcpy(buffer, _current_packet, len);
 
     _current_packet += len;
+    _current_packet_size -= len;
 
     return len;
 }
@@ -198,4 +281,11 @@ int arduino::EthernetUDP::peek(){
   }
 
   return _current_packet[0];
+}
+
+void arduino::EthernetUDP::stats(Stats* stats, bool reset) {
+    memcpy(stats, &_stats, sizeof(*stats));
+    if (reset) {
+        memset(&_stats, 0, sizeof(_stats));
+    }
 }
\ No newline at end of file
@@ -28,21 +28,65 @@
 
 #define UDP_TX_PACKET_MAX_SIZE 24
 
+// Largest datagram beginPacket()/endPacket() can assemble, 1500 bytes of MTU minus the IP and UDP headers
+#ifndef ETHERNET_UDP_TX_BUFFER_SIZE
+#define ETHERNET_UDP_TX_BUFFER_SIZE     1472
+#endif
+
+// How long endPacket() waits for the network stack to take the datagram, in ms
+#ifndef ETHERNET_UDP_TX_TIMEOUT
+#define ETHERNET_UDP_TX_TIMEOUT         1000
+#endif
+
+// Received datagrams waiting for parsePacket(), including the one being read
+#ifndef ETHERNET_UDP_RX_QUEUE_SIZE
+#define ETHERNET_UDP_RX_QUEUE_SIZE      4
+#endif
+
 namespace arduino {
 
 class EthernetUDP : public UDP {
+public:
+  struct Stats {
+    uint32_t queued;   // Datagrams put in the receive queue
+    uint32_t dropped;  // Datagrams discarded because the receive queue was full
+    uint32_t sent;     // Datagrams sent by endPacket()
+  };
+
 private:
   UDPSocket _socket;  // Mbed OS socket
   SocketAddress _host;  // Host to be used to send data  
   SocketAddress _remoteHost; // Remote host that sent incoming packets
 
-  uint8_t* _packet_buffer;  // Raw packet buffer (contains data we got from the UDPSocket)
+  // Packet being assembled between beginPacket() and endPacket()
+  uint8_t* _tx_buffer;
+  size_t _tx_size;
+  rtos::EventFlags _tx_flags;  // Set by every socket event, endPacket() waits on it for room
+
+  // Receive queue, filled from the shared event queue when the socket signals
+  // and emptied by parsePacket(). Slot _rx_tail is the current packet.
+  struct rx_slot_t {
+    SocketAddress from;
+    size_t size;
+  };
+  uint8_t* _packet_buffer;  // Raw packet buffer, ETHERNET_UDP_RX_QUEUE_SIZE datagrams we got from the UDPSocket
+  rx_slot_t _rx_slots[ETHERNET_UDP_RX_QUEUE_SIZE];
+  volatile uint32_t _rx_head;  // Written by receive() only
+  volatile uint32_t _rx_tail;  // Written by parsePacket() only
+  volatile bool _rx_pending;   // receive() is queued
+  int _rx_event;
+  rtos::Mutex _rx_mutex;       // Held by receive(), stop() waits on it
 
   // The Arduino APIs allow you to iterate through this buffer, so we need to be able to iterate over the current packet
   // these two variables are used to cache the state of the current packet
   uint8_t* _current_packet;
   size_t _current_packet_size;
 
+  Stats _stats;
+
+  void onSocketEvent();
+  void receive();
+
 public:
   EthernetUDP();  // Constructor
   ~EthernetUDP();
@@ -89,6 +133,9 @@ public:
   virtual IPAddress remoteIP();
   // // Return the port of the host who sent the current incoming packet
   virtual uint16_t remotePort();
+
+  // Copy the packet counters, optionally clearing them
+  void stats(Stats* stats, bool reset = false);
 };
 
 }
@@ -1,3 +1,16 @@
 #include <lvgl.h>
 
+typedef struct {
+  uint32_t frames;      // Screen refreshes
+  uint32_t render_ms;   // Time spent on them, rendering and flushing
+  uint32_t pixels;      // Pixels refreshed
+  uint32_t flushes;     // Draw buffers copied to the framebuffer
+  uint32_t flush_us;    // Time the DMA2D spent copying them
+  uint32_t wait_us;     // Time the CPU spent waiting for the DMA2D to be free
+  uint32_t vsync_us;    // Time spent waiting for the previous frame to be shown
+} portenta_lvgl_stats_t;
+
 void portenta_init_video();
+
+// Copies the counters accumulated since the last reset
+void portenta_lvgl_get_stats(portenta_lvgl_stats_t * stats, bool reset = true);
@@ -5,29 +5,72 @@
 
 #include "Portenta_Video.h"
 #include "SDRAM.h"
+#include "MemoryRegions.h"
 
 static uint32_t lcd_x_size = 0;
 static uint32_t lcd_y_size = 0;
 
-static uint16_t * fb;
+/* Back buffer of the frame being refreshed, NULL between refreshes */
+static uint16_t * fb = NULL;
 static lv_disp_drv_t disp_drv;
 
-/* Display flushing */
-static void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p)
+static volatile uint32_t flush_start;
+static volatile portenta_lvgl_stats_t stats;
+
+/* Waits for a flush still running on the DMA2D before it is reprogrammed */
+static void dma2d_wait(DMA2D_HandleTypeDef * dma2d)
 {
+  if (HAL_DMA2D_GetState(dma2d) != HAL_DMA2D_STATE_BUSY) {
+    return;
+  }
+  uint32_t start = micros();
+  while (HAL_DMA2D_GetState(dma2d) == HAL_DMA2D_STATE_BUSY) {
+    if (micros() - start > 1000000) {
+      /* The transfer never completed: give the draw buffer back to lvgl */
+      HAL_DMA2D_Abort(dma2d);
+      lv_disp_flush_ready(&disp_drv);
+      break;
+    }
+  }
+  stats.wait_us += micros() - start;
+}
 
-#if ARDUINO_PORTENTA_H7_M7
-  SCB_CleanInvalidateDCache();
-  SCB_InvalidateICache();
-#endif
+/* Called from the DMA2D interrupt at the end of a flush */
+static void dma2d_flush_done(DMA2D_HandleTypeDef * dma2d)
+{
+  stats.flushes++;
+  stats.flush_us += micros() - flush_start;
+  lv_disp_flush_ready(&disp_drv); /* tell lvgl that flushing is done */
+}
 
+/* Display flushing: the DMA2D copies the draw buffer to the framebuffer while
+   lvgl renders the next area into the other draw buffer */
+static void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p)
+{
   DMA2D_HandleTypeDef * dma2d = stm32_get_DMA2D();
 
+  dma2d_wait(dma2d);
+
+  if (fb == NULL) {
+    /* First area of a refresh: the back buffer is free once the last frame
+       is on screen */
+    uint32_t start = micros();
+    fb = (uint16_t *)stm32_LCD_BeginFrame();
+    stats.vsync_us += micros() - start;
+  }
+
   lv_color_t * pDst = (lv_color_t*)fb;
   pDst += area->y1 * lcd_x_size + area->x1;
 
   uint32_t w = lv_area_get_width(area);
   uint32_t h = lv_area_get_height(area);
+
+  stm32_LCD_AddDirtyRect(area->x1, area->y1, w, h);
+
+  /* The DMA2D reads the rendered pixels from memory, the framebuffer is only
+     ever written by the DMA2D so it needs no maintenance */
+  MemoryRegions.clean(color_p, w * h * sizeof(lv_color_t));
+
   /*##-1- Configure the DMA2D Mode, Color Mode and output offset #############*/
   dma2d->Init.Mode         = DMA2D_M2M;
   dma2d->Init.ColorMode    = DMA2D_OUTPUT_RGB565;
@@ -36,7 +79,7 @@ static void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t
   dma2d->Init.RedBlueSwap   = DMA2D_RB_REGULAR;     /* No Output Red & Blue swap */
 
   /*##-2- DMA2D Callbacks Configuration ######################################*/
-  dma2d->XferCpltCallback  = NULL;
+  dma2d->XferCpltCallback  = dma2d_flush_done;
 
   /*##-3- Foreground Configuration ###########################################*/
   dma2d->LayerCfg[1].AlphaMode = DMA2D_NO_MODIF_ALPHA;
@@ -49,12 +92,30 @@ static void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t
   /* DMA2D Initialization */
   if (HAL_DMA2D_Init(dma2d) == HAL_OK) {
     if (HAL_DMA2D_ConfigLayer(dma2d, 1) == HAL_OK) {
-      HAL_DMA2D_Start(dma2d, (uint32_t)color_p, (uint32_t)pDst, w, h);
-      HAL_DMA2D_PollForTransfer(dma2d, 1000);
+      flush_start = micros();
+      if (HAL_DMA2D_Start_IT(dma2d, (uint32_t)color_p, (uint32_t)pDst, w, h) == HAL_OK) {
+        /* lv_disp_flush_ready() is called by the transfer complete interrupt */
+        return;
+      }
     }
   }
 
-  lv_disp_flush_ready(disp); /* tell lvgl that flushing is done */
+  lv_disp_flush_ready(disp);
+}
+
+/* Called by lvgl after each refresh of the screen: the frame is shown at the
+   next vertical blanking, after its last area has been flushed */
+static void my_monitor(lv_disp_drv_t * disp_drv, uint32_t time, uint32_t px)
+{
+  dma2d_wait(stm32_get_DMA2D());
+  if (fb != NULL) {
+    stm32_LCD_PresentFrame(false);
+    fb = NULL;
+  }
+
+  stats.frames++;
+  stats.render_ms += time;
+  stats.pixels += px;
 }
 
 
@@ -62,16 +123,17 @@ static void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t
    It can be used only in buffered mode (LV_VDB_SIZE != 0 in lv_conf.h)*/
 static void gpu_blend(lv_disp_drv_t * disp_drv, lv_color_t * dest, const lv_color_t * src, uint32_t length, lv_opa_t opa)
 {
+  DMA2D_HandleTypeDef * dma2d = stm32_get_DMA2D();
 
-#if ARDUINO_PORTENTA_H7_M7
-  SCB_CleanInvalidateDCache();
-#endif
+  dma2d_wait(dma2d);
 
-  DMA2D_HandleTypeDef * dma2d = stm32_get_DMA2D();
+  MemoryRegions.clean(src, length * sizeof(lv_color_t));
+  MemoryRegions.clean(dest, length * sizeof(lv_color_t));
 
   dma2d->Instance = DMA2D;
   dma2d->Init.Mode = DMA2D_M2M_BLEND;
   dma2d->Init.OutputOffset = 0;
+  dma2d->XferCpltCallback = NULL;
 
   /* Foreground layer */
   dma2d->LayerCfg[1].AlphaMode = DMA2D_REPLACE_ALPHA;
@@ -92,37 +154,56 @@ static void gpu_blend(lv_disp_drv_t * disp_drv, lv_color_t * dest, const lv_colo
       HAL_DMA2D_PollForTransfer(dma2d, 1000);
     }
   }
+
+  /* lvgl reads the result right away */
+  MemoryRegions.invalidate(dest, length * sizeof(lv_color_t));
 }
 
 /* If your MCU has hardware accelerator (GPU) then you can use it to fill a memory with a color */
 static void gpu_fill(lv_disp_drv_t * disp_drv, lv_color_t * dest_buf, lv_coord_t dest_width,
                      const lv_area_t * fill_area, lv_color_t color)
 {
-#if ARDUINO_PORTENTA_H7_M7
-  SCB_CleanInvalidateDCache();
-#endif
-
   DMA2D_HandleTypeDef * dma2d = stm32_get_DMA2D();
 
+  dma2d_wait(dma2d);
+
   lv_color_t * destination = dest_buf + (dest_width * fill_area->y1 + fill_area->x1);
 
   uint32_t w = fill_area->x2 - fill_area->x1 + 1;
+  lv_coord_t h = lv_area_get_height(fill_area);
+  size_t len = ((h - 1) * dest_width + w) * sizeof(lv_color_t);
+
+  /* Pixels of the lines around the area may be dirty in the cache */
+  MemoryRegions.clean(destination, len);
+
   dma2d->Instance = DMA2D;
   dma2d->Init.Mode = DMA2D_R2M;
   dma2d->Init.ColorMode = DMA2D_OUTPUT_RGB565;
   dma2d->Init.OutputOffset = dest_width - w;
+  dma2d->XferCpltCallback = NULL;
   dma2d->LayerCfg[1].InputAlpha = DMA2D_NO_MODIF_ALPHA;
   dma2d->LayerCfg[1].InputColorMode = DMA2D_OUTPUT_RGB565;
 
   /* DMA2D Initialization */
   if (HAL_DMA2D_Init(dma2d) == HAL_OK) {
     if (HAL_DMA2D_ConfigLayer(dma2d, 1) == HAL_OK) {
-      lv_coord_t h = lv_area_get_height(fill_area);
       if (HAL_DMA2D_BlendingStart(dma2d, lv_color_to32(color), (uint32_t)destination, (uint32_t)destination, w, h) == HAL_OK) {
         HAL_DMA2D_PollForTransfer(dma2d, 1000);
       }
     }
   }
+
+  MemoryRegions.invalidate(destination, len);
+}
+
+void portenta_lvgl_get_stats(portenta_lvgl_stats_t * out, bool reset)
+{
+  core_util_critical_section_enter();
+  memcpy(out, (const void*)&stats, sizeof(*out));
+  if (reset) {
+    memset((void*)&stats, 0, sizeof(stats));
+  }
+  core_util_critical_section_exit();
 }
 
 
@@ -163,18 +244,19 @@ void portenta_init_video() {
   lcd_x_size = stm32_getXSize();
   lcd_y_size = stm32_getYSize();
 
-  fb = (uint16_t *)getNextFrameBuffer();
-  getNextFrameBuffer();
-
-  static lv_color_t buf[LV_HOR_RES_MAX * LV_VER_RES_MAX / 6];
+  /* Two draw buffers, lvgl renders into one while the other is flushed. Together
+     they take as much RAM as the single buffer used to. */
+  static lv_color_t buf1[LV_HOR_RES_MAX * LV_VER_RES_MAX / 12];
+  static lv_color_t buf2[LV_HOR_RES_MAX * LV_VER_RES_MAX / 12];
   static lv_disp_buf_t disp_buf;
-  lv_disp_buf_init(&disp_buf, buf, NULL, LV_HOR_RES_MAX * LV_VER_RES_MAX / 6);
+  lv_disp_buf_init(&disp_buf, buf1, buf2, LV_HOR_RES_MAX * LV_VER_RES_MAX / 12);
 
   /*Initialize the display*/
   lv_disp_drv_init(&disp_drv);
   disp_drv.flush_cb = my_disp_flush;
   disp_drv.gpu_fill_cb = gpu_fill;
   disp_drv.gpu_blend_cb = gpu_blend;
+  disp_drv.monitor_cb = my_monitor;
   disp_drv.buffer = &disp_buf;
   lv_disp_drv_register(&disp_drv);
 
@@ -0,0 +1,61 @@
+/*
+  This example reads audio blocks from the on-board PDM microphones without
+  copying them, and prints once a second the level of the last block, when
+  it was captured and how many blocks were lost because the sketch did not
+  keep up. Raise the delay in loop() to see the queue fill up and overrun.
+
+  Circuit:
+  - Arduino Nano 33 BLE board or
+  - Arduino Portenta H7 board plus Portenta Vision Shield
+
+  This example code is in the public domain.
+*/
+
+#include <PDM.h>
+
+static const char channels = 1;
+static const int frequency = 16000;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial);
+
+  // Up to 8 blocks can be waiting for the sketch before new ones are lost
+  PDM.setBufferCount(8);
+
+  if (!PDM.begin(channels, frequency)) {
+    Serial.println("Failed to start PDM!");
+    while (1);
+  }
+}
+
+void loop() {
+  const PDMBlock* block;
+  uint32_t blocks = 0;
+  int32_t peak = 0;
+  uint32_t timestamp = 0;
+
+  // Drain everything that was queued while the sketch was busy
+  while ((block = PDM.acquire()) != NULL) {
+    const int16_t* samples = (const int16_t*)block->data;
+    for (size_t i = 0; i < block->size / sizeof(int16_t); i++) {
+      peak = max(peak, (int32_t)abs(samples[i]));
+    }
+    timestamp = block->timestamp;
+    blocks++;
+    PDM.release();
+  }
+
+  if (blocks) {
+    Serial.print("blocks: ");
+    Serial.print(blocks);
+    Serial.print(" peak: ");
+    Serial.print(peak);
+    Serial.print(" captured at: ");
+    Serial.print(timestamp);
+    Serial.print(" overruns: ");
+    Serial.println(PDM.overruns());
+  }
+
+  delay(10);
+}
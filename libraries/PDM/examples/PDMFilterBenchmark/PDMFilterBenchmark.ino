@@ -0,0 +1,91 @@
+/*
+  This example measures the PDM to PCM decimation filter used on the Portenta
+  Vision Shield, without the microphones: a sine wave is turned into a PDM
+  bitstream by a software sigma-delta modulator, decimated by the filter, and
+  the sketch prints the CPU cycles spent per output sample and the amplitude
+  and noise of the output.
+
+  Circuit:
+  - Arduino Portenta H7 board or Arduino Nano 33 BLE board
+
+  This example code is in the public domain.
+*/
+
+#include <PDM.h>
+#include "stm32/pdm_filter.h"
+
+static const int channels = 2;
+static const int decimation = 64;
+static const int frequency = 16000;
+static const float tone = 1000.0f;
+
+// Output samples per channel for each call, the same as the Vision Shield gets
+static const int samples = 1024 * 8 / (decimation * channels * 2);
+
+static uint8_t pdmBuffer[samples * decimation / 8 * channels];
+static int16_t pcmBuffer[samples * channels];
+static pdm_filter_t filter;
+
+// Second order sigma-delta modulator state, one per channel
+static float integrator1[channels];
+static float integrator2[channels];
+static uint32_t bitCount;
+
+static void modulate() {
+  memset(pdmBuffer, 0, sizeof(pdmBuffer));
+  for (int k = 0; k < samples * decimation; k++, bitCount++) {
+    float x = 0.5f * sinf(2.0f * PI * tone * bitCount / (frequency * (float)decimation));
+    for (int c = 0; c < channels; c++) {
+      float y = (integrator2[c] >= 0.0f) ? 1.0f : -1.0f;
+      integrator1[c] += x - y;
+      integrator2[c] += integrator1[c] - y;
+      if (y > 0.0f) {
+        pdmBuffer[(k / 8) * channels + c] |= 0x80 >> (k % 8);
+      }
+    }
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  if (pdm_filter_init(&filter, decimation, channels, channels, samples, 0, 0.0f) != 0) {
+    Serial.println("Failed to initialize the filter!");
+    while (1);
+  }
+
+  // Enable the cycle counter
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void loop() {
+  uint32_t cycles = 0;
+  int32_t peak = 0;
+  const int blocks = 100;
+
+  for (int b = 0; b < blocks; b++) {
+    modulate();
+
+    uint32_t start = DWT->CYCCNT;
+    pdm_filter_process(&filter, pdmBuffer, pcmBuffer);
+    cycles += DWT->CYCCNT - start;
+
+    for (int i = 0; i < samples * channels; i++) {
+      peak = max(peak, (int32_t)abs(pcmBuffer[i]));
+    }
+  }
+
+  // A full scale input at 0dB gain gives 32767, the sine is at half scale
+  Serial.print("cycles per sample per channel: ");
+  Serial.print((float)cycles / (blocks * samples * channels));
+  Serial.print(" peak: ");
+  Serial.print(peak);
+  Serial.print(" (expected ");
+  Serial.print(32767 / 2);
+  Serial.println(")");
+
+  delay(1000);
+}
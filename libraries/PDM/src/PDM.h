@@ -21,7 +21,7 @@
 
 #include <Arduino.h>
 
-#include "utility/PDMDoubleBuffer.h"
+#include "utility/PDMRingBuffer.h"
 
 class PDMClass
 {
@@ -37,8 +37,16 @@ public:
 
   void onReceive(void(*)(void));
 
+  // Zero-copy access to the oldest block, valid until release()
+  const PDMBlock* acquire();
+  void release();
+  // Blocks lost because the sketch did not keep up
+  uint32_t overruns();
+
   void setGain(int gain);
   void setBufferSize(int bufferSize);
+  // Number of blocks queued before new ones are lost, set before begin()
+  void setBufferCount(int count);
 
 // private:
   void IrqHandler(bool halftranfer);
@@ -50,7 +58,9 @@ private:
 
   int _channels;
   
-  PDMDoubleBuffer _doubleBuffer;
+  PDMRingBuffer _ringBuffer;
+  // Blocks handed to the PDM DMA and not complete yet (nRF52)
+  int _dmaBlocks;
   
   void (*_onReceive)(void);
 };
@@ -39,6 +39,7 @@ PDMClass::PDMClass(int dinPin, int clkPin, int pwrPin) :
   _dinPin(dinPin),
   _clkPin(clkPin),
   _pwrPin(pwrPin),
+  _dmaBlocks(0),
   _onReceive(NULL)
 {
 }
@@ -106,7 +107,7 @@ int PDMClass::begin(int channels, long sampleRate)
   }
 
   // clear the buffer
-  _doubleBuffer.reset();
+  _ringBuffer.reset();
 
   // set the PDM IRQ priority and enable
   NVIC_SetPriority(PDM_IRQn, PDM_IRQ_PRIORITY);
@@ -114,9 +115,9 @@ int PDMClass::begin(int channels, long sampleRate)
   NVIC_EnableIRQ(PDM_IRQn);
 
   // set the buffer for transfer
-  // nrf_pdm_buffer_set((uint32_t*)_doubleBuffer.data(), _doubleBuffer.availableForWrite() / (sizeof(int16_t) * _channels));
-  // _doubleBuffer.swap();
-  
+  nrf_pdm_buffer_set((uint32_t*)_ringBuffer.writeBlock(), _ringBuffer.size() / (sizeof(int16_t) * _channels));
+  _dmaBlocks = 1;
+
   // enable and trigger start task
   nrf_pdm_enable();
   nrf_pdm_event_clear(NRF_PDM_EVENT_STARTED);
@@ -148,24 +149,31 @@ void PDMClass::end()
 
 int PDMClass::available()
 {
-  NVIC_DisableIRQ(PDM_IRQn);
-
-  size_t avail = _doubleBuffer.available();
-
-  NVIC_EnableIRQ(PDM_IRQn);
+  size_t avail = _ringBuffer.available();
 
   return avail;
 }
 
 int PDMClass::read(void* buffer, size_t size)
 {
-  NVIC_DisableIRQ(PDM_IRQn);
+  int read = _ringBuffer.read(buffer, size);
 
-  int read = _doubleBuffer.read(buffer, size);
+  return read;
+}
 
-  NVIC_EnableIRQ(PDM_IRQn);
+const PDMBlock* PDMClass::acquire()
+{
+  return _ringBuffer.acquire();
+}
 
-  return read;
+void PDMClass::release()
+{
+  _ringBuffer.release();
+}
+
+uint32_t PDMClass::overruns()
+{
+  return _ringBuffer.overruns();
 }
 
 void PDMClass::onReceive(void(*function)(void))
@@ -180,7 +188,12 @@ void PDMClass::setGain(int gain)
 
 void PDMClass::setBufferSize(int bufferSize)
 {
-  _doubleBuffer.setSize(bufferSize);
+  _ringBuffer.setSize(bufferSize);
+}
+
+void PDMClass::setBufferCount(int count)
+{
+  _ringBuffer.setCount(count);
 }
 
 void PDMClass::IrqHandler(bool halftranfer)
@@ -188,20 +201,28 @@ void PDMClass::IrqHandler(bool halftranfer)
   if (nrf_pdm_event_check(NRF_PDM_EVENT_STARTED)) {
     nrf_pdm_event_clear(NRF_PDM_EVENT_STARTED);
 
-    if (_doubleBuffer.available() == 0) {
-      // switch to the next buffer
-      nrf_pdm_buffer_set((uint32_t*)_doubleBuffer.data(), _doubleBuffer.availableForWrite() / (sizeof(int16_t) * _channels));
-
-      // make the current one available for reading
-      _doubleBuffer.swap(_doubleBuffer.availableForWrite());
+    // The block set at the previous event is being filled now, so the one
+    // before it is complete
+    bool received = false;
+    if (_dmaBlocks == 2) {
+      _ringBuffer.commit(micros());
+      _dmaBlocks = 1;
+      received = true;
+    }
 
-      // call receive callback if provided
-      if (_onReceive) {
-        _onReceive();
-      }
+    void* next = _ringBuffer.writeBlock(1);
+    if (next != NULL) {
+      _dmaBlocks = 2;
     } else {
-      // buffer overflow, stop
-      nrf_pdm_disable();
+      // buffer overflow, the block being filled is filled again
+      next = _ringBuffer.writeBlock();
+      _ringBuffer.overrun();
+    }
+    nrf_pdm_buffer_set((uint32_t*)next, _ringBuffer.size() / (sizeof(int16_t) * _channels));
+
+    // call receive callback if provided
+    if (received && _onReceive) {
+      _onReceive();
     }
   } else if (nrf_pdm_event_check(NRF_PDM_EVENT_STOPPED)) {
     nrf_pdm_event_clear(NRF_PDM_EVENT_STOPPED);
@@ -69,8 +69,6 @@ int PDMClass::begin(int channels, long sampleRate) {
     gain_db = 24;
   }
 
-  //g_pcmbuf = (uint16_t*)_doubleBuffer.data();
-
   if(py_audio_init(channels, sampleRate, gain_db, 0.9883f)) {
     py_audio_start_streaming();
     return 1;
@@ -86,16 +84,31 @@ void PDMClass::end()
 
 int PDMClass::available()
 {
-  size_t avail = _doubleBuffer.available();
+  size_t avail = _ringBuffer.available();
   return avail;
 }
 
 int PDMClass::read(void* buffer, size_t size)
 {
-  int read = _doubleBuffer.read(buffer, size);
+  int read = _ringBuffer.read(buffer, size);
   return read;
 }
 
+const PDMBlock* PDMClass::acquire()
+{
+  return _ringBuffer.acquire();
+}
+
+void PDMClass::release()
+{
+  _ringBuffer.release();
+}
+
+uint32_t PDMClass::overruns()
+{
+  return _ringBuffer.overruns();
+}
+
 void PDMClass::onReceive(void(*function)(void))
 {
   _onReceive = function;
@@ -110,15 +123,24 @@ void PDMClass::setGain(int gain)
 
 void PDMClass::setBufferSize(int bufferSize)
 {
-  _doubleBuffer.setSize(bufferSize);
+  _ringBuffer.setSize(bufferSize);
+}
+
+void PDMClass::setBufferCount(int count)
+{
+  _ringBuffer.setCount(count);
 }
 
 void PDMClass::IrqHandler(bool halftranfer)
 {
-  if (_doubleBuffer.available() == 0) {
-    g_pcmbuf = (uint16_t*)_doubleBuffer.data();
-    audio_pendsv_callback();
-    _doubleBuffer.swap(_doubleBuffer.availableForWrite());
+  // With no free block the samples are still run through the filter,
+  // to keep its state in step, but thrown away
+  g_pcmbuf = (uint16_t*)_ringBuffer.writeBlock();
+  audio_pendsv_callback();
+  if (g_pcmbuf != NULL) {
+    _ringBuffer.commit(micros());
+  } else {
+    _ringBuffer.overrun();
   }
 
   if (_onReceive) {
@@ -12,11 +12,10 @@
 
 #include <stdio.h>
 #include "stm32h7xx_hal.h"
-#include "pdm2pcm_glo.h"
+#include "pdm_filter.h"
 #include "audio.h"
 #include "stdbool.h"
 
-static CRC_HandleTypeDef hcrc;
 static SAI_HandleTypeDef hsai;
 static DMA_HandleTypeDef hdma_sai_rx;
 
@@ -24,8 +23,7 @@ volatile uint16_t *g_pcmbuf = NULL;
 
 static int g_i_channels = AUDIO_SAI_NBR_CHANNELS;
 static int g_o_channels = AUDIO_SAI_NBR_CHANNELS;
-static PDM_Filter_Handler_t  PDM_FilterHandler[2];
-static PDM_Filter_Config_t   PDM_FilterConfig[2];
+static pdm_filter_t pdm_filter;
 
 #define DMA_XFER_NONE   (0x00U)
 #define DMA_XFER_HALF   (0x01U)
@@ -71,21 +69,6 @@ void HAL_SAI_RxCpltCallback(SAI_HandleTypeDef *hsai)
     PDMIrqHandler(false);
 }
 
-static uint32_t get_decimation_factor(uint32_t decimation)
-{
-    switch (decimation) {
-        case 16:    return PDM_FILTER_DEC_FACTOR_16;
-        case 24:    return PDM_FILTER_DEC_FACTOR_24;
-        case 32:    return PDM_FILTER_DEC_FACTOR_32;
-        case 48:    return PDM_FILTER_DEC_FACTOR_48;
-        case 64:    return PDM_FILTER_DEC_FACTOR_64;
-        case 80:    return PDM_FILTER_DEC_FACTOR_80;
-        case 128:   return PDM_FILTER_DEC_FACTOR_128;
-        default: return 0;
-    }
-}
-
-
 static uint8_t get_mck_div(uint32_t frequency)
 {
     switch(frequency){
@@ -197,10 +180,6 @@ int py_audio_init(size_t channels, uint32_t frequency, int gain_db, float highpa
     }
 
     uint32_t decimation_factor = 64; // Fixed decimation factor
-    uint32_t decimation_factor_const = get_decimation_factor(decimation_factor);
-    if (decimation_factor_const == 0) {
-        return 0;
-    }
     uint32_t samples_per_channel = (PDM_BUFFER_SIZE * 8) / (decimation_factor * g_i_channels * 2); // Half a transfer
 
     hsai.Instance                    = AUDIO_SAI;
@@ -276,31 +255,11 @@ int py_audio_init(size_t channels, uint32_t frequency, int gain_db, float highpa
     HAL_NVIC_SetPriority(AUDIO_SAI_DMA_IRQ, AUDIO_IN_IRQ_PREPRIO, 0);
     HAL_NVIC_EnableIRQ(AUDIO_SAI_DMA_IRQ);
 
-    // Init CRC for the PDM library
-    hcrc.Instance = CRC;
-    hcrc.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_ENABLE;
-    hcrc.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_ENABLE;
-    hcrc.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_NONE;
-    hcrc.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_DISABLE;
-    hcrc.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
-    if (HAL_CRC_Init(&hcrc) != HAL_OK) {
-        return 0;
-    }
-    __HAL_CRC_DR_RESET(&hcrc);
-
     // Configure PDM filters
-    for (int i=0; i<g_i_channels; i++) {
-        PDM_FilterHandler[i].bit_order  = PDM_FILTER_BIT_ORDER_MSB;
-        PDM_FilterHandler[i].endianness = PDM_FILTER_ENDIANNESS_LE;
-        PDM_FilterHandler[i].high_pass_tap = (uint32_t) (highpass * 2147483647U); // coff * (2^31-1)
-        PDM_FilterHandler[i].out_ptr_channels = g_o_channels;
-        PDM_FilterHandler[i].in_ptr_channels  = g_i_channels;
-        PDM_Filter_Init(&PDM_FilterHandler[i]);
-
-        PDM_FilterConfig[i].mic_gain = gain_db;
-        PDM_FilterConfig[i].output_samples_number = samples_per_channel;
-        PDM_FilterConfig[i].decimation_factor = decimation_factor_const;
-        PDM_Filter_setConfig(&PDM_FilterHandler[i], &PDM_FilterConfig[i]);
+    pdm_filter_deinit(&pdm_filter);
+    if (pdm_filter_init(&pdm_filter, decimation_factor, g_i_channels, g_o_channels,
+                samples_per_channel, gain_db, highpass) != 0) {
+        return 0;
     }
 
     PDMsetBufferSize(samples_per_channel * g_o_channels * sizeof(int16_t));
@@ -329,6 +288,8 @@ void py_audio_deinit()
         hdma_sai_rx.Instance = NULL;
     }
 
+    pdm_filter_deinit(&pdm_filter);
+
     g_i_channels = 0;
     g_o_channels = 0;
     //free(g_pcmbuf);
@@ -342,18 +303,14 @@ void audio_pendsv_callback(void)
         // Clear buffer state.
         xfer_status &= ~(DMA_XFER_HALF);
 
-        // Convert PDM samples to PCM.
-        for (int i=0; i<g_i_channels; i++) {
-            PDM_Filter(&((uint8_t*)PDM_BUFFER)[i], &((int16_t*)g_pcmbuf)[i], &PDM_FilterHandler[i]);
-        }
+        // Convert PDM samples to PCM, g_pcmbuf is NULL if the block is dropped.
+        pdm_filter_process(&pdm_filter, &PDM_BUFFER[0], (int16_t*)g_pcmbuf);
     } else if ((xfer_status & DMA_XFER_FULL)) { // Check for transfer complete.
         // Clear buffer state.
         xfer_status &= ~(DMA_XFER_FULL);
 
-        // Convert PDM samples to PCM.
-        for (int i=0; i<g_i_channels; i++) {
-            PDM_Filter(&((uint8_t*)PDM_BUFFER)[PDM_BUFFER_SIZE / 2 + i], &((int16_t*)g_pcmbuf)[i], &PDM_FilterHandler[i]);
-        }
+        // Convert PDM samples to PCM, g_pcmbuf is NULL if the block is dropped.
+        pdm_filter_process(&pdm_filter, &PDM_BUFFER[PDM_BUFFER_SIZE / 2], (int16_t*)g_pcmbuf);
     }
 }
 
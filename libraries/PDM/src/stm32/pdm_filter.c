@@ -0,0 +1,226 @@
+/*
+ * PDM to PCM decimation filter, see pdm_filter.h.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pdm_filter.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#define PDM_FILTER_USE_DSP
+#endif
+
+#define SINC_ORDER      (4)
+
+// Half of a 47 taps Kaiser windowed (beta 8) half-band filter, Q15: the
+// even taps are zero besides the center one, which is 0.5. Flat to 0.38 of
+// the input Nyquist frequency, 76dB down from 0.62 on.
+static const int16_t hb_coefs[PDM_FILTER_HB_TAPS] = {
+    -1, 7, -23, 55, -116, 219, -383, 639, -1046, 1745, -3262, 10357,
+    10357, -3262, 1745, -1046, 639, -383, 219, -116, 55, -23, 7, -1,
+};
+
+static inline int16_t sat16(int32_t x)
+{
+#ifdef PDM_FILTER_USE_DSP
+    return __SSAT(x, 16);
+#else
+    return (x > INT16_MAX) ? INT16_MAX : (x < INT16_MIN) ? INT16_MIN : x;
+#endif
+}
+
+static int sinc_lut_init(pdm_filter_t *f, uint32_t r)
+{
+    // Impulse response of the sinc stage: SINC_ORDER boxcars of r taps convolved
+    uint32_t len = SINC_ORDER * r;
+    int32_t *h = calloc(len, sizeof(int32_t));
+    if (h == NULL) {
+        return -1;
+    }
+    int taps = (int)r;
+    uint32_t n = 1;
+    h[0] = 1;
+    for (int order = 0; order < SINC_ORDER; order++) {
+        // Running sum over r taps, in place from the end
+        n += r - 1;
+        for (int i = n - 1; i >= 0; i--) {
+            int32_t sum = 0;
+            for (int k = 0; k < taps && k <= i; k++) {
+                sum += h[i - k];
+            }
+            h[i] = sum;
+        }
+    }
+
+    // Each table gives the contribution of one byte of the window, the bits
+    // map to +1 and -1. The most significant bit is the oldest one.
+    for (uint32_t j = 0; j < f->window; j++) {
+        int32_t *lut = &f->lut[j * 256];
+        for (uint32_t v = 0; v < 256; v++) {
+            int32_t sum = 0;
+            for (uint32_t b = 0; b < 8; b++) {
+                int32_t tap = h[j * 8 + b];
+                sum += (v & (0x80 >> b)) ? tap : -tap;
+            }
+            lut[v] = sum;
+        }
+    }
+    free(h);
+    return 0;
+}
+
+int pdm_filter_init(pdm_filter_t *f, uint32_t decimation, uint32_t in_channels,
+                    uint32_t out_channels, uint32_t samples, int gain_db, float highpass)
+{
+    memset(f, 0, sizeof(*f));
+
+    // The sinc stage decimates by half the total, in whole bytes
+    if (decimation < 16 || decimation > 128 || (decimation % 16) != 0) {
+        return -1;
+    }
+    if (in_channels == 0 || in_channels > PDM_FILTER_MAX_CHANNELS ||
+        out_channels == 0 || out_channels > in_channels || samples == 0) {
+        return -1;
+    }
+
+    uint32_t r = decimation / 2;
+    f->decimation = decimation;
+    f->in_channels = in_channels;
+    f->out_channels = out_channels;
+    f->samples = samples;
+    f->step = r / 8;
+    f->window = SINC_ORDER * r / 8;
+
+    // Full scale of the sinc stage is r^4, it maps to full scale PCM at 0dB
+    float scale = powf(10.0f, gain_db / 20.0f) * 32767.0f / powf(r, SINC_ORDER);
+    f->gain = (int32_t)(scale * 65536.0f + 0.5f);
+    f->hp_coef = (highpass > 0.0f && highpass < 1.0f) ? (int32_t)(highpass * 2147483647.0f) : 0;
+
+    f->lut = malloc(f->window * 256 * sizeof(int32_t));
+    if (f->lut == NULL || sinc_lut_init(f, r) != 0) {
+        pdm_filter_deinit(f);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < out_channels; i++) {
+        pdm_filter_channel_t *ch = &f->ch[i];
+        ch->bits = malloc(f->window - f->step + samples * decimation / 8);
+        ch->even = malloc((PDM_FILTER_HB_TAPS - 1 + samples) * sizeof(int16_t));
+        ch->odd = malloc((PDM_FILTER_HB_TAPS / 2 + samples) * sizeof(int16_t));
+        if (ch->bits == NULL || ch->even == NULL || ch->odd == NULL) {
+            pdm_filter_deinit(f);
+            return -1;
+        }
+    }
+    pdm_filter_reset(f);
+    return 0;
+}
+
+void pdm_filter_deinit(pdm_filter_t *f)
+{
+    free(f->lut);
+    f->lut = NULL;
+    for (uint32_t i = 0; i < PDM_FILTER_MAX_CHANNELS; i++) {
+        free(f->ch[i].bits);
+        free(f->ch[i].even);
+        free(f->ch[i].odd);
+        memset(&f->ch[i], 0, sizeof(f->ch[i]));
+    }
+}
+
+void pdm_filter_reset(pdm_filter_t *f)
+{
+    for (uint32_t i = 0; i < f->out_channels; i++) {
+        pdm_filter_channel_t *ch = &f->ch[i];
+        // Alternating bits are a PDM zero
+        memset(ch->bits, 0x55, f->window - f->step);
+        memset(ch->even, 0, (PDM_FILTER_HB_TAPS - 1) * sizeof(int16_t));
+        memset(ch->odd, 0, (PDM_FILTER_HB_TAPS / 2) * sizeof(int16_t));
+        ch->hp_x = 0;
+        ch->hp_y = 0;
+    }
+}
+
+static inline int32_t halfband(const int16_t *x, int32_t acc)
+{
+#ifdef PDM_FILTER_USE_DSP
+    // Two taps per instruction; unaligned word loads are fine on Cortex-M4/M7
+    for (int i = 0; i < PDM_FILTER_HB_TAPS; i += 2) {
+        uint32_t xx, cc;
+        memcpy(&xx, &x[i], sizeof(xx));
+        memcpy(&cc, &hb_coefs[i], sizeof(cc));
+        acc = __SMLAD(xx, cc, acc);
+    }
+#else
+    for (int i = 0; i < PDM_FILTER_HB_TAPS; i++) {
+        acc += x[i] * hb_coefs[i];
+    }
+#endif
+    return acc;
+}
+
+static void filter_channel(pdm_filter_t *f, pdm_filter_channel_t *ch,
+                           const uint8_t *in, int16_t *out)
+{
+    const uint32_t history = f->window - f->step;
+    const uint32_t nbytes = f->samples * f->decimation / 8;
+
+    // Pick this channel's bytes out of the interleaved block
+    uint8_t *bits = ch->bits + history;
+    for (uint32_t i = 0; i < nbytes; i++) {
+        bits[i] = in[i * f->in_channels];
+    }
+
+    // Sinc stage, two outputs per PCM sample, alternately to even and odd
+    int16_t *even = ch->even + PDM_FILTER_HB_TAPS - 1;
+    int16_t *odd = ch->odd + PDM_FILTER_HB_TAPS / 2;
+    const uint8_t *p = ch->bits;
+    for (uint32_t n = 0; n < f->samples * 2; n++, p += f->step) {
+        const int32_t *lut = f->lut;
+        int32_t acc = 0;
+        for (uint32_t j = 0; j < f->window; j++, lut += 256) {
+            acc += lut[p[j]];
+        }
+        int16_t s = sat16((int32_t)(((int64_t)acc * f->gain) >> 16));
+        if (n & 1) {
+            odd[n / 2] = s;
+        } else {
+            even[n / 2] = s;
+        }
+    }
+
+    // Half-band stage: even samples go through the side taps, the odd one
+    // halfway back in time through the center tap
+    for (uint32_t m = 0; m < f->samples; m++) {
+        int32_t acc = halfband(&ch->even[m], ch->odd[m] * 16384);
+        int32_t x = acc >> 15;
+
+        if (f->hp_coef) {
+            int32_t x8 = x << 8;
+            ch->hp_y = x8 - ch->hp_x + (int32_t)(((int64_t)ch->hp_y * f->hp_coef) >> 31);
+            ch->hp_x = x8;
+            x = ch->hp_y >> 8;
+        }
+        if (out != NULL) {
+            out[m * f->out_channels] = sat16(x);
+        }
+    }
+
+    // Keep what the next block needs
+    memmove(ch->bits, ch->bits + nbytes, history);
+    memmove(ch->even, ch->even + f->samples, (PDM_FILTER_HB_TAPS - 1) * sizeof(int16_t));
+    memmove(ch->odd, ch->odd + f->samples, (PDM_FILTER_HB_TAPS / 2) * sizeof(int16_t));
+}
+
+void pdm_filter_process(pdm_filter_t *f, const uint8_t *in, int16_t *out)
+{
+    // Mono output takes the last microphone, as the ST library did
+    uint32_t first = f->in_channels - f->out_channels;
+    if (f->out_channels > 1) {
+        first = 0;
+    }
+    for (uint32_t i = 0; i < f->out_channels; i++) {
+        filter_channel(f, &f->ch[i], in + first + i, (out != NULL) ? out + i : NULL);
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * PDM to PCM decimation filter.
+ *
+ * The 1-bit stream is decimated in two stages:
+ *  - a 4th order sinc (CIC) filter down to twice the output rate. It is run
+ *    as a FIR over whole bytes of the bitstream, one table lookup per byte.
+ *  - a 47 taps half-band FIR down to the output rate, with the Cortex-M DSP
+ *    extension (SMLAD) when it is available and plain C otherwise.
+ * followed by the gain and an optional one pole high-pass (DC removal) filter.
+ *
+ * The input is byte interleaved, as the SAI delivers it in PDM mode: one byte
+ * (8 bits, MSB first) of each microphone in turn. The output is interleaved
+ * signed 16 bit PCM.
+ */
+#ifndef __PDM_FILTER_H__
+#define __PDM_FILTER_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PDM_FILTER_MAX_CHANNELS     (4)
+// Non-zero taps of the half-band filter, besides the center one
+#define PDM_FILTER_HB_TAPS          (24)
+
+typedef struct {
+    uint8_t *bits;      // Bitstream history, followed by the bytes of the current block
+    int16_t *even;      // Even and odd samples out of the sinc stage, with
+    int16_t *odd;       // the history the half-band filter needs
+    int32_t hp_x;       // High-pass filter state, Q8
+    int32_t hp_y;
+} pdm_filter_channel_t;
+
+typedef struct {
+    uint32_t decimation;
+    uint32_t in_channels;
+    uint32_t out_channels;
+    uint32_t samples;           // Output samples per channel per call
+    uint32_t step;              // Input bytes per sinc stage output
+    uint32_t window;            // Input bytes seen by each sinc stage output
+    int32_t gain;               // Sinc stage output to PCM, Q16, includes the gain
+    int32_t hp_coef;            // Q31, 0 disables the high-pass filter
+    int32_t *lut;               // Sinc stage contribution of each byte value, for each byte of the window
+    pdm_filter_channel_t ch[PDM_FILTER_MAX_CHANNELS];
+} pdm_filter_t;
+
+// Decimation can be 16, 32, 48, 64, 80, 96 or 128. The output keeps the first
+// out_channels input channels, or the last input channel for mono output.
+// Returns 0 on success, -1 on bad arguments or if memory runs out.
+int pdm_filter_init(pdm_filter_t *f, uint32_t decimation, uint32_t in_channels,
+                    uint32_t out_channels, uint32_t samples, int gain_db, float highpass);
+void pdm_filter_deinit(pdm_filter_t *f);
+void pdm_filter_reset(pdm_filter_t *f);
+
+// Converts samples * decimation / 8 * in_channels bytes of PDM data into
+// samples * out_channels PCM samples. With a NULL out the block only goes
+// through the filter state, when there is nowhere to store it.
+void pdm_filter_process(pdm_filter_t *f, const uint8_t *in, int16_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __PDM_FILTER_H__
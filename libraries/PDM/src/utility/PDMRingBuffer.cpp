@@ -0,0 +1,189 @@
+/*
+  Copyright (c) 2016 Arduino LLC.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "PDMRingBuffer.h"
+
+PDMRingBuffer::PDMRingBuffer() :
+  _buffer(NULL),
+  _size(DEFAULT_PDM_BUFFER_SIZE),
+  _count(DEFAULT_PDM_BUFFER_COUNT),
+  _blocks(NULL)
+{
+  reset();
+}
+
+PDMRingBuffer::~PDMRingBuffer()
+{
+  free(_buffer);
+  free(_blocks);
+}
+
+void PDMRingBuffer::setSize(int size)
+{
+  _size = size;
+  reset();
+}
+
+void PDMRingBuffer::setCount(int count)
+{
+  _count = (count < 2) ? 2 : count;
+  reset();
+}
+
+void PDMRingBuffer::reset()
+{
+  _buffer = (uint8_t*)realloc(_buffer, _size * _count);
+  _blocks = (PDMBlock*)realloc(_blocks, sizeof(PDMBlock) * _count);
+
+  if (_buffer == NULL || _blocks == NULL) {
+    free(_buffer);
+    free(_blocks);
+    _buffer = NULL;
+    _blocks = NULL;
+    _size = 0;
+    _count = 0;
+  } else {
+    memset(_buffer, 0x00, _size * _count);
+    memset(_blocks, 0x00, sizeof(PDMBlock) * _count);
+  }
+
+  _head = 0;
+  _tail = 0;
+  _readOffset = 0;
+  _sequence = 0;
+  _overruns = 0;
+}
+
+uint8_t* PDMRingBuffer::slot(uint32_t index)
+{
+  return &_buffer[(index % _count) * _size];
+}
+
+void* PDMRingBuffer::writeBlock(int ahead)
+{
+  uint32_t head = _head.load(std::memory_order_relaxed);
+  uint32_t tail = _tail.load(std::memory_order_acquire);
+
+  // The block is free only once the consumer released it
+  if (_count == 0 || head + ahead - tail >= (uint32_t)_count) {
+    return NULL;
+  }
+  return slot(head + ahead);
+}
+
+void PDMRingBuffer::commit(uint32_t timestamp)
+{
+  uint32_t head = _head.load(std::memory_order_relaxed);
+  PDMBlock& block = _blocks[head % _count];
+
+  block.data = slot(head);
+  block.size = _size;
+  block.timestamp = timestamp;
+  block.sequence = _sequence++;
+
+  // Publish the data and the descriptor together
+  _head.store(head + 1, std::memory_order_release);
+}
+
+void PDMRingBuffer::overrun()
+{
+  _sequence++;
+  _overruns = _overruns + 1;
+}
+
+int PDMRingBuffer::blocksAvailable()
+{
+  return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+}
+
+size_t PDMRingBuffer::available()
+{
+  // Only what is left of the oldest block, as one read() of that size
+  // never mixes blocks
+  if (blocksAvailable() == 0) {
+    return 0;
+  }
+  return _size - _readOffset;
+}
+
+size_t PDMRingBuffer::read(void *buffer, size_t size)
+{
+  size_t read = 0;
+
+  while (read < size && blocksAvailable() > 0) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    size_t chunk = _size - _readOffset;
+
+    if (chunk > size - read) {
+      chunk = size - read;
+    }
+    memcpy((uint8_t*)buffer + read, slot(tail) + _readOffset, chunk);
+    read += chunk;
+    _readOffset += chunk;
+
+    if (_readOffset == (size_t)_size) {
+      release();
+    }
+  }
+
+  return read;
+}
+
+size_t PDMRingBuffer::peek(void *buffer, size_t size)
+{
+  size_t avail = available();
+
+  if (size > avail) {
+    size = avail;
+  }
+
+  if (size == 0) {
+    return 0;
+  }
+
+  memcpy(buffer, slot(_tail.load(std::memory_order_relaxed)) + _readOffset, size);
+
+  return size;
+}
+
+const PDMBlock* PDMRingBuffer::acquire()
+{
+  if (blocksAvailable() == 0) {
+    return NULL;
+  }
+
+  // The descriptor stays valid until release(), the producer does not
+  // reuse the slot before
+  _acquired = _blocks[_tail.load(std::memory_order_relaxed) % _count];
+  _acquired.data = (const uint8_t*)_acquired.data + _readOffset;
+  _acquired.size -= _readOffset;
+  return &_acquired;
+}
+
+void PDMRingBuffer::release()
+{
+  if (blocksAvailable() == 0) {
+    return;
+  }
+
+  _readOffset = 0;
+  _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
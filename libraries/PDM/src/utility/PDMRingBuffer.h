@@ -0,0 +1,85 @@
+/*
+  Copyright (c) 2016 Arduino LLC.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _PDM_RING_BUFFER_H_INCLUDED
+#define _PDM_RING_BUFFER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define DEFAULT_PDM_BUFFER_SIZE 512
+#define DEFAULT_PDM_BUFFER_COUNT 4
+
+struct PDMBlock
+{
+  const void* data;
+  size_t size;          // bytes
+  uint32_t timestamp;   // micros() when the block was complete
+  uint32_t sequence;    // block number since begin(), blocks lost to overruns included
+};
+
+// Ring of fixed size blocks between the PDM interrupt (the only producer)
+// and the sketch (the only consumer). Neither side ever waits for the other:
+// when the ring is full the producer loses the block it is filling and counts
+// an overrun, but never touches a block the consumer may be reading.
+class PDMRingBuffer
+{
+public:
+  PDMRingBuffer();
+  virtual ~PDMRingBuffer();
+
+  void setSize(int size);
+  void setCount(int count);
+  int size() { return _size; }
+
+  void reset();
+
+  // Producer side
+  void* writeBlock(int ahead = 0);
+  void commit(uint32_t timestamp);
+  void overrun();
+
+  // Consumer side
+  size_t available();
+  int blocksAvailable();
+  size_t read(void *buffer, size_t size);
+  size_t peek(void *buffer, size_t size);
+  const PDMBlock* acquire();
+  void release();
+
+  uint32_t overruns() { return _overruns; }
+
+private:
+  uint8_t* slot(uint32_t index);
+
+  uint8_t* _buffer;
+  int _size;
+  int _count;
+  PDMBlock* _blocks;
+  PDMBlock _acquired;
+  // Free running block counters, _head is only written by the producer and
+  // _tail by the consumer
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _tail;
+  size_t _readOffset;
+  uint32_t _sequence;
+  volatile uint32_t _overruns;
+};
+
+#endif
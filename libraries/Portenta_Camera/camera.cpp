@@ -1,6 +1,7 @@
 #include "Arduino.h"
 #include "himax.h"
 #include "camera.h"
+#include "MemoryRegions.h"
 #include "stm32h7xx_hal_dcmi.h"
 
 #define CAMERA_FRAME_BUFFER               0xC0200000
@@ -11,9 +12,84 @@ static const int CamRes[][2] = {
     {160, 120},
     {320, 240},
 };
+
+/* What reaches memory: the sensor output, in QVGA or 2x2 binned QQVGA mode,
+   is cropped by the DCMI, which can then also keep only every other pixel
+   of every other line. */
+typedef struct {
+  uint32_t sensor_res;
+  uint32_t crop_x;          /* Crop window, in sensor pixels */
+  uint32_t crop_y;
+  uint32_t crop_w;
+  uint32_t crop_h;
+  uint32_t decimation;      /* 1 or 2 */
+  uint32_t width;           /* Frame stored in memory */
+  uint32_t height;
+} camera_window_t;
+
+/**
+  * @brief  Maps a region of interest to the sensor mode and DCMI settings.
+  * @param  resolution : resolution the region is given in
+  * @param  x, y, w, h : region of interest, multiples of the binning factor
+  * @param  binning : 1, 2 or 4, the width of the frame (w / binning) must
+  *         be a multiple of 4 for the 32 bits DMA transfers
+  * @retval 0 on success, -1 if the combination is not supported
+  */
+static int camera_window(uint32_t resolution, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                         uint32_t binning, camera_window_t *win)
+{
+  if (resolution >= CAMERA_RMAX || w == 0 || h == 0 ||
+      (x + w) > (uint32_t)CamRes[resolution][0] || (y + h) > (uint32_t)CamRes[resolution][1]) {
+    return -1;
+  }
+  if (binning != 1 && binning != 2 && binning != 4) {
+    return -1;
+  }
+  if ((x % binning) || (y % binning) || (w % binning) || (h % binning) || ((w / binning) % 4)) {
+    return -1;
+  }
+
+  /* Overall reduction from the QVGA frame: the sensor bins up to 2x,
+     the DCMI decimates the rest */
+  uint32_t scale = (resolution == CAMERA_R160x120) ? 2 : 1;
+  uint32_t total = scale * binning;
+  if (total > 4) {
+    return -1;
+  }
+  uint32_t sensor_bin = (total >= 2) ? 2 : 1;
+
+  win->sensor_res = (sensor_bin == 2) ? CAMERA_R160x120 : CAMERA_R320x240;
+  win->decimation = total / sensor_bin;
+  win->crop_x = x * scale / sensor_bin;
+  win->crop_y = y * scale / sensor_bin;
+  win->crop_w = w * scale / sensor_bin;
+  win->crop_h = h * scale / sensor_bin;
+  win->width = w / binning;
+  win->height = h / binning;
+  return 0;
+}
 static __IO uint32_t camera_frame_ready = 0;
 static md_callback_t user_md_callback = NULL;
 
+/* Streaming state: frames are captured back to back into a ring of buffers.
+   head counts the frames captured, it is only written by the DCMI interrupt,
+   tail counts the frames released, it is only written by the sketch. */
+static struct {
+  volatile bool active;
+  uint8_t *buffers;
+  void *allocated;
+  void *pooled;
+  camera_frame_t *frames;
+  uint32_t count;
+  uint32_t framesize;
+  uint32_t stride;
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t dropped;
+  uint32_t sequence;
+  frame_callback_t callback;
+} stream;
+
 /* DCMI DMA Stream definitions */
 #define CAMERA_DCMI_DMAx_CLK_ENABLE         __HAL_RCC_DMA2_CLK_ENABLE
 #define CAMERA_DCMI_DMAx_STREAM             DMA2_Stream3
@@ -156,11 +232,10 @@ uint32_t BSP_CAMERA_GetRotation(void)
 
 /**
   * @brief  Initializes the camera.
-  * @param  Resolution : camera sensor requested resolution (x, y) : standard resolution
-  *         naming QQVGA, QVGA, VGA ...
+  * @param  win : sensor mode, crop window and decimation
   * @retval Camera status
   */
-uint8_t BSP_CAMERA_Init(uint32_t Resolution)
+uint8_t BSP_CAMERA_Init(const camera_window_t *win)
 {
   DCMI_HandleTypeDef *phdcmi;
   uint8_t status = -1;
@@ -176,10 +251,17 @@ uint8_t BSP_CAMERA_Init(uint32_t Resolution)
   phdcmi->Init.VSPolarity       = DCMI_VSPOLARITY_LOW;
   phdcmi->Init.ExtendedDataMode = DCMI_EXTEND_DATA_8B;
   phdcmi->Init.PCKPolarity      = DCMI_PCKPOLARITY_FALLING;
-  phdcmi->Init.ByteSelectMode   = DCMI_BSM_ALL;         // Capture all received bytes
-  phdcmi->Init.ByteSelectStart  = DCMI_OEBS_ODD;        // Ignored
-  phdcmi->Init.LineSelectMode   = DCMI_LSM_ALL;         // Capture all received lines
-  phdcmi->Init.LineSelectStart  = DCMI_OELS_ODD;        // Ignored
+  if (win->decimation == 2) {
+    phdcmi->Init.ByteSelectMode   = DCMI_BSM_OTHER;     // Capture every other byte
+    phdcmi->Init.ByteSelectStart  = DCMI_OEBS_ODD;      // Starting with the first one
+    phdcmi->Init.LineSelectMode   = DCMI_LSM_ALTERNATE_2; // Capture every other line
+    phdcmi->Init.LineSelectStart  = DCMI_OELS_ODD;      // Starting with the first one
+  } else {
+    phdcmi->Init.ByteSelectMode   = DCMI_BSM_ALL;       // Capture all received bytes
+    phdcmi->Init.ByteSelectStart  = DCMI_OEBS_ODD;      // Ignored
+    phdcmi->Init.LineSelectMode   = DCMI_LSM_ALL;       // Capture all received lines
+    phdcmi->Init.LineSelectStart  = DCMI_OELS_ODD;      // Ignored
+  }
   phdcmi->Instance              = DCMI;
 
   /* Power up camera */
@@ -197,8 +279,10 @@ uint8_t BSP_CAMERA_Init(uint32_t Resolution)
   * @param  YSize DCMI Line number
   * @retval HAL status
   */
+  /* The crop applies to the sensor output, before the byte and line selection,
+     so the pixels outside of the window are never transferred */
   HAL_DCMI_EnableCROP(phdcmi);
-  HAL_DCMI_ConfigCROP(phdcmi, 0, 0, CamRes[Resolution][0] - 1, CamRes[Resolution][1] - 1);
+  HAL_DCMI_ConfigCROP(phdcmi, win->crop_x, win->crop_y, win->crop_w - 1, win->crop_h - 1);
 
   __HAL_DCMI_DISABLE_IT(&hdcmi_discovery, DCMI_IT_LINE);
 
@@ -378,8 +462,46 @@ void BSP_CAMERA_ErrorCallback(void)
 {
 }
 
+/**
+  * @brief  Ends a frame in streaming mode and starts the capture of the next one.
+  * @retval None
+  */
+static void BSP_CAMERA_StreamFrame(void)
+{
+  uint32_t head = stream.head;
+  bool captured = false;
+
+  if (HAL_DMA_GetState(hdcmi_discovery.DMA_Handle) != HAL_DMA_STATE_READY) {
+    /* Short frame, the DMA is still waiting for the rest of it */
+    HAL_DMA_Abort(hdcmi_discovery.DMA_Handle);
+    stream.dropped++;
+  } else if (head + 1 - stream.tail < stream.count) {
+    camera_frame_t *frame = &stream.frames[head % stream.count];
+    frame->timestamp = micros();
+    frame->sequence = stream.sequence;
+    /* Publish the frame after its descriptor */
+    __DMB();
+    stream.head = ++head;
+    captured = true;
+  } else {
+    /* No free buffer for the next frame, the last one is captured over */
+    stream.dropped++;
+  }
+  stream.sequence++;
+
+  BSP_CAMERA_SnapshotStart(stream.buffers + (head % stream.count) * stream.stride, stream.framesize);
+
+  if (captured && stream.callback) {
+    stream.callback();
+  }
+}
+
 void BSP_CAMERA_FrameEventCallback(void)
 {
+  if (stream.active) {
+    BSP_CAMERA_StreamFrame();
+    return;
+  }
   camera_frame_ready++;
 }
 
@@ -463,15 +585,26 @@ int CameraClass::begin(uint32_t resolution, uint32_t framerate)
   if (resolution >= CAMERA_RMAX) {
     return -1;
   }
+  return begin(resolution, framerate, 0, 0, CamRes[resolution][0], CamRes[resolution][1]);
+}
+
+int CameraClass::begin(uint32_t resolution, uint32_t framerate, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                       uint32_t binning)
+{
+  camera_window_t win;
+
+  if (camera_window(resolution, x, y, w, h, binning, &win) != 0) {
+    return -1;
+  }
 
   /*## Camera Initialization and capture start ############################*/
   /* Initialize the Camera in QVGA mode */
-  if(BSP_CAMERA_Init(resolution) != 0)
+  if(BSP_CAMERA_Init(&win) != 0)
   {
     return -1;
   }
 
-  if (HIMAX_SetResolution(resolution) != 0) {
+  if (HIMAX_SetResolution(win.sensor_res) != 0) {
     return -1;
   }
 
@@ -486,6 +619,9 @@ int CameraClass::begin(uint32_t resolution, uint32_t framerate)
   user_md_callback = NULL;
   this->initialized = true;
   this->resolution = resolution;
+  this->sensor_res = win.sensor_res;
+  this->width = win.width;
+  this->height = win.height;
   return 0;
 }
 
@@ -499,14 +635,14 @@ int CameraClass::framerate(uint32_t framerate)
 
 int CameraClass::grab(uint8_t *buffer, uint32_t timeout)
 {
-  if (this->initialized == false) {
+  if (this->initialized == false || stream.active) {
     return -1;
   }
 
   BSP_CAMERA_Resume();
 
-  /* Frame size from resolution. */
-  uint32_t framesize = CamRes[this->resolution][0] * CamRes[this->resolution][1];
+  /* Frame size from the capture window. */
+  uint32_t framesize = frameSize();
 
   camera_frame_ready = 0;
 
@@ -526,12 +662,153 @@ int CameraClass::grab(uint8_t *buffer, uint32_t timeout)
   /* which cause perturbation of LTDC                                      */
   BSP_CAMERA_Suspend();
 
+  /* Invalidate buffer after DMA transfer, if it is cached at all */
+  MemoryRegions.invalidate(buffer, framesize);
+
+  return 0;
+}
+
+uint32_t CameraClass::frameSize()
+{
+  if (this->initialized == false) {
+    return 0;
+  }
+  return this->width * this->height;
+}
+
+uint32_t CameraClass::frameWidth()
+{
+  return (this->initialized == false) ? 0 : this->width;
+}
+
+uint32_t CameraClass::frameHeight()
+{
+  return (this->initialized == false) ? 0 : this->height;
+}
+
+int CameraClass::startStreaming(uint8_t *buffers, uint32_t count, frame_callback_t callback)
+{
+  if (this->initialized == false || stream.active || count < 2) {
+    return -1;
+  }
+
+  uint32_t framesize = frameSize();
+  /* The buffers are invalidated frame by frame, each one must start on a cache line */
+  uint32_t stride = (framesize + 31) & ~31UL;
+
+  stream.allocated = NULL;
+  stream.pooled = NULL;
+  if (buffers == NULL) {
+    /* From the DMA pool when the sketch set one up, no cache maintenance then */
+    stream.pooled = MemoryRegions.malloc(MEMORY_POOL_DMA, stride * count);
+    buffers = (uint8_t*)stream.pooled;
+  }
+  if (buffers == NULL) {
+    stream.allocated = malloc(stride * count + 31);
+    if (stream.allocated == NULL) {
+      return -1;
+    }
+    buffers = (uint8_t*)(((uint32_t)stream.allocated + 31) & ~31UL);
+  } else if (((uint32_t)buffers & 31) != 0) {
+    return -1;
+  }
+
+  stream.frames = (camera_frame_t*)malloc(count * sizeof(camera_frame_t));
+  if (stream.frames == NULL) {
+    free(stream.allocated);
+    MemoryRegions.free(stream.pooled);
+    stream.allocated = NULL;
+    stream.pooled = NULL;
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    stream.frames[i].buffer = buffers + i * stride;
+    stream.frames[i].size = framesize;
+    stream.frames[i].timestamp = 0;
+    stream.frames[i].sequence = 0;
+  }
+  stream.buffers = buffers;
+  stream.count = count;
+  stream.framesize = framesize;
+  stream.stride = stride;
+  stream.head = 0;
+  stream.tail = 0;
+  stream.dropped = 0;
+  stream.sequence = 0;
+  stream.callback = callback;
+
+  /* Nothing cached may be written back over the frames */
+  MemoryRegions.clean(buffers, stride * count);
+  MemoryRegions.invalidate(buffers, stride * count);
+
+  stream.active = true;
+  BSP_CAMERA_Resume();
+  BSP_CAMERA_SnapshotStart(buffers, framesize);
+  return 0;
+}
+
+int CameraClass::stopStreaming()
+{
+  if (stream.active == false) {
+    return -1;
+  }
+
+  stream.active = false;
+  BSP_CAMERA_Stop();
+
+  free(stream.frames);
+  free(stream.allocated);
+  MemoryRegions.free(stream.pooled);
+  stream.frames = NULL;
+  stream.allocated = NULL;
+  stream.pooled = NULL;
+  return 0;
+}
+
+camera_frame_t *CameraClass::acquireFrame(uint32_t timeout)
+{
+  if (stream.active == false) {
+    return NULL;
+  }
+
+  /* Wait until a frame is captured : DCMI Frame event */
+  for (uint32_t start = millis(); stream.head == stream.tail;) {
+    if ((millis() - start) >= timeout) {
+      return NULL;
+    }
+    __WFI();
+  }
+
+  camera_frame_t *frame = &stream.frames[stream.tail % stream.count];
+
   /* Invalidate buffer after DMA transfer */
-  SCB_InvalidateDCache_by_Addr((uint32_t*)buffer, framesize);
+  MemoryRegions.invalidate(frame->buffer, frame->size);
 
+  return frame;
+}
+
+int CameraClass::releaseFrame()
+{
+  if (stream.active == false || stream.head == stream.tail) {
+    return -1;
+  }
+
+  camera_frame_t *frame = &stream.frames[stream.tail % stream.count];
+
+  /* The sketch may have worked in place, drop what it wrote before
+     the DMA gets the buffer back */
+  MemoryRegions.invalidate(frame->buffer, frame->size);
+
+  stream.tail = stream.tail + 1;
   return 0;
 }
 
+uint32_t CameraClass::droppedFrames()
+{
+  return stream.dropped;
+}
+
 int CameraClass::standby(bool enable)
 {
   if (this->initialized == false) {
@@ -565,6 +842,13 @@ int CameraClass::motionDetectionWindow(uint32_t x, uint32_t y, uint32_t w, uint3
   if (((x+w) > width) || ((y+h) > height)) {
       return -1;
   }
+
+  /* The sensor may be binning on behalf of the resolution asked for */
+  uint32_t scale = width / CamRes[this->sensor_res][0];
+  x /= scale;
+  y /= scale;
+  w /= scale;
+  h /= scale;
   return HIMAX_SetLROI(x, y, x+w, y+h);
 }
 
@@ -6,19 +6,46 @@ enum {
     CAMERA_RMAX
 };
 
+enum {
+    CAMERA_BINNING_1X = 1,
+    CAMERA_BINNING_2X = 2,    /* Averaged by the sensor */
+    CAMERA_BINNING_4X = 4,    /* Averaged 2x by the sensor, then every other pixel */
+};
+
 typedef void (*md_callback_t)();
+typedef void (*frame_callback_t)();
+
+typedef struct {
+    uint8_t  *buffer;
+    uint32_t size;
+    uint32_t timestamp;     // micros() at the end of the frame
+    uint32_t sequence;      // Frame number since startStreaming(), dropped frames included
+} camera_frame_t;
 
 class CameraClass {
     private:
         uint32_t resolution;
+        uint32_t sensor_res;
+        uint32_t width;
+        uint32_t height;
         bool     initialized;
         mbed::InterruptIn md_irq;
         void HIMAXIrqHandler();
     public:
         CameraClass(): initialized(false), md_irq(PC_15){}
         int begin(uint32_t resolution = CAMERA_R320x240, uint32_t framerate = 30);
+        int begin(uint32_t resolution, uint32_t framerate, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                  uint32_t binning = CAMERA_BINNING_1X);
+        uint32_t frameWidth();
+        uint32_t frameHeight();
         int framerate(uint32_t framerate);
         int grab(uint8_t *buffer, uint32_t timeout=5000);
+        uint32_t frameSize();
+        int startStreaming(uint8_t *buffers, uint32_t count, frame_callback_t callback=NULL);
+        int stopStreaming();
+        camera_frame_t *acquireFrame(uint32_t timeout=5000);
+        int releaseFrame();
+        uint32_t droppedFrames();
         int standby(bool enable);
         int motionDetection(bool enable, md_callback_t callback=NULL);
         int motionDetectionWindow(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
@@ -0,0 +1,56 @@
+#include "camera.h"
+
+CameraClass cam;
+
+// Three QVGA frames: one being captured while the sketch works on another,
+// and one spare so a slow frame does not make the camera drop the next one
+#define FRAME_COUNT 3
+uint8_t fb[FRAME_COUNT][320*240] __attribute__((aligned(32)));
+
+void setup() {
+  Serial.begin(115200);
+
+  // Init the cam QVGA, 30FPS
+  cam.begin(CAMERA_R320x240, 30);
+
+  // Capture continuously, the buffers could also be in SDRAM
+  if (cam.startStreaming(&fb[0][0], FRAME_COUNT) != 0) {
+    Serial.println("Failed to start streaming!");
+    while (1);
+  }
+}
+
+void loop() {
+  static uint32_t frames = 0;
+  static uint32_t last = millis();
+
+  camera_frame_t *frame = cam.acquireFrame();
+  if (frame == NULL) {
+    Serial.println("No frame!");
+    return;
+  }
+
+  // Work on the frame while the next one is captured
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < frame->size; i++) {
+    sum += frame->buffer[i];
+  }
+  uint32_t mean = sum / frame->size;
+  uint32_t sequence = frame->sequence;
+
+  cam.releaseFrame();
+  frames++;
+
+  if (millis() - last >= 1000) {
+    Serial.print("fps: ");
+    Serial.print(frames * 1000.0f / (millis() - last));
+    Serial.print(" mean: ");
+    Serial.print(mean);
+    Serial.print(" sequence: ");
+    Serial.print(sequence);
+    Serial.print(" dropped: ");
+    Serial.println(cam.droppedFrames());
+    frames = 0;
+    last = millis();
+  }
+}
@@ -0,0 +1,145 @@
+#include "camera.h"
+#include "image_kernels.h"
+
+/**
+ * Runs the image preprocessing kernels on a camera frame, prints the CPU
+ * cycles each one takes per pixel and checks its output against a plain,
+ * pixel by pixel implementation.
+ **/
+
+#define W 320
+#define H 240
+
+CameraClass cam;
+uint8_t frame[W * H] __attribute__((aligned(32)));
+uint8_t prev[W * H];
+uint8_t out[W * H];
+uint8_t small[96 * 96];
+
+static uint32_t start;
+
+static void tic() {
+  start = DWT->CYCCNT;
+}
+
+static uint32_t toc() {
+  return DWT->CYCCNT - start;
+}
+
+static void report(const char *name, uint32_t cycles, uint32_t pixels, bool ok) {
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print((float)cycles / pixels);
+  Serial.print(" cycles/pixel ");
+  Serial.println(ok ? "OK" : "MISMATCH");
+}
+
+static bool checkBox() {
+  for (int y = 1; y < H - 1; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      int sum = 0;
+      for (int j = -1; j <= 1; j++) {
+        for (int i = -1; i <= 1; i++) {
+          sum += frame[(y + j) * W + x + i];
+        }
+      }
+      if (out[y * W + x] != (sum + 4) / 9) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool checkSobel() {
+  for (int y = 1; y < H - 1; y++) {
+    for (int x = 1; x < W - 1; x++) {
+      const uint8_t *p = &frame[y * W + x];
+      int gx = (p[-W + 1] + 2 * p[1] + p[W + 1]) - (p[-W - 1] + 2 * p[-1] + p[W - 1]);
+      int gy = (p[W - 1] + 2 * p[W] + p[W + 1]) - (p[-W - 1] + 2 * p[-W] + p[-W + 1]);
+      if (out[y * W + x] != min(abs(gx) + abs(gy), 255)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool checkDiff(uint32_t count) {
+  uint32_t expected = 0;
+  for (int i = 0; i < W * H; i++) {
+    bool changed = abs(frame[i] - prev[i]) > 16;
+    if (out[i] != (changed ? 255 : 0)) {
+      return false;
+    }
+    expected += changed;
+  }
+  return count == expected;
+}
+
+static bool checkInt8() {
+  for (int i = 0; i < W * H; i++) {
+    if ((int8_t)out[i] != frame[i] - 128) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  cam.begin(CAMERA_R320x240, 30);
+
+  // Enable the cycle counter
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void loop() {
+  uint32_t cycles;
+
+  memcpy(prev, frame, sizeof(frame));
+  if (cam.grab(frame) != 0) {
+    Serial.println("No frame!");
+    return;
+  }
+
+  tic();
+  image_resize_bilinear(frame, W, H, small, 96, 96);
+  cycles = toc();
+  report("resize 320x240 to 96x96", cycles, 96 * 96, true);
+
+  tic();
+  image_to_int8(frame, (int8_t*)out, W * H);
+  cycles = toc();
+  report("to int8", cycles, W * H, checkInt8());
+
+  tic();
+  image_normalize_int8(frame, (int8_t*)out, W * H, 0.5f, 0.25f, 1.0f / 32, 0);
+  cycles = toc();
+  report("normalize int8", cycles, W * H, true);
+
+  tic();
+  image_box3x3(frame, out, W, H);
+  cycles = toc();
+  report("box 3x3", cycles, W * H, checkBox());
+
+  tic();
+  image_sobel3x3(frame, out, W, H);
+  cycles = toc();
+  report("sobel 3x3", cycles, W * H, checkSobel());
+
+  tic();
+  uint32_t changed = image_diff_mask(frame, prev, out, W * H, 16);
+  cycles = toc();
+  report("diff mask", cycles, W * H, checkDiff(changed));
+
+  Serial.print("changed pixels: ");
+  Serial.println(changed);
+  Serial.println();
+
+  delay(1000);
+}
@@ -0,0 +1,280 @@
+/*
+ * Preprocessing kernels for 8 bit grayscale camera frames, see image_kernels.h.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "image_kernels.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#define IMAGE_USE_DSP
+#endif
+
+// Columns of the 3x3 filters handled per pass, the vertical sums of a pass
+// are kept on the stack
+#define FILTER_CHUNK    (64)
+
+static inline uint32_t load4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void store4(uint8_t *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint8_t sat8(int32_t x)
+{
+    return (x < 0) ? 0 : (x > 255) ? 255 : x;
+}
+
+int image_resize_bilinear(const uint8_t *src, uint32_t src_w, uint32_t src_h,
+                          uint8_t *dst, uint32_t dst_w, uint32_t dst_h)
+{
+    // The Q16 positions below must fit in an int32_t
+    if (src_w == 0 || src_h == 0 || dst_w == 0 || dst_h == 0 ||
+        src_w > 32768 || src_h > 32768 || dst_w > 32768 || dst_h > 32768) {
+        return -1;
+    }
+
+    // Source position of the destination pixel centers, Q16
+    int32_t step_x = (int32_t)(((uint64_t)src_w << 16) / dst_w);
+    int32_t step_y = (int32_t)(((uint64_t)src_h << 16) / dst_h);
+    int32_t max_x = (int32_t)(src_w - 1) << 16;
+    int32_t max_y = (int32_t)(src_h - 1) << 16;
+
+    int32_t sy = step_y / 2 - 0x8000;
+    for (uint32_t y = 0; y < dst_h; y++, sy += step_y) {
+        int32_t cy = (sy < 0) ? 0 : (sy > max_y) ? max_y : sy;
+        uint32_t y0 = cy >> 16;
+        uint32_t fy = (cy >> 8) & 0xFF;
+        const uint8_t *r0 = src + y0 * src_w;
+        const uint8_t *r1 = (y0 + 1 < src_h) ? r0 + src_w : r0;
+
+        int32_t sx = step_x / 2 - 0x8000;
+        for (uint32_t x = 0; x < dst_w; x++, sx += step_x) {
+            int32_t cx = (sx < 0) ? 0 : (sx > max_x) ? max_x : sx;
+            uint32_t x0 = cx >> 16;
+            uint32_t x1 = (x0 + 1 < src_w) ? x0 + 1 : x0;
+            uint32_t fx = (cx >> 8) & 0xFF;
+#ifdef IMAGE_USE_DSP
+            // Both horizontal taps in one dual multiply-accumulate
+            uint32_t wx = (256 - fx) | (fx << 16);
+            uint32_t top = __SMUAD(r0[x0] | (r0[x1] << 16), wx);
+            uint32_t bot = __SMUAD(r1[x0] | (r1[x1] << 16), wx);
+#else
+            uint32_t top = r0[x0] * (256 - fx) + r0[x1] * fx;
+            uint32_t bot = r1[x0] * (256 - fx) + r1[x1] * fx;
+#endif
+            dst[y * dst_w + x] = (top * (256 - fy) + bot * fy + 0x8000) >> 16;
+        }
+    }
+    return 0;
+}
+
+void image_to_int8(const uint8_t *src, int8_t *dst, size_t n)
+{
+    size_t i = 0;
+    // Flipping the top bit subtracts 128, four pixels at a time
+    for (; i + 4 <= n; i += 4) {
+        store4((uint8_t*)&dst[i], load4(&src[i]) ^ 0x80808080);
+    }
+    for (; i < n; i++) {
+        dst[i] = (int8_t)(src[i] ^ 0x80);
+    }
+}
+
+static int normalize_valid(float mean, float std, float scale)
+{
+    return isfinite(mean) && isfinite(std) && isfinite(scale) && std != 0.0f && scale != 0.0f;
+}
+
+static void normalize_lut(uint8_t *lut, float mean, float std, float scale,
+                          int32_t zero_point, int32_t min, int32_t max)
+{
+    // 256 possible inputs: the float math is done once per value, not per pixel
+    for (int32_t x = 0; x < 256; x++) {
+        float v = ((x / 255.0f) - mean) / std / scale + zero_point;
+        int32_t q = (int32_t)lroundf(v);
+        q = (q < min) ? min : (q > max) ? max : q;
+        lut[x] = (uint8_t)q;
+    }
+}
+
+static void apply_lut(const uint8_t *lut, const uint8_t *src, uint8_t *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t v = load4(&src[i]);
+        store4(&dst[i], lut[v & 0xFF] | (lut[(v >> 8) & 0xFF] << 8) |
+               (lut[(v >> 16) & 0xFF] << 16) | ((uint32_t)lut[v >> 24] << 24));
+    }
+    for (; i < n; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+int image_normalize_int8(const uint8_t *src, int8_t *dst, size_t n,
+                         float mean, float std, float scale, int32_t zero_point)
+{
+    uint8_t lut[256];
+    if (!normalize_valid(mean, std, scale)) {
+        return -1;
+    }
+    normalize_lut(lut, mean, std, scale, zero_point, -128, 127);
+    apply_lut(lut, src, (uint8_t*)dst, n);
+    return 0;
+}
+
+int image_normalize_uint8(const uint8_t *src, uint8_t *dst, size_t n,
+                          float mean, float std, float scale, int32_t zero_point)
+{
+    uint8_t lut[256];
+    if (!normalize_valid(mean, std, scale)) {
+        return -1;
+    }
+    normalize_lut(lut, mean, std, scale, zero_point, 0, 255);
+    apply_lut(lut, src, dst, n);
+    return 0;
+}
+
+static void copy_border(const uint8_t *src, uint8_t *dst, uint32_t w, uint32_t h)
+{
+    memcpy(dst, src, w);
+    memcpy(dst + (h - 1) * w, src + (h - 1) * w, w);
+    for (uint32_t y = 1; y < h - 1; y++) {
+        dst[y * w] = src[y * w];
+        dst[y * w + w - 1] = src[y * w + w - 1];
+    }
+}
+
+// Vertical sums r0 + k * r1 + r2, and differences r2 - r0, of columns
+// [x, x + n) into s and d (d can be NULL)
+static void vertical_pass(const uint8_t *r0, const uint8_t *r1, const uint8_t *r2,
+                          uint32_t x, uint32_t n, uint32_t k, int16_t *s, int16_t *d)
+{
+    uint32_t i = 0;
+#ifdef IMAGE_USE_DSP
+    for (; i + 4 <= n; i += 4) {
+        uint32_t a = load4(&r0[x + i]);
+        uint32_t b = load4(&r1[x + i]);
+        uint32_t c = load4(&r2[x + i]);
+        // Bytes 0 and 2, then 1 and 3, widened to halfwords
+        uint32_t a02 = __UXTB16(a), a13 = __UXTB16(__ROR(a, 8));
+        uint32_t b02 = __UXTB16(b), b13 = __UXTB16(__ROR(b, 8));
+        uint32_t c02 = __UXTB16(c), c13 = __UXTB16(__ROR(c, 8));
+        if (k == 2) {
+            b02 = __UADD16(b02, b02);
+            b13 = __UADD16(b13, b13);
+        }
+        uint32_t s02 = __UADD16(__UADD16(a02, b02), c02);
+        uint32_t s13 = __UADD16(__UADD16(a13, b13), c13);
+        // Back to pixel order
+        uint32_t s01 = __PKHBT(s02, s13, 16);
+        uint32_t s23 = __PKHTB(s13, s02, 16);
+        memcpy(&s[i], &s01, 4);
+        memcpy(&s[i + 2], &s23, 4);
+        if (d != NULL) {
+            uint32_t d02 = __SSUB16(c02, a02);
+            uint32_t d13 = __SSUB16(c13, a13);
+            uint32_t d01 = __PKHBT(d02, d13, 16);
+            uint32_t d23 = __PKHTB(d13, d02, 16);
+            memcpy(&d[i], &d01, 4);
+            memcpy(&d[i + 2], &d23, 4);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        s[i] = r0[x + i] + k * r1[x + i] + r2[x + i];
+        if (d != NULL) {
+            d[i] = r2[x + i] - r0[x + i];
+        }
+    }
+}
+
+void image_box3x3(const uint8_t *src, uint8_t *dst, uint32_t w, uint32_t h)
+{
+    int16_t s[FILTER_CHUNK + 2];
+
+    if (w < 3 || h < 3) {
+        memcpy(dst, src, w * h);
+        return;
+    }
+    copy_border(src, dst, w, h);
+
+    for (uint32_t y = 1; y < h - 1; y++) {
+        const uint8_t *r1 = src + y * w;
+        uint8_t *out = dst + y * w;
+        for (uint32_t x = 1; x < w - 1; x += FILTER_CHUNK) {
+            uint32_t n = (w - 1 - x < FILTER_CHUNK) ? w - 1 - x : FILTER_CHUNK;
+            // Columns x - 1 to x + n, around the n outputs
+            vertical_pass(r1 - w, r1, r1 + w, x - 1, n + 2, 1, s, NULL);
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t sum = s[i] + s[i + 1] + s[i + 2];
+                // sum / 9, rounded
+                out[x + i] = (sum * 7282 + 0x8000) >> 16;
+            }
+        }
+    }
+}
+
+void image_sobel3x3(const uint8_t *src, uint8_t *dst, uint32_t w, uint32_t h)
+{
+    int16_t s[FILTER_CHUNK + 2];
+    int16_t d[FILTER_CHUNK + 2];
+
+    if (w < 3 || h < 3) {
+        memcpy(dst, src, w * h);
+        return;
+    }
+    copy_border(src, dst, w, h);
+
+    for (uint32_t y = 1; y < h - 1; y++) {
+        const uint8_t *r1 = src + y * w;
+        uint8_t *out = dst + y * w;
+        for (uint32_t x = 1; x < w - 1; x += FILTER_CHUNK) {
+            uint32_t n = (w - 1 - x < FILTER_CHUNK) ? w - 1 - x : FILTER_CHUNK;
+            // Vertically smoothed columns for gx, vertical differences for gy
+            vertical_pass(r1 - w, r1, r1 + w, x - 1, n + 2, 2, s, d);
+            for (uint32_t i = 0; i < n; i++) {
+                int32_t gx = s[i + 2] - s[i];
+                int32_t gy = d[i] + 2 * d[i + 1] + d[i + 2];
+                out[x + i] = sat8(abs(gx) + abs(gy));
+            }
+        }
+    }
+}
+
+uint32_t image_diff_mask(const uint8_t *a, const uint8_t *b, uint8_t *mask, size_t n,
+                         uint8_t threshold)
+{
+    uint32_t count = 0;
+    size_t i = 0;
+#ifdef IMAGE_USE_DSP
+    uint32_t thr = threshold * 0x01010101U;
+    uint32_t sum = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t va = load4(&a[i]);
+        uint32_t vb = load4(&b[i]);
+        // |a - b| from the two saturated differences, one of them is 0
+        uint32_t diff = __UQSUB8(va, vb) | __UQSUB8(vb, va);
+        // GE flags set where threshold >= diff, select 0 there and 255 elsewhere
+        __USUB8(thr, diff);
+        uint32_t m = __SEL(0, 0xFFFFFFFF);
+        store4(&mask[i], m);
+        sum = __USADA8(m, 0, sum);
+    }
+    count = sum / 255;
+#endif
+    for (; i < n; i++) {
+        int32_t diff = a[i] - b[i];
+        uint8_t m = (abs(diff) > threshold) ? 255 : 0;
+        mask[i] = m;
+        count += (m != 0);
+    }
+    return count;
+}
@@ -0,0 +1,52 @@
+/*
+ * Preprocessing kernels for 8 bit grayscale camera frames.
+ *
+ * The kernels use the Cortex-M4/M7 DSP extension (SIMD on four pixels packed
+ * in a word) when it is available, and plain C otherwise, with the same
+ * results. Frames are row major, width * height bytes, no padding.
+ */
+#ifndef __IMAGE_KERNELS_H__
+#define __IMAGE_KERNELS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bilinear resize, pixel centers aligned. Works for down and up scaling.
+// Returns -1, without touching dst, if a dimension is 0 or above 32768.
+int image_resize_bilinear(const uint8_t *src, uint32_t src_w, uint32_t src_h,
+                          uint8_t *dst, uint32_t dst_w, uint32_t dst_h);
+
+// Shifts pixels to the int8 range (x - 128), as quantized models with a
+// zero point of -128 and a scale of 1/255 expect. dst can be src.
+void image_to_int8(const uint8_t *src, int8_t *dst, size_t n);
+
+// Quantizes ((x / 255 - mean) / std) to a tensor with the given scale and
+// zero point, saturated to the type range. dst can be src.
+// Returns -1, without touching dst, if std or scale is 0 or an argument is
+// not finite.
+int image_normalize_int8(const uint8_t *src, int8_t *dst, size_t n,
+                         float mean, float std, float scale, int32_t zero_point);
+int image_normalize_uint8(const uint8_t *src, uint8_t *dst, size_t n,
+                          float mean, float std, float scale, int32_t zero_point);
+
+// 3x3 filters. The outermost rows and columns have no full neighbourhood,
+// they are copied from the source. dst must not be src.
+void image_box3x3(const uint8_t *src, uint8_t *dst, uint32_t w, uint32_t h);
+// Gradient magnitude, |gx| + |gy| saturated to 255.
+void image_sobel3x3(const uint8_t *src, uint8_t *dst, uint32_t w, uint32_t h);
+
+// Sets mask to 255 where the two frames differ by more than threshold and to
+// 0 elsewhere, and returns how many pixels changed. mask can be one of the
+// frames.
+uint32_t image_diff_mask(const uint8_t *a, const uint8_t *b, uint8_t *mask, size_t n,
+                         uint8_t threshold);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IMAGE_KERNELS_H__
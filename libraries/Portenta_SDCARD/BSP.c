@@ -276,6 +276,23 @@ uint8_t BSP_SD_Erase(uint32_t StartAddr, uint32_t EndAddr)
   }
 }
 
+/**
+    @brief  Aborts a DMA transfer in progress, in polling mode.
+    @retval SD status
+*/
+uint8_t BSP_SD_Abort(void)
+{
+
+  if ( HAL_SD_Abort(&uSdHandle) == HAL_OK)
+  {
+    return MSD_OK;
+  }
+  else
+  {
+    return MSD_ERROR;
+  }
+}
+
 /**
     @brief  Initializes the SD MSP.
     @param  hsd SD handle
@@ -421,6 +438,16 @@ void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd)
   BSP_SD_ReadCpltCallback();
 }
 
+/**
+    @brief SD error callbacks, a DMA transfer ended on an error
+    @param hsd SD handle
+    @retval None
+*/
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+  BSP_SD_ErrorCallback();
+}
+
 /**
     @brief BSP SD Abort callbacks
     @retval None
@@ -448,6 +475,15 @@ __weak void BSP_SD_ReadCpltCallback(void)
 
 }
 
+/**
+    @brief BSP SD error callbacks
+    @retval None
+*/
+__weak void BSP_SD_ErrorCallback(void)
+{
+
+}
+
 void SDMMC2_IRQHandler(void)
 {
   BSP_SD_IRQHandler();
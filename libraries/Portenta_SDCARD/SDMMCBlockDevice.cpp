@@ -16,6 +16,7 @@
  */
 
 #include "SDMMCBlockDevice.h"
+#include "MemoryRegions.h"
 #include "mbed_debug.h"
 
 /* Required version: 5.5.0 and above */
@@ -54,10 +55,47 @@ enum bd_sd_error {
 
 #define BLOCK_SIZE_HC 512 /*!< Block size supported for SD card is 512 bytes  */
 
+/* The SDMMC internal DMA can't reach the tightly coupled memories */
+#define ITCM_END        (0x00010000)
+#define DTCM_START      (0x20000000)
+#define DTCM_END        (0x20020000)
+
+enum {
+    SD_XFER_NONE,
+    SD_XFER_READ,
+    SD_XFER_PROGRAM,
+};
+
+/* There is a single SD interface, its completion interrupt signals here */
+static rtos::Semaphore sd_done(0, 1);
+static volatile bool sd_busy = false;
+static volatile bool sd_error = false;
+
+extern "C" void BSP_SD_ReadCpltCallback(void)
+{
+    sd_busy = false;
+    sd_done.release();
+}
+
+extern "C" void BSP_SD_WriteCpltCallback(void)
+{
+    sd_busy = false;
+    sd_done.release();
+}
+
+extern "C" void BSP_SD_ErrorCallback(void)
+{
+    sd_error = true;
+    sd_busy = false;
+    sd_done.release();
+}
+
 SDMMCBlockDevice::SDMMCBlockDevice() :
     _read_size (BLOCK_SIZE_HC), _program_size (BLOCK_SIZE_HC),
     _erase_size(BLOCK_SIZE_HC), _block_size (BLOCK_SIZE_HC),
-    _capacity_in_blocks (0)
+    _capacity_in_blocks (0), _is_initialized (false),
+    _xfer (SD_XFER_NONE), _xfer_status (SD_BLOCK_DEVICE_OK),
+    _bounce (NULL), _bounce_alloc (NULL)
 {
     _timeout = 1000;
 }
@@ -104,6 +142,19 @@ int SDMMCBlockDevice::init()
     debug_if(SD_DBG, "Logical block size in bytes: %i\n", _current_card_info.LogBlockSize);
     debug_if(SD_DBG, "Timeout: %i\n", _timeout);
 
+    if(_bounce == NULL) {
+        // Uncached when the sketch set up a DMA pool, no cache maintenance then
+        _bounce = static_cast<uint8_t *> (MemoryRegions.malloc(MEMORY_POOL_DMA, SD_BOUNCE_SIZE));
+        if(_bounce == NULL) {
+            _bounce_alloc = malloc(SD_BOUNCE_SIZE + 31);
+            if(_bounce_alloc == NULL) {
+                unlock();
+                return SD_BLOCK_DEVICE_ERROR_NO_INIT;
+            }
+            _bounce = reinterpret_cast<uint8_t *> (((uint32_t)_bounce_alloc + 31) & ~31UL);
+        }
+    }
+
     _is_initialized = true;
     unlock();
     return SD_BLOCK_DEVICE_OK;
@@ -112,11 +163,22 @@ int SDMMCBlockDevice::init()
 int SDMMCBlockDevice::deinit()
 {
     lock();
+    finish_pending();
+    _xfer_status = SD_BLOCK_DEVICE_OK;
+
     _sd_state = BSP_SD_DeInit ();
     if(_sd_state != MSD_OK) {
         debug_if (SD_DBG, "SD card deinitialization failed\n");
+        unlock();
         return SD_BLOCK_DEVICE_ERROR;
     }
+    if(_bounce_alloc != NULL) {
+        free(_bounce_alloc);
+    } else {
+        MemoryRegions.free(_bounce);
+    }
+    _bounce = NULL;
+    _bounce_alloc = NULL;
     _is_initialized = false;
     unlock();
     return BD_ERROR_OK;
@@ -134,26 +196,13 @@ int SDMMCBlockDevice::read(void *b, bd_addr_t addr, bd_size_t size)
         return SD_BLOCK_DEVICE_ERROR_NO_INIT;
     }
 
-    uint32_t *buffer = static_cast<uint32_t *> (b);
-    int status = SD_BLOCK_DEVICE_OK;
-
-    // Get block address
-    uint32_t block_addr = addr / _block_size;
-    // Get block count
-    uint32_t block_cnt = size / _block_size;
-
     debug_if(
         SD_DBG,
         "SDMMCBlockDevice::read addr: 0x%x, block_addr: %i size: %lu block count: %i\n",
-        addr, block_addr, size, block_cnt);
-
-    if(BSP_SD_ReadBlocks (buffer, block_addr, block_cnt, _timeout) != MSD_OK) {
-        status = SD_BLOCK_DEVICE_ERROR_READ;
-    }
+        addr, (uint32_t)(addr / _block_size), size, (uint32_t)(size / _block_size));
 
-    // Wait until SD card is ready to use for new operation
-    while(BSP_SD_GetCardState() != SD_TRANSFER_OK) {
-    }
+    finish_pending();
+    int status = transfer(SD_XFER_READ, b, addr, size);
 
     unlock ();
     return status;
@@ -171,32 +220,228 @@ int SDMMCBlockDevice::program(const void *b, bd_addr_t addr, bd_size_t size)
         return SD_BLOCK_DEVICE_ERROR_NO_INIT;
     }
 
-    uint32_t* buffer =
-        const_cast<uint32_t*> (reinterpret_cast<const uint32_t*> (b));
-    int status = SD_BLOCK_DEVICE_OK;
-
-    // Get block address
-    uint32_t block_addr = addr / _block_size;
-    // Get block count
-    uint32_t block_cnt = size / _block_size;
-
     debug_if (
         SD_DBG,
         "SDMMCBlockDevice::program addr: 0x%x, block_addr: %i size: %lu block count: %i\n",
-        addr, block_addr, size, block_cnt);
+        addr, (uint32_t)(addr / _block_size), size, (uint32_t)(size / _block_size));
+
+    finish_pending();
+    int status = transfer(SD_XFER_PROGRAM, const_cast<void *> (b), addr, size);
+
+    unlock();
+    return status;
+}
 
-    if(BSP_SD_WriteBlocks (buffer, block_addr, block_cnt, _timeout) != MSD_OK) {
-        status = SD_BLOCK_DEVICE_ERROR_PROGRAM;
+int SDMMCBlockDevice::read_async(void *b, bd_addr_t addr, bd_size_t size)
+{
+    if(!is_valid_read (addr, size)) {
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     }
+    return submit(SD_XFER_READ, b, addr, size);
+}
 
-    // Wait until SD card is ready to use for new operation
-    while(BSP_SD_GetCardState() != SD_TRANSFER_OK) {
+int SDMMCBlockDevice::program_async(const void *b, bd_addr_t addr, bd_size_t size)
+{
+    if(!is_valid_program (addr, size)) {
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     }
+    return submit(SD_XFER_PROGRAM, const_cast<void *> (b), addr, size);
+}
 
+int SDMMCBlockDevice::complete()
+{
+    lock();
+    finish_pending();
+    int status = _xfer_status;
+    _xfer_status = SD_BLOCK_DEVICE_OK;
     unlock();
     return status;
 }
 
+bool SDMMCBlockDevice::busy() const
+{
+    return _xfer != SD_XFER_NONE && sd_busy;
+}
+
+int SDMMCBlockDevice::submit(uint8_t op, void *b, bd_addr_t addr, bd_size_t size)
+{
+    lock();
+    if(!_is_initialized) {
+        unlock();
+        return SD_BLOCK_DEVICE_ERROR_NO_INIT;
+    }
+
+    finish_pending();
+
+    int status;
+    uint32_t block_addr = addr / _block_size;
+    uint32_t block_cnt = size / _block_size;
+
+    if(dma_capable(b, op == SD_XFER_READ)) {
+        status = start_transfer(op, b, block_addr, block_cnt, NULL);
+    } else if(size <= SD_BOUNCE_SIZE) {
+        if(op == SD_XFER_PROGRAM) {
+            memcpy(_bounce, b, size);
+        }
+        status = start_transfer(op, _bounce, block_addr, block_cnt, (op == SD_XFER_READ) ? b : NULL);
+    } else {
+        // Too large to bounce in one go, done by the time this returns
+        status = transfer(op, b, addr, size);
+    }
+
+    unlock();
+    return status;
+}
+
+bool SDMMCBlockDevice::dma_capable(const void *buffer, bool read)
+{
+    uint32_t addr = (uint32_t)buffer;
+
+    if((addr & 3) != 0 || addr < ITCM_END || (addr >= DTCM_START && addr < DTCM_END)) {
+        return false;
+    }
+    // The lines of a cached buffer are invalidated after a read, nothing
+    // else may share them. Sizes are whole blocks, the start is what counts.
+    if(read && (addr & 31) != 0) {
+        memory_policy_t policy = MemoryRegions.policy(buffer);
+        return policy != MEMORY_WRITE_BACK && policy != MEMORY_WRITE_THROUGH;
+    }
+    return true;
+}
+
+int SDMMCBlockDevice::start_transfer(uint8_t op, void *buffer, uint32_t block_addr, uint32_t blocks, void *copy)
+{
+    uint32_t size = blocks * _block_size;
+
+    if(op == SD_XFER_PROGRAM) {
+        MemoryRegions.clean(buffer, size);
+    } else {
+        // Nothing dirty in the cache may be written back over the data
+        MemoryRegions.invalidate(buffer, size);
+    }
+
+    _xfer = op;
+    _xfer_buffer = buffer;
+    _xfer_copy = copy;
+    _xfer_size = size;
+    // Some slack for each block on top of the command timeout
+    _xfer_timeout = _timeout + blocks;
+
+    sd_done.try_acquire();
+    sd_error = false;
+    sd_busy = true;
+
+    uint8_t ret = (op == SD_XFER_READ) ?
+                  BSP_SD_ReadBlocks_DMA(static_cast<uint32_t *> (buffer), block_addr, blocks) :
+                  BSP_SD_WriteBlocks_DMA(static_cast<uint32_t *> (buffer), block_addr, blocks);
+    if(ret != MSD_OK) {
+        sd_busy = false;
+        _xfer = SD_XFER_NONE;
+        wait_ready(_timeout);
+        return (op == SD_XFER_READ) ? SD_BLOCK_DEVICE_ERROR_READ : SD_BLOCK_DEVICE_ERROR_PROGRAM;
+    }
+    return SD_BLOCK_DEVICE_OK;
+}
+
+int SDMMCBlockDevice::finish_transfer()
+{
+    if(_xfer == SD_XFER_NONE) {
+        return SD_BLOCK_DEVICE_OK;
+    }
+
+    int error = (_xfer == SD_XFER_READ) ? SD_BLOCK_DEVICE_ERROR_READ : SD_BLOCK_DEVICE_ERROR_PROGRAM;
+    int status = SD_BLOCK_DEVICE_OK;
+
+    // The calling thread sleeps until the transfer complete interrupt
+    if(!sd_done.try_acquire_for(rtos::Kernel::Clock::duration_u32(_xfer_timeout))) {
+        debug_if(SD_DBG, "SDMMCBlockDevice transfer timeout\n");
+        BSP_SD_Abort();
+        sd_busy = false;
+        status = error;
+    } else if(sd_error) {
+        status = error;
+    }
+
+    if(_xfer == SD_XFER_READ) {
+        // Lines the CPU may have loaded speculatively during the transfer
+        MemoryRegions.invalidate(_xfer_buffer, _xfer_size);
+        if(_xfer_copy != NULL && status == SD_BLOCK_DEVICE_OK) {
+            memcpy(_xfer_copy, _xfer_buffer, _xfer_size);
+        }
+    }
+    _xfer = SD_XFER_NONE;
+
+    // Wait until SD card is ready to use for new operation
+    if(!wait_ready(_timeout) && status == SD_BLOCK_DEVICE_OK) {
+        status = error;
+    }
+    return status;
+}
+
+void SDMMCBlockDevice::finish_pending()
+{
+    int status = finish_transfer();
+    // Kept for complete(), the first error wins
+    if(status != SD_BLOCK_DEVICE_OK && _xfer_status == SD_BLOCK_DEVICE_OK) {
+        _xfer_status = status;
+    }
+}
+
+int SDMMCBlockDevice::transfer(uint8_t op, void *b, bd_addr_t addr, bd_size_t size)
+{
+    uint8_t *buffer = static_cast<uint8_t *> (b);
+    uint32_t block_addr = addr / _block_size;
+    uint32_t block_cnt = size / _block_size;
+    int status;
+
+    if(dma_capable(buffer, op == SD_XFER_READ)) {
+        status = start_transfer(op, buffer, block_addr, block_cnt, NULL);
+        if(status == SD_BLOCK_DEVICE_OK) {
+            status = finish_transfer();
+        }
+        return status;
+    }
+
+    // Through the bounce buffer, as many blocks as it holds at a time
+    uint32_t chunk = SD_BOUNCE_SIZE / _block_size;
+    while(block_cnt > 0) {
+        uint32_t n = (block_cnt < chunk) ? block_cnt : chunk;
+        uint32_t len = n * _block_size;
+
+        if(op == SD_XFER_PROGRAM) {
+            memcpy(_bounce, buffer, len);
+        }
+        status = start_transfer(op, _bounce, block_addr, n, (op == SD_XFER_READ) ? buffer : NULL);
+        if(status == SD_BLOCK_DEVICE_OK) {
+            status = finish_transfer();
+        }
+        if(status != SD_BLOCK_DEVICE_OK) {
+            return status;
+        }
+        buffer += len;
+        block_addr += n;
+        block_cnt -= n;
+    }
+    return SD_BLOCK_DEVICE_OK;
+}
+
+bool SDMMCBlockDevice::wait_ready(uint32_t timeout)
+{
+    rtos::Kernel::Clock::time_point start = rtos::Kernel::Clock::now();
+
+    for(uint32_t polls = 0; BSP_SD_GetCardState() != SD_TRANSFER_OK; polls++) {
+        if(rtos::Kernel::Clock::now() - start > rtos::Kernel::Clock::duration_u32(timeout)) {
+            return false;
+        }
+        // Reads are over right away, a write keeps the card busy programming
+        // for milliseconds: let other threads run meanwhile
+        if(polls >= 16) {
+            rtos::ThisThread::sleep_for(rtos::Kernel::Clock::duration_u32(1));
+        }
+    }
+    return true;
+}
+
 int SDMMCBlockDevice::erase(bd_addr_t addr, bd_size_t size)
 {
     if (!is_valid_erase(addr, size)) {
@@ -209,6 +454,8 @@ int SDMMCBlockDevice::erase(bd_addr_t addr, bd_size_t size)
         return SD_BLOCK_DEVICE_ERROR_NO_INIT;
     }
 
+    finish_pending();
+
     size -= _block_size;
 
     int status = SD_BLOCK_DEVICE_OK;
@@ -230,7 +477,8 @@ int SDMMCBlockDevice::erase(bd_addr_t addr, bd_size_t size)
     }
 
     /* Wait until SD card is ready to use for new operation */
-    while(BSP_SD_GetCardState() != SD_TRANSFER_OK) {
+    if(!wait_ready(_timeout + (block_end_addr - block_start_addr) / 8)) {
+        status = SD_BLOCK_DEVICE_ERROR_ERASE;
     }
 
     unlock();
@@ -23,6 +23,12 @@
 #include "platform/PlatformMutex.h"
 #include "BSP.h"
 
+/* Bounce buffer for buffers the DMA can't use: in the tightly coupled
+   memories, not word aligned, or (for reads) sharing cache lines */
+#ifndef SD_BOUNCE_SIZE
+#define SD_BOUNCE_SIZE  (8 * 512)
+#endif
+
 //using namespace mbed;
 
 /**
@@ -170,6 +176,45 @@ public:
 
     virtual const char *get_type() const;
 
+    /** Start reading blocks and return while the DMA runs
+     *
+     *  A transfer still in flight is completed first. The buffer must stay
+     *  valid, and untouched, until complete() returns.
+     *
+     *  @param buffer   Buffer to read blocks into
+     *  @param addr     Address of block to begin reading from
+     *  @param size     Size to read in bytes, must be a multiple of read block size
+     *  @return         0 if the transfer started, negative error code on failure
+     */
+    int read_async(void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+
+    /** Start programming blocks and return while the DMA runs
+     *
+     *  A transfer still in flight is completed first, so a logger can fill
+     *  one buffer while the previous one is written. The buffer must stay
+     *  valid until complete() returns, unless it went through the bounce
+     *  buffer (not DMA capable and at most SD_BOUNCE_SIZE bytes).
+     *
+     *  @param buffer   Buffer of data to write to blocks
+     *  @param addr     Address of block to begin writing to
+     *  @param size     Size to write in bytes, must be a multiple of program block size
+     *  @return         0 if the transfer started, negative error code on failure
+     */
+    int program_async(const void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+
+    /** Wait for the transfer started by read_async() or program_async()
+     *
+     *  @return         0 on success or if nothing was in flight, negative error
+     *                  code if this or an earlier async transfer failed
+     */
+    int complete();
+
+    /** Check whether the data of an async transfer is still moving
+     *
+     *  @return         true until the transfer complete interrupt
+     */
+    bool busy() const;
+
 private:
     uint8_t _card_type;
     mbed::bd_size_t _read_size;
@@ -183,6 +228,26 @@ private:
     PlatformMutex _mutex;
     bool _is_initialized;
 
+    /* Transfer in flight, the DMA completes it in the background */
+    uint8_t _xfer;
+    void *_xfer_buffer;
+    void *_xfer_copy;           // Where a read through the bounce buffer goes
+    uint32_t _xfer_size;
+    uint32_t _xfer_timeout;
+    int _xfer_status;           // First error of an async transfer, for complete()
+
+    /* For buffers the SDMMC internal DMA can't use as they are */
+    uint8_t *_bounce;
+    void *_bounce_alloc;
+
+    bool dma_capable(const void *buffer, bool read);
+    int start_transfer(uint8_t op, void *buffer, uint32_t block_addr, uint32_t blocks, void *copy);
+    int finish_transfer();
+    void finish_pending();
+    int transfer(uint8_t op, void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+    int submit(uint8_t op, void *buffer, mbed::bd_addr_t addr, mbed::bd_size_t size);
+    bool wait_ready(uint32_t timeout);
+
     virtual void
     lock () {
         _mutex.lock();
@@ -0,0 +1,79 @@
+#include "SDMMCBlockDevice.h"
+
+/**
+ * Raw write throughput of the SD card, blocking and double buffered.
+ * WARNING: this overwrites the card from START_ADDRESS on, the filesystem
+ * will need to be formatted again (see TestSDCARD).
+ *
+ * The double buffered loop is how a logger would use program_async(): it
+ * fills one buffer while the DMA writes the other one to the card.
+ **/
+
+#define START_ADDRESS   (16 * 1024 * 1024)
+#define BUFFER_SIZE     (32 * 1024)
+#define TOTAL_SIZE      (4 * 1024 * 1024)
+
+SDMMCBlockDevice block_device;
+
+uint8_t buffers[2][BUFFER_SIZE] __attribute__((aligned(32)));
+
+// Stands in for the work of producing the data, e.g. sampling sensors
+static void fill(uint8_t* buffer, uint32_t seed) {
+  for (uint32_t i = 0; i < BUFFER_SIZE; i += 4) {
+    seed = seed * 1664525 + 1013904223;
+    memcpy(&buffer[i], &seed, 4);
+  }
+}
+
+static void report(const char* name, uint32_t us, int err) {
+  Serial.print(name);
+  Serial.print(": ");
+  if (err != 0) {
+    Serial.print("error ");
+    Serial.println(err);
+    return;
+  }
+  Serial.print((float)TOTAL_SIZE / us);
+  Serial.println(" MB/s");
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  if (block_device.init() != 0) {
+    Serial.println("No SD card!");
+    while (1);
+  }
+
+  // Fill, then write and wait
+  int err = 0;
+  uint32_t start = micros();
+  for (uint32_t offset = 0; offset < TOTAL_SIZE && err == 0; offset += BUFFER_SIZE) {
+    fill(buffers[0], offset);
+    err = block_device.program(buffers[0], START_ADDRESS + offset, BUFFER_SIZE);
+  }
+  report("blocking", micros() - start, err);
+
+  // Fill one buffer while the other one is written
+  err = 0;
+  start = micros();
+  for (uint32_t offset = 0, i = 0; offset < TOTAL_SIZE && err == 0; offset += BUFFER_SIZE, i ^= 1) {
+    fill(buffers[i], offset);
+    err = block_device.program_async(buffers[i], START_ADDRESS + offset, BUFFER_SIZE);
+  }
+  if (err == 0) {
+    err = block_device.complete();
+  }
+  report("double buffered", micros() - start, err);
+
+  // Read the data back through the bounce buffer, from a misaligned pointer
+  static uint8_t check[BUFFER_SIZE + 1] __attribute__((aligned(32)));
+  fill(buffers[0], TOTAL_SIZE - BUFFER_SIZE);
+  err = block_device.read(check + 1, START_ADDRESS + TOTAL_SIZE - BUFFER_SIZE, BUFFER_SIZE);
+  Serial.print("read back: ");
+  Serial.println((err == 0 && memcmp(check + 1, buffers[0], BUFFER_SIZE) == 0) ? "ok" : "mismatch");
+}
+
+void loop() {
+}
@@ -0,0 +1,206 @@
+#include "MemoryRegions.h"
+#include "SDRAM.h"
+
+// The tightly coupled memories are never cached
+#define ITCM_START      (0x00000000)
+#define ITCM_END        (0x00010000)
+#define DTCM_START      (0x20000000)
+#define DTCM_END        (0x20020000)
+
+#define CACHE_LINE      (32)
+// Under this there is no room for a heap next to its bookkeeping
+#define POOL_SIZE_MIN   (4 * 1024)
+
+static uint32_t mpu_attributes(memory_policy_t policy) {
+	uint32_t tex, c, b, s;
+
+	switch (policy) {
+	case MEMORY_WRITE_THROUGH:
+		tex = MPU_TEX_LEVEL0; c = MPU_ACCESS_CACHEABLE; b = MPU_ACCESS_NOT_BUFFERABLE; s = MPU_ACCESS_NOT_SHAREABLE;
+		break;
+	case MEMORY_NON_CACHEABLE:
+		tex = MPU_TEX_LEVEL1; c = MPU_ACCESS_NOT_CACHEABLE; b = MPU_ACCESS_NOT_BUFFERABLE; s = MPU_ACCESS_NOT_SHAREABLE;
+		break;
+	case MEMORY_SHARED:
+		tex = MPU_TEX_LEVEL0; c = MPU_ACCESS_NOT_CACHEABLE; b = MPU_ACCESS_NOT_BUFFERABLE; s = MPU_ACCESS_SHAREABLE;
+		break;
+	case MEMORY_WRITE_BACK:
+	default:
+		tex = MPU_TEX_LEVEL1; c = MPU_ACCESS_CACHEABLE; b = MPU_ACCESS_BUFFERABLE; s = MPU_ACCESS_NOT_SHAREABLE;
+		break;
+	}
+
+	return MPU_INSTRUCTION_ACCESS_ENABLE << MPU_RASR_XN_Pos
+	       | MPU_REGION_FULL_ACCESS << MPU_RASR_AP_Pos
+	       | tex << MPU_RASR_TEX_Pos
+	       | s << MPU_RASR_S_Pos
+	       | c << MPU_RASR_C_Pos
+	       | b << MPU_RASR_B_Pos
+	       | MPU_REGION_ENABLE << MPU_RASR_ENABLE_Pos;
+}
+
+static bool is_power_of_two(uint32_t x) {
+	return x && (x & (x - 1)) == 0;
+}
+
+int MemoryRegionsClass::configure(uint32_t index) {
+#ifdef CORE_CM7
+	region_t* r = &regions[index];
+	uint32_t number = MEMORY_REGIONS_MPU_FIRST + index;
+
+	if (number >= ((MPU->TYPE & MPU_TYPE_DREGION_Msk) >> MPU_TYPE_DREGION_Pos)) {
+		return -1;
+	}
+
+	__disable_irq();
+	// Nothing cached under the old policy may be written back or hit later
+	SCB_CleanInvalidateDCache_by_Addr((uint32_t*)r->base, r->size);
+	__DMB();
+	MPU->RNR = number;
+	MPU->RBAR = r->base;
+	// The SIZE field is log2(size) - 1
+	MPU->RASR = mpu_attributes(r->policy) | (31 - __CLZ(r->size) - 1) << MPU_RASR_SIZE_Pos;
+	if ((MPU->CTRL & MPU_CTRL_ENABLE_Msk) == 0) {
+		// Default memory map everywhere else, as the RPC setup had it
+		HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+	}
+	__DSB();
+	__ISB();
+	__enable_irq();
+#endif
+	// Without a data cache the policies are all the same
+	return 0;
+}
+
+int MemoryRegionsClass::addRegion(const char* name, uint32_t base, size_t size, memory_policy_t policy, bool heap) {
+	if (count >= MEMORY_REGIONS_MAX || find(name) != NULL) {
+		return -1;
+	}
+	if (size < CACHE_LINE || !is_power_of_two(size) || (base & (size - 1)) != 0) {
+		return -1;
+	}
+
+	region_t* r = &regions[count];
+	r->name = name;
+	r->base = base;
+	r->size = size;
+	r->policy = policy;
+	r->heap = NULL;
+
+	if (configure(count) != 0) {
+		return -1;
+	}
+	// The heap bookkeeping goes in the region, after the policy change
+	if (heap) {
+		r->heap = ea_heap_create((void*)base, size);
+		if (r->heap == NULL) {
+			return -1;
+		}
+	}
+	return count++;
+}
+
+int MemoryRegionsClass::addPool(const char* name, size_t size, memory_policy_t policy) {
+	if (size < POOL_SIZE_MIN) {
+		size = POOL_SIZE_MIN;
+	}
+	if (!is_power_of_two(size)) {
+		size = 1UL << (32 - __CLZ(size));
+	}
+
+	// Aligned to its size the block can be an MPU region, nothing else in
+	// the SDRAM heap shares its cache lines
+	void* block = ea_memalign(size, size);
+	if (block == NULL) {
+		return -1;
+	}
+
+	int ret = addRegion(name, (uint32_t)block, size, policy, true);
+	if (ret < 0) {
+		ea_free(block);
+	}
+	return ret;
+}
+
+MemoryRegionsClass::region_t* MemoryRegionsClass::find(const char* name) {
+	for (uint32_t i = 0; i < count; i++) {
+		if (strcmp(regions[i].name, name) == 0) {
+			return &regions[i];
+		}
+	}
+	return NULL;
+}
+
+MemoryRegionsClass::region_t* MemoryRegionsClass::find(const void* ptr) {
+	// Later regions take precedence in the MPU too
+	for (uint32_t i = count; i > 0; i--) {
+		region_t* r = &regions[i - 1];
+		if ((uint32_t)ptr - r->base < r->size) {
+			return r;
+		}
+	}
+	return NULL;
+}
+
+void* MemoryRegionsClass::malloc(const char* name, size_t size, size_t alignment) {
+	region_t* r = find(name);
+	if (r == NULL || r->heap == NULL) {
+		return NULL;
+	}
+	return ea_heap_memalign(r->heap, alignment, size);
+}
+
+void MemoryRegionsClass::free(void* ptr) {
+	region_t* r = find(ptr);
+	if (r != NULL && r->heap != NULL) {
+		ea_heap_free(r->heap, ptr);
+	}
+}
+
+bool MemoryRegionsClass::stats(const char* name, ea_malloc_stats_t* stats) {
+	region_t* r = find(name);
+	if (r == NULL || r->heap == NULL) {
+		return false;
+	}
+	ea_heap_stats(r->heap, stats);
+	return true;
+}
+
+memory_policy_t MemoryRegionsClass::policy(const void* ptr) {
+#ifdef CORE_CM7
+	region_t* r = find(ptr);
+	if (r != NULL) {
+		return r->policy;
+	}
+	uint32_t addr = (uint32_t)ptr;
+	if ((addr >= ITCM_START && addr < ITCM_END) || (addr >= DTCM_START && addr < DTCM_END)) {
+		return MEMORY_NON_CACHEABLE;
+	}
+	return MEMORY_WRITE_BACK;
+#else
+	return MEMORY_NON_CACHEABLE;
+#endif
+}
+
+void MemoryRegionsClass::clean(const void* ptr, size_t size) {
+#ifdef CORE_CM7
+	if (size && policy(ptr) == MEMORY_WRITE_BACK) {
+		uint32_t start = (uint32_t)ptr & ~(CACHE_LINE - 1);
+		uint32_t end = ((uint32_t)ptr + size + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+		SCB_CleanDCache_by_Addr((uint32_t*)start, end - start);
+	}
+#endif
+}
+
+void MemoryRegionsClass::invalidate(void* ptr, size_t size) {
+#ifdef CORE_CM7
+	memory_policy_t p = policy(ptr);
+	if (size && (p == MEMORY_WRITE_BACK || p == MEMORY_WRITE_THROUGH)) {
+		uint32_t start = (uint32_t)ptr & ~(CACHE_LINE - 1);
+		uint32_t end = ((uint32_t)ptr + size + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+		SCB_InvalidateDCache_by_Addr((uint32_t*)start, end - start);
+	}
+#endif
+}
+
+MemoryRegionsClass MemoryRegions;
@@ -0,0 +1,84 @@
+#ifndef __MEMORY_REGIONS_H
+#define __MEMORY_REGIONS_H
+
+#include "ea_malloc.h"
+
+#ifdef __cplusplus
+
+#include "Arduino.h"
+
+// Regions take the MPU regions from MEMORY_REGIONS_MPU_FIRST up, the ones
+// below are mbed's, SDRAMClass' and RPC's (7, D3 SRAM). A later region wins
+// where they overlap.
+#define MEMORY_REGIONS_MAX          (8)
+#define MEMORY_REGIONS_MPU_FIRST    (8)
+
+// Pool the drivers take their own DMA buffers from when the sketch has added it,
+// e.g. MemoryRegions.addPool(MEMORY_POOL_DMA, 1024 * 1024, MEMORY_NON_CACHEABLE)
+#define MEMORY_POOL_DMA             "dma"
+
+typedef enum {
+	// Cached, write-back: the default for SRAM and SDRAM. Before a DMA reads
+	// the memory it must be cleaned, before the CPU reads what a DMA wrote
+	// it must be invalidated.
+	MEMORY_WRITE_BACK,
+	// Cached, write-through: memory is always up to date, only the invalidate
+	// before the CPU reads what a DMA wrote is left.
+	MEMORY_WRITE_THROUGH,
+	// Not cached: no maintenance at all, every CPU access goes to memory
+	MEMORY_NON_CACHEABLE,
+	// Not cached, strongly ordered and shareable: memory shared with the other core
+	MEMORY_SHARED,
+} memory_policy_t;
+
+class MemoryRegionsClass {
+public:
+	MemoryRegionsClass() : count(0) {}
+
+	// Carves a pool out of the SDRAM heap, SDRAM.begin() must have been
+	// called. The size is rounded up to a power of two, at least 4KB.
+	// Returns the region number or -1.
+	int addPool(const char* name, size_t size, memory_policy_t policy);
+
+	// Gives [base, base + size) its own policy, with a heap in it or not.
+	// size is a power of two and base a multiple of it, as the MPU wants.
+	int addRegion(const char* name, uint32_t base, size_t size, memory_policy_t policy, bool heap = true);
+
+	// Memory from the named pool, alignment is a power of two; 32 keeps
+	// buffers on their own cache lines
+	void* malloc(const char* name, size_t size, size_t alignment = 32);
+	void free(void* ptr);
+	bool stats(const char* name, ea_malloc_stats_t* stats);
+
+	// Policy at this address, MEMORY_WRITE_BACK outside the regions
+	memory_policy_t policy(const void* ptr);
+
+	// Cache maintenance for a DMA buffer, only as much as its policy needs.
+	// clean() before a peripheral reads memory the CPU wrote, invalidate()
+	// before the CPU reads memory a peripheral wrote. Buffers should start
+	// and end on a cache line, invalidate() drops the whole lines.
+	void clean(const void* ptr, size_t size);
+	void invalidate(void* ptr, size_t size);
+
+private:
+	typedef struct {
+		const char* name;
+		uint32_t base;
+		uint32_t size;
+		memory_policy_t policy;
+		ea_heap_t* heap;
+	} region_t;
+
+	region_t regions[MEMORY_REGIONS_MAX];
+	uint32_t count;
+
+	region_t* find(const char* name);
+	region_t* find(const void* ptr);
+	int configure(uint32_t index);
+};
+
+extern MemoryRegionsClass MemoryRegions;
+
+#endif
+
+#endif //__MEMORY_REGIONS_H
@@ -36,10 +36,18 @@ void* SDRAMClass::malloc(size_t size) {
 	return ea_malloc(size);
 }
 
+void* SDRAMClass::malloc(size_t size, size_t alignment) {
+	return ea_memalign(alignment, size);
+}
+
 void SDRAMClass::free(void* ptr) {
 	ea_free(ptr);
 }
 
+void SDRAMClass::stats(ea_malloc_stats_t* stats) {
+	ea_malloc_stats(stats);
+}
+
 bool __attribute__((optimize("O0"))) SDRAMClass::test(bool fast) {
     uint8_t const pattern = 0xaa;
     uint8_t const antipattern = 0x55;
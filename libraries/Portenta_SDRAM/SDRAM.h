@@ -12,7 +12,10 @@ public:
 	SDRAMClass() {}
 	int begin(uint32_t start_address = SDRAM_START_ADDRESS);
 	void* malloc(size_t size);
+	// alignment is a power of two, e.g. 32 for buffers shared with DMA
+	void* malloc(size_t size, size_t alignment);
 	void free(void* ptr);
+	void stats(ea_malloc_stats_t* stats);
 	bool test(bool fast = false);
 private:
 	void mpu_config_start(void) {
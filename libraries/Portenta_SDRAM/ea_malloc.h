@@ -39,6 +39,45 @@ void malloc_init(void);
 void* ea_malloc(size_t size);
 void ea_free(void* ptr);
 
+/**
+* @brief Allocate memory aligned to a power of two, e.g. 32 bytes for buffers
+* that are cleaned or invalidated in the cache by line. Freed with ea_free().
+*/
+void* ea_memalign(size_t alignment, size_t size);
+
+typedef struct
+{
+	size_t total;           // Bytes given to malloc_addblock(), less the block headers
+	size_t used;            // Bytes allocated, block headers included
+	size_t peak;            // Highest value of used
+	size_t free;            // total - used
+	size_t largest_free;    // Largest allocation that can succeed
+	size_t free_blocks;     // Free blocks, 1 - largest_free / free measures fragmentation
+	size_t allocations;     // Blocks allocated and not freed yet
+	size_t failures;        // Allocations that returned NULL
+} ea_malloc_stats_t;
+
+/**
+* @brief Fill stats with the current state of the heap.
+*
+* Walks the free blocks, unlike ea_malloc() and ea_free() it is not constant time.
+*/
+void ea_malloc_stats(ea_malloc_stats_t* stats);
+
+/**
+* @brief A heap of its own, separate from the one malloc_addblock() feeds.
+*
+* ea_heap_create() keeps the heap bookkeeping (about 3KB) at the start of the
+* block and hands out the rest. Memory from a heap goes back to the same heap.
+*/
+typedef struct ea_heap ea_heap_t;
+
+ea_heap_t* ea_heap_create(void* addr, size_t size);
+void* ea_heap_malloc(ea_heap_t* heap, size_t size);
+void* ea_heap_memalign(ea_heap_t* heap, size_t alignment, size_t size);
+void ea_heap_free(ea_heap_t* heap, void* ptr);
+void ea_heap_stats(ea_heap_t* heap, ea_malloc_stats_t* stats);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
@@ -0,0 +1,119 @@
+#include "SDRAM.h"
+
+/**
+ * Replays a random allocation trace on the SDRAM heap: mostly small blocks,
+ * some line sized and cache line aligned DMA buffers and a few frame sized
+ * ones, freed in random order. Every block is filled and checked before it
+ * is freed. Prints the cycles per call and the heap statistics.
+ **/
+
+#define SLOTS       1024
+#define ITERATIONS  100000
+
+struct slot {
+  uint8_t* ptr;
+  size_t size;
+  uint8_t tag;
+};
+
+static slot slots[SLOTS];
+
+static const size_t frame_sizes[] = { 640 * 480 * 2, 320 * 240 * 2, 320 * 240, 320 * 200 };
+
+static size_t pick_size(bool& aligned) {
+  uint32_t r = random(100);
+  aligned = false;
+  if (r < 2) {
+    return frame_sizes[random(4)];
+  }
+  if (r < 20) {
+    aligned = true;
+    return 512 + random(8192);
+  }
+  return 1 + random(256);
+}
+
+static bool check(const slot& s) {
+  for (size_t i = 0; i < s.size; i += (s.size > 4096) ? 251 : 1) {
+    if (s.ptr[i] != s.tag) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {}
+
+  SDRAM.begin();
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void loop() {
+  uint32_t calls = 0, cycles = 0, max_cycles = 0;
+  uint32_t failures = 0, errors = 0;
+
+  for (int it = 0; it < ITERATIONS; it++) {
+    slot& s = slots[random(SLOTS)];
+    uint32_t start, elapsed;
+
+    if (s.ptr) {
+      if (!check(s)) {
+        errors++;
+      }
+      start = DWT->CYCCNT;
+      SDRAM.free(s.ptr);
+      elapsed = DWT->CYCCNT - start;
+      s.ptr = NULL;
+    } else {
+      bool aligned;
+      s.size = pick_size(aligned);
+      start = DWT->CYCCNT;
+      s.ptr = (uint8_t*)(aligned ? SDRAM.malloc(s.size, 32) : SDRAM.malloc(s.size));
+      elapsed = DWT->CYCCNT - start;
+      if (s.ptr == NULL) {
+        failures++;
+      } else {
+        if (aligned && ((uint32_t)s.ptr & 31)) {
+          errors++;
+        }
+        s.tag = random(256);
+        memset(s.ptr, s.tag, s.size);
+      }
+    }
+    cycles += elapsed;
+    max_cycles = max(max_cycles, elapsed);
+    calls++;
+  }
+
+  ea_malloc_stats_t stats;
+  SDRAM.stats(&stats);
+
+  Serial.print("cycles per call avg/max: ");
+  Serial.print(cycles / calls);
+  Serial.print("/");
+  Serial.println(max_cycles);
+  Serial.print("failed allocations: ");
+  Serial.print(failures);
+  Serial.print(" corrupted blocks: ");
+  Serial.println(errors);
+  Serial.print("used: ");
+  Serial.print(stats.used);
+  Serial.print(" peak: ");
+  Serial.print(stats.peak);
+  Serial.print(" free: ");
+  Serial.print(stats.free);
+  Serial.print(" largest free: ");
+  Serial.print(stats.largest_free);
+  Serial.print(" in ");
+  Serial.print(stats.free_blocks);
+  Serial.println(" free blocks");
+  Serial.print("fragmentation: ");
+  Serial.println(stats.free ? 1.0f - (float)stats.largest_free / stats.free : 0.0f);
+
+  delay(2000);
+}
@@ -0,0 +1,82 @@
+#include "SDRAM.h"
+#include "MemoryRegions.h"
+
+/**
+ * Carves an uncached DMA pool and a write-through pool out of the SDRAM heap,
+ * and times the cache maintenance a 64KB DMA buffer needs in each of them
+ * and in the normal, write-back, SDRAM heap. The camera, the LittleVGL port
+ * and Doom take their DMA buffers from the MEMORY_POOL_DMA pool when it exists.
+ **/
+
+#define BUFFER_SIZE (64 * 1024)
+
+static const char* policy_name(memory_policy_t policy) {
+  switch (policy) {
+    case MEMORY_WRITE_BACK: return "write-back";
+    case MEMORY_WRITE_THROUGH: return "write-through";
+    case MEMORY_NON_CACHEABLE: return "non-cacheable";
+    case MEMORY_SHARED: return "shared";
+  }
+  return "?";
+}
+
+static void measure(const char* name, uint8_t* buffer) {
+  if (buffer == NULL) {
+    Serial.print(name);
+    Serial.println(": allocation failed");
+    return;
+  }
+
+  // The CPU fills the buffer for a peripheral, then reads what one wrote back
+  memset(buffer, 0x55, BUFFER_SIZE);
+  uint32_t t0 = micros();
+  MemoryRegions.clean(buffer, BUFFER_SIZE);
+  uint32_t t1 = micros();
+  MemoryRegions.invalidate(buffer, BUFFER_SIZE);
+  uint32_t t2 = micros();
+
+  uint32_t sum = 0;
+  for (int i = 0; i < BUFFER_SIZE; i++) {
+    sum += buffer[i];
+  }
+  uint32_t t3 = micros();
+
+  Serial.print(name);
+  Serial.print(" (");
+  Serial.print(policy_name(MemoryRegions.policy(buffer)));
+  Serial.print(") clean us: ");
+  Serial.print(t1 - t0);
+  Serial.print(" invalidate us: ");
+  Serial.print(t2 - t1);
+  Serial.print(" CPU read us: ");
+  Serial.print(t3 - t2);
+  Serial.print(" sum: ");
+  Serial.println(sum);
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  SDRAM.begin();
+
+  if (MemoryRegions.addPool(MEMORY_POOL_DMA, 1024 * 1024, MEMORY_NON_CACHEABLE) < 0 ||
+      MemoryRegions.addPool("wt", 256 * 1024, MEMORY_WRITE_THROUGH) < 0) {
+    Serial.println("Failed to add the pools!");
+    while (1);
+  }
+
+  measure("SDRAM heap", (uint8_t*)SDRAM.malloc(BUFFER_SIZE, 32));
+  measure("dma pool", (uint8_t*)MemoryRegions.malloc(MEMORY_POOL_DMA, BUFFER_SIZE));
+  measure("wt pool", (uint8_t*)MemoryRegions.malloc("wt", BUFFER_SIZE));
+
+  ea_malloc_stats_t stats;
+  MemoryRegions.stats(MEMORY_POOL_DMA, &stats);
+  Serial.print("dma pool total: ");
+  Serial.print(stats.total);
+  Serial.print(" used: ");
+  Serial.println(stats.used);
+}
+
+void loop() {
+}
@@ -0,0 +1,511 @@
+/*
+ * Two level segregated fit (TLSF) allocator behind ea_malloc() and the separate
+ * ea_heap_*() heaps, see ea_malloc.h.
+ *
+ * Free blocks are kept in lists by size: the first level splits sizes by powers
+ * of two, the second level splits each power of two in SL_COUNT ranges. Two
+ * bitmaps tell which lists are not empty, so finding a block, splitting it and
+ * merging it back with its free neighbours on release are all constant time.
+ *
+ * Every block starts with its size, the two low bits flag whether the block
+ * and the one before it are free. A free block also stores its free list links
+ * and, at the end of its payload, a pointer back to its start so the next
+ * block can find it when merging. Allocated blocks cost one word of overhead.
+ */
+
+#include <ea_malloc.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pointer size alignment, as the free list allocator gave; ea_memalign() is
+// there for more
+#if UINTPTR_MAX > 0xFFFFFFFF
+#define ALIGN_LOG2      3
+#else
+#define ALIGN_LOG2      2
+#endif
+#define ALIGN           (1 << ALIGN_LOG2)
+
+#define SL_LOG2         5
+#define SL_COUNT        (1 << SL_LOG2)
+#define FL_SHIFT        (SL_LOG2 + ALIGN_LOG2)
+#define FL_MAX          30
+#define FL_COUNT        (FL_MAX - FL_SHIFT + 1)
+// Sizes under SMALL_BLOCK all go in the first level, SL_COUNT lists ALIGN apart
+#define SMALL_BLOCK     (1 << FL_SHIFT)
+
+#define BLOCK_FREE      (1U << 0)
+#define BLOCK_PREV_FREE (1U << 1)
+
+#ifndef align_up
+#define align_up(num, align) (((num) + ((align)-1)) & ~((align)-1))
+#endif
+#define align_down(num, align) ((num) & ~((align)-1))
+
+typedef struct block_header {
+	// Last word of the previous block's payload, only valid if that block is free
+	struct block_header* prev_phys;
+	size_t size;
+	// Only valid in free blocks
+	struct block_header* next_free;
+	struct block_header* prev_free;
+} block_t;
+
+// The size word is the only overhead of an allocated block
+#define BLOCK_OVERHEAD  sizeof(size_t)
+#define BLOCK_START     (offsetof(block_t, size) + sizeof(size_t))
+// A free block must hold its links and the back pointer of the next block
+#define BLOCK_SIZE_MIN  align_up(sizeof(block_t) - sizeof(block_t*), ALIGN)
+#define BLOCK_SIZE_MAX  ((size_t)1 << FL_MAX)
+
+struct ea_heap {
+	// Empty lists point here instead of NULL
+	block_t null_block;
+	uint32_t fl_bitmap;
+	uint32_t sl_bitmap[FL_COUNT];
+	block_t* blocks[FL_COUNT][SL_COUNT];
+
+	size_t total;
+	size_t used;
+	size_t peak;
+	uint32_t allocations;
+	uint32_t failures;
+	int initialized;
+};
+
+// The heap behind ea_malloc(), fed by malloc_addblock()
+static ea_heap_t default_heap;
+
+static inline int tlsf_fls(uint32_t word)
+{
+	return word ? 31 - __builtin_clz(word) : -1;
+}
+
+static inline int tlsf_ffs(uint32_t word)
+{
+	return word ? __builtin_ctz(word) : -1;
+}
+
+static inline size_t block_size(const block_t* block)
+{
+	return block->size & ~(size_t)(BLOCK_FREE | BLOCK_PREV_FREE);
+}
+
+static inline void block_set_size(block_t* block, size_t size)
+{
+	block->size = size | (block->size & (BLOCK_FREE | BLOCK_PREV_FREE));
+}
+
+static inline int block_is_free(const block_t* block)
+{
+	return block->size & BLOCK_FREE;
+}
+
+static inline int block_is_prev_free(const block_t* block)
+{
+	return block->size & BLOCK_PREV_FREE;
+}
+
+static inline void* block_to_ptr(const block_t* block)
+{
+	return (char*)block + BLOCK_START;
+}
+
+static inline block_t* block_from_ptr(const void* ptr)
+{
+	return (block_t*)((char*)ptr - BLOCK_START);
+}
+
+static inline block_t* block_next(const block_t* block)
+{
+	// The next header starts with the last word of this payload
+	return (block_t*)((char*)block_to_ptr(block) + block_size(block) - BLOCK_OVERHEAD);
+}
+
+static inline block_t* block_link_next(block_t* block)
+{
+	block_t* next = block_next(block);
+	next->prev_phys = block;
+	return next;
+}
+
+static inline void block_mark_free(block_t* block)
+{
+	block_t* next = block_link_next(block);
+	next->size |= BLOCK_PREV_FREE;
+	block->size |= BLOCK_FREE;
+}
+
+static inline void block_mark_used(block_t* block)
+{
+	block_t* next = block_next(block);
+	next->size &= ~(size_t)BLOCK_PREV_FREE;
+	block->size &= ~(size_t)BLOCK_FREE;
+}
+
+static void control_init(ea_heap_t* heap)
+{
+	heap->null_block.next_free = &heap->null_block;
+	heap->null_block.prev_free = &heap->null_block;
+	for (int i = 0; i < FL_COUNT; i++) {
+		for (int j = 0; j < SL_COUNT; j++) {
+			heap->blocks[i][j] = &heap->null_block;
+		}
+	}
+	heap->initialized = 1;
+}
+
+// List of the blocks of this size
+static void mapping_insert(size_t size, int* fl, int* sl)
+{
+	if (size < SMALL_BLOCK) {
+		*fl = 0;
+		*sl = size / (SMALL_BLOCK / SL_COUNT);
+	} else {
+		int f = tlsf_fls(size);
+		*sl = (size >> (f - SL_LOG2)) ^ SL_COUNT;
+		*fl = f - (FL_SHIFT - 1);
+	}
+}
+
+// First list whose blocks are all at least this size
+static void mapping_search(size_t size, int* fl, int* sl)
+{
+	if (size >= SMALL_BLOCK) {
+		size += (1 << (tlsf_fls(size) - SL_LOG2)) - 1;
+	}
+	mapping_insert(size, fl, sl);
+}
+
+static block_t* search_suitable_block(ea_heap_t* heap, int* fl, int* sl)
+{
+	uint32_t sl_map = heap->sl_bitmap[*fl] & (~0U << *sl);
+	if (!sl_map) {
+		// Nothing left at this level, take the next larger one
+		uint32_t fl_map = (*fl + 1 < 32) ? heap->fl_bitmap & (~0U << (*fl + 1)) : 0;
+		if (!fl_map) {
+			return NULL;
+		}
+		*fl = tlsf_ffs(fl_map);
+		sl_map = heap->sl_bitmap[*fl];
+	}
+	*sl = tlsf_ffs(sl_map);
+	return heap->blocks[*fl][*sl];
+}
+
+static void remove_free_block(ea_heap_t* heap, block_t* block, int fl, int sl)
+{
+	block_t* prev = block->prev_free;
+	block_t* next = block->next_free;
+	next->prev_free = prev;
+	prev->next_free = next;
+
+	if (heap->blocks[fl][sl] == block) {
+		heap->blocks[fl][sl] = next;
+		if (next == &heap->null_block) {
+			heap->sl_bitmap[fl] &= ~(1U << sl);
+			if (!heap->sl_bitmap[fl]) {
+				heap->fl_bitmap &= ~(1U << fl);
+			}
+		}
+	}
+}
+
+static void insert_free_block(ea_heap_t* heap, block_t* block, int fl, int sl)
+{
+	block_t* current = heap->blocks[fl][sl];
+	block->next_free = current;
+	block->prev_free = &heap->null_block;
+	current->prev_free = block;
+
+	heap->blocks[fl][sl] = block;
+	heap->fl_bitmap |= (1U << fl);
+	heap->sl_bitmap[fl] |= (1U << sl);
+}
+
+static void block_remove(ea_heap_t* heap, block_t* block)
+{
+	int fl, sl;
+	mapping_insert(block_size(block), &fl, &sl);
+	remove_free_block(heap, block, fl, sl);
+}
+
+static void block_insert(ea_heap_t* heap, block_t* block)
+{
+	int fl, sl;
+	mapping_insert(block_size(block), &fl, &sl);
+	insert_free_block(heap, block, fl, sl);
+}
+
+static inline int block_can_split(const block_t* block, size_t size)
+{
+	return block_size(block) >= sizeof(block_t) + size;
+}
+
+// Cuts the block to size, returns the free remainder
+static block_t* block_split(block_t* block, size_t size)
+{
+	block_t* remaining = (block_t*)((char*)block_to_ptr(block) + size - BLOCK_OVERHEAD);
+	size_t remain_size = block_size(block) - (size + BLOCK_OVERHEAD);
+
+	remaining->size = remain_size;
+	block_set_size(block, size);
+	block_mark_free(remaining);
+	return remaining;
+}
+
+// Merges block into prev, its physical predecessor
+static block_t* block_absorb(block_t* prev, block_t* block)
+{
+	prev->size += block_size(block) + BLOCK_OVERHEAD;
+	block_link_next(prev);
+	return prev;
+}
+
+static block_t* block_merge_prev(ea_heap_t* heap, block_t* block)
+{
+	if (block_is_prev_free(block)) {
+		block_t* prev = block->prev_phys;
+		block_remove(heap, prev);
+		block = block_absorb(prev, block);
+	}
+	return block;
+}
+
+static block_t* block_merge_next(ea_heap_t* heap, block_t* block)
+{
+	block_t* next = block_next(block);
+	if (block_is_free(next)) {
+		block_remove(heap, next);
+		block = block_absorb(block, next);
+	}
+	return block;
+}
+
+// Gives the end of a free block back to the free lists
+static void block_trim_free(ea_heap_t* heap, block_t* block, size_t size)
+{
+	if (block_can_split(block, size)) {
+		block_t* remaining = block_split(block, size);
+		block_link_next(block);
+		remaining->size |= BLOCK_PREV_FREE;
+		block_insert(heap, remaining);
+	}
+}
+
+// Gives the start of a free block back to the free lists, returns the rest
+static block_t* block_trim_free_leading(ea_heap_t* heap, block_t* block, size_t size)
+{
+	block_t* remaining = block;
+	if (block_can_split(block, size)) {
+		remaining = block_split(block, size - BLOCK_OVERHEAD);
+		remaining->size |= BLOCK_PREV_FREE;
+		block_link_next(block);
+		block_insert(heap, block);
+	}
+	return remaining;
+}
+
+static size_t adjust_request_size(size_t size, size_t align)
+{
+	if (size == 0 || size >= BLOCK_SIZE_MAX) {
+		return 0;
+	}
+	size = align_up(size, align);
+	return (size < BLOCK_SIZE_MIN) ? BLOCK_SIZE_MIN : size;
+}
+
+static block_t* block_locate_free(ea_heap_t* heap, size_t size)
+{
+	int fl, sl;
+	block_t* block = NULL;
+
+	if (size) {
+		mapping_search(size, &fl, &sl);
+		if (fl < FL_COUNT) {
+			block = search_suitable_block(heap, &fl, &sl);
+		}
+	}
+	if (block) {
+		remove_free_block(heap, block, fl, sl);
+	}
+	return block;
+}
+
+static void* block_prepare_used(ea_heap_t* heap, block_t* block, size_t size)
+{
+	if (!block) {
+		heap->failures++;
+		return NULL;
+	}
+	block_trim_free(heap, block, size);
+	block_mark_used(block);
+
+	heap->used += block_size(block) + BLOCK_OVERHEAD;
+	if (heap->used > heap->peak) {
+		heap->peak = heap->used;
+	}
+	heap->allocations++;
+	return block_to_ptr(block);
+}
+
+__attribute__((weak)) void malloc_init(void)
+{
+	// Unused here, override to specify your own init functin
+	// Which includes malloc_addblock calls
+}
+
+void* ea_heap_malloc(ea_heap_t* heap, size_t size)
+{
+	size_t adjust = adjust_request_size(size, ALIGN);
+	if (adjust == 0) {
+		return NULL;
+	}
+	return block_prepare_used(heap, block_locate_free(heap, adjust), adjust);
+}
+
+void* ea_heap_memalign(ea_heap_t* heap, size_t alignment, size_t size)
+{
+	size_t adjust = adjust_request_size(size, ALIGN);
+
+	if (alignment <= ALIGN) {
+		return ea_heap_malloc(heap, size);
+	}
+	if (adjust == 0 || (alignment & (alignment - 1)) != 0) {
+		heap->failures++;
+		return NULL;
+	}
+
+	// Room for the alignment, and for a free block in front of the aligned
+	// one if the gap is not empty
+	size_t gap_minimum = sizeof(block_t);
+	size_t size_with_gap = adjust_request_size(adjust + alignment + gap_minimum, alignment);
+	block_t* block = block_locate_free(heap, size_with_gap);
+
+	if (block) {
+		uintptr_t ptr = (uintptr_t)block_to_ptr(block);
+		uintptr_t aligned = align_up(ptr, alignment);
+		size_t gap = aligned - ptr;
+
+		if (gap && gap < gap_minimum) {
+			uintptr_t next_aligned = aligned + (gap_minimum - gap);
+			aligned = align_up(next_aligned, alignment);
+			gap = aligned - ptr;
+		}
+		if (gap) {
+			block = block_trim_free_leading(heap, block, gap);
+		}
+	}
+	return block_prepare_used(heap, block, adjust);
+}
+
+void ea_heap_free(ea_heap_t* heap, void* ptr)
+{
+	// Don't free a NULL pointer..
+	if (ptr) {
+		block_t* block = block_from_ptr(ptr);
+
+		heap->used -= block_size(block) + BLOCK_OVERHEAD;
+		heap->allocations--;
+
+		block_mark_free(block);
+		block = block_merge_prev(heap, block);
+		block = block_merge_next(heap, block);
+		block_insert(heap, block);
+	}
+}
+
+static void heap_addblock(ea_heap_t* heap, void* addr, size_t size)
+{
+	// The first payload must be aligned, its header sits right before it
+	uintptr_t start = align_up((uintptr_t)addr + BLOCK_START, ALIGN);
+	uintptr_t end = (uintptr_t)addr + size;
+	if (end < start + BLOCK_SIZE_MIN + sizeof(block_t)) {
+		return;
+	}
+	// Keep the header of the sentinel block that ends the pool in range
+	size_t pool_size = align_down(end - BLOCK_OVERHEAD - start, ALIGN);
+	if (pool_size > BLOCK_SIZE_MAX - ALIGN) {
+		pool_size = BLOCK_SIZE_MAX - ALIGN;
+	}
+
+	block_t* block = block_from_ptr((void*)start);
+	block->size = pool_size | BLOCK_FREE;
+	block_insert(heap, block);
+
+	// The sentinel is an empty allocated block, nothing merges past it
+	block_t* sentinel = block_link_next(block);
+	sentinel->size = 0 | BLOCK_PREV_FREE;
+
+	heap->total += pool_size + BLOCK_OVERHEAD;
+}
+
+void ea_heap_stats(ea_heap_t* heap, ea_malloc_stats_t* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->total = heap->total;
+	stats->used = heap->used;
+	stats->peak = heap->peak;
+	stats->free = heap->total - heap->used;
+	stats->allocations = heap->allocations;
+	stats->failures = heap->failures;
+
+	for (int fl = 0; fl < FL_COUNT; fl++) {
+		if (!(heap->fl_bitmap & (1U << fl))) {
+			continue;
+		}
+		for (int sl = 0; sl < SL_COUNT; sl++) {
+			block_t* block = heap->blocks[fl][sl];
+			for (; block != &heap->null_block; block = block->next_free) {
+				stats->free_blocks++;
+				if (block_size(block) > stats->largest_free) {
+					stats->largest_free = block_size(block);
+				}
+			}
+		}
+	}
+}
+
+ea_heap_t* ea_heap_create(void* addr, size_t size)
+{
+	uintptr_t start = align_up((uintptr_t)addr, sizeof(void*));
+	uintptr_t end = (uintptr_t)addr + size;
+	if (end < start + sizeof(ea_heap_t)) {
+		return NULL;
+	}
+
+	ea_heap_t* heap = (ea_heap_t*)start;
+	memset(heap, 0, sizeof(*heap));
+	control_init(heap);
+	heap_addblock(heap, heap + 1, end - (uintptr_t)(heap + 1));
+	return heap;
+}
+
+void malloc_addblock(void* addr, size_t size)
+{
+	if (!default_heap.initialized) {
+		control_init(&default_heap);
+	}
+	heap_addblock(&default_heap, addr, size);
+}
+
+void* ea_malloc(size_t size)
+{
+	return ea_heap_malloc(&default_heap, size);
+}
+
+void* ea_memalign(size_t alignment, size_t size)
+{
+	return ea_heap_memalign(&default_heap, alignment, size);
+}
+
+void ea_free(void* ptr)
+{
+	ea_heap_free(&default_heap, ptr);
+}
+
+void ea_malloc_stats(ea_malloc_stats_t* stats)
+{
+	ea_heap_stats(&default_heap, stats);
+}
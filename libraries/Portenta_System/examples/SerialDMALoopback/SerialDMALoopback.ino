@@ -0,0 +1,77 @@
+/**
+ * Receives a stream on Serial1 with the interrupt per byte path, then with
+ * the DMA circular buffer, while loop() is kept busy the way a sketch doing
+ * other work would be. Connect D14 (TX) to D13 (RX).
+ *
+ * The interrupt path holds what arrives in its small ring until read()
+ * gets to it, so it loses data once the busy loop falls behind. The DMA ring
+ * has room for BUSY_US worth of bytes and the UART interrupt only fires when
+ * the line goes idle.
+ **/
+
+#define BAUDRATE        2000000
+#define TOTAL_SIZE      (256 * 1024)
+#define DMA_RING_SIZE   4096
+#define TX_RING_SIZE    4096
+#define BUSY_US         2000
+
+uint8_t buffer[512];
+
+static void run(const char* name, bool dma) {
+  // A receive size of 0 keeps the interrupt path, both send from a ring that covers BUSY_US
+  Serial1.begin(BAUDRATE, SERIAL_8N1, dma ? DMA_RING_SIZE : 0, TX_RING_SIZE);
+  uint32_t overruns = Serial1.rxOverruns();
+
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  uint32_t errors = 0;
+  uint8_t expected = 0;
+  uint32_t start = micros();
+  uint32_t last = millis();
+  // Stops when everything came back, or when nothing comes for 100ms
+  while (received < TOTAL_SIZE && millis() - last < 100) {
+    while (sent < TOTAL_SIZE && Serial1.availableForWrite() > 0) {
+      Serial1.write((uint8_t)sent);
+      sent++;
+    }
+    int n = Serial1.read(buffer, sizeof(buffer));
+    for (int i = 0; i < n; i++) {
+      // Counts the gaps, not every byte after one
+      if (buffer[i] != expected) {
+        errors++;
+      }
+      expected = buffer[i] + 1;
+    }
+    if (n > 0) {
+      received += n;
+      last = millis();
+    }
+    delayMicroseconds(BUSY_US);
+  }
+  uint32_t us = micros() - start;
+  Serial1.end();
+
+  Serial.print(name);
+  Serial.print(": received ");
+  Serial.print(received);
+  Serial.print(" of ");
+  Serial.print(TOTAL_SIZE);
+  Serial.print(", gaps ");
+  Serial.print(errors);
+  Serial.print(", overruns ");
+  Serial.print(Serial1.rxOverruns() - overruns);
+  Serial.print(", ");
+  Serial.print((float)received / us);
+  Serial.println(" MB/s");
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  run("interrupt", false);
+  run("dma", true);
+}
+
+void loop() {
+}
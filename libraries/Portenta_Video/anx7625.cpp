@@ -934,23 +934,69 @@ uint32_t getFramebufferEnd() {
 	return (FB_BASE_ADDRESS + 2 * (lcd_x_size * lcd_y_size * BYTES_PER_PIXEL));
 }
 
-extern "C" {
-static uint32_t pend_buffer = 0;
+static volatile uint32_t pend_buffer = 0;
 
 /*
+ * Frame presentation. Layer N scans out FB_ADDRESS_N, the shown layer is
+ * (pend_buffer - 1) % 2 and the back buffer belongs to layer pend_buffer % 2.
+ * A flip is queued with the LTDC line event on line 0, which is in the
+ * vertical sync, and the layers are swapped there with an immediate reload.
+ */
+static volatile bool flip_pending = false;
+static void (*flip_callback)(uint32_t front) = NULL;
+
+/* Set from the line event once the queued flip happened */
+#define FLIP_DONE_FLAG			0x1
+static rtos::EventFlags flip_flags;
+
+typedef struct {
+	uint16_t x, y, w, h;
+} dirty_rect_t;
+
+/* Areas drawn in the frame being built, and in the last presented frame: the
+   latter are copied to the new back buffer so it matches what is shown */
+static dirty_rect_t dirty[STM32_LCD_MAX_DIRTY_RECTS];
+static uint32_t dirty_count = 0;
+static dirty_rect_t presented[STM32_LCD_MAX_DIRTY_RECTS];
+static uint32_t presented_count = 0;
+
+static uint32_t layer_address(uint32_t layer) {
+	return layer ? FB_ADDRESS_1 : FB_ADDRESS_0;
+}
+
+static void LL_CopyArea(uint32_t src, uint32_t dst, uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize);
+
+extern "C" {
+
 void HAL_LTDC_LineEventCallback(LTDC_HandleTypeDef *ltdc)
 {
-	LTDC_LAYER(ltdc, 0)->CFBAR = (pend_buffer++ % 2) ? FB_ADDRESS_0 : FB_ADDRESS_1;
-	__HAL_LTDC_RELOAD_CONFIG(ltdc); 
+	if (!flip_pending) {
+		return;
+	}
+
+	int fb = pend_buffer++ % 2;
 
-	HAL_LTDC_ProgramLineEvent(ltdc, 0);
+	__HAL_LTDC_LAYER_ENABLE(ltdc, fb);
+	__HAL_LTDC_LAYER_DISABLE(ltdc, !fb);
+	__HAL_LTDC_RELOAD_CONFIG(ltdc);
+
+	flip_pending = false;
+	flip_flags.set(FLIP_DONE_FLAG);
+	if (flip_callback) {
+		flip_callback(layer_address(fb));
+	}
 }
 
 void LTDC_IRQHandler(void)
 {
 	HAL_LTDC_IRQHandler(&ltdc);
 }
-*/
+
+/* Transfers started with HAL_DMA2D_Start_IT() complete here */
+void DMA2D_IRQHandler(void)
+{
+	HAL_DMA2D_IRQHandler(&dma2d);
+}
 
 }
 
@@ -965,6 +1011,100 @@ uint32_t getNextFrameBuffer() {
 	return fb ? FB_ADDRESS_0 : FB_ADDRESS_1;
 }
 
+bool stm32_LCD_FlipPending(void)
+{
+	return flip_pending;
+}
+
+bool stm32_LCD_WaitFlip(void)
+{
+	if (flip_pending) {
+		flip_flags.wait_any_for(FLIP_DONE_FLAG, std::chrono::milliseconds(STM32_LCD_FLIP_TIMEOUT));
+	}
+
+	core_util_critical_section_enter();
+	bool missed = flip_pending;
+	flip_pending = false;
+	core_util_critical_section_exit();
+	if (!missed) {
+		return true;
+	}
+
+	/* No line event came (display stopped?): the flip is cancelled and the back
+	   buffer keeps the frame, its areas are presented along with the next one */
+	for (uint32_t i = 0; i < presented_count; i++) {
+		dirty_rect_t *r = &presented[i];
+		stm32_LCD_AddDirtyRect(r->x, r->y, r->w, r->h);
+	}
+	presented_count = 0;
+	return false;
+}
+
+void stm32_LCD_SetFlipCallback(void (*callback)(uint32_t front))
+{
+	flip_callback = callback;
+}
+
+uint32_t stm32_LCD_BeginFrame(void)
+{
+	stm32_LCD_WaitFlip();
+
+	/* The back buffer was last shown before the presented frame was drawn */
+	uint32_t back = layer_address(pend_buffer % 2);
+	uint32_t front = layer_address((pend_buffer + 1) % 2);
+	for (uint32_t i = 0; i < presented_count; i++) {
+		dirty_rect_t *r = &presented[i];
+		LL_CopyArea(front, back, r->x, r->y, r->w, r->h);
+	}
+	presented_count = 0;
+	return back;
+}
+
+void stm32_LCD_AddDirtyRect(uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize)
+{
+	if (x >= lcd_x_size || y >= lcd_y_size || xSize == 0 || ySize == 0) {
+		return;
+	}
+	if (xSize > lcd_x_size - x) {
+		xSize = lcd_x_size - x;
+	}
+	if (ySize > lcd_y_size - y) {
+		ySize = lcd_y_size - y;
+	}
+
+	if (dirty_count == STM32_LCD_MAX_DIRTY_RECTS) {
+		/* Out of room: everything collapses into the bounding box */
+		uint32_t x0 = x, y0 = y, x1 = x + xSize, y1 = y + ySize;
+		for (uint32_t i = 0; i < dirty_count; i++) {
+			x0 = min(x0, (uint32_t)dirty[i].x);
+			y0 = min(y0, (uint32_t)dirty[i].y);
+			x1 = max(x1, (uint32_t)(dirty[i].x + dirty[i].w));
+			y1 = max(y1, (uint32_t)(dirty[i].y + dirty[i].h));
+		}
+		dirty_count = 0;
+		x = x0;
+		y = y0;
+		xSize = x1 - x0;
+		ySize = y1 - y0;
+	}
+	dirty[dirty_count++] = { (uint16_t)x, (uint16_t)y, (uint16_t)xSize, (uint16_t)ySize };
+}
+
+void stm32_LCD_PresentFrame(bool wait)
+{
+	memcpy(presented, dirty, dirty_count * sizeof(dirty_rect_t));
+	presented_count = dirty_count;
+	dirty_count = 0;
+
+	flip_flags.clear(FLIP_DONE_FLAG);
+	flip_pending = true;
+	HAL_LTDC_ProgramLineEvent(&ltdc, 0);
+
+	if (wait) {
+		stm32_LCD_WaitFlip();
+	}
+}
+
 uint32_t stm32_getXSize() {
 	return lcd_x_size;
 }
@@ -1197,8 +1337,55 @@ int stm32_dsi_config(uint8_t bus, struct edid *edid, struct display_timing *dt)
 	stm32_LCD_Clear(0);
 }
 
+/* Waits for a transfer started with HAL_DMA2D_Start_IT(), e.g. by the LittleVGL port */
+static void dma2d_wait(void)
+{
+	while (HAL_DMA2D_GetState(&dma2d) == HAL_DMA2D_STATE_BUSY) {}
+}
+
+/* Polls a transfer of the given number of pixels started with HAL_DMA2D_Start(). The
+   timeout allows for 10 Mpixel/s, well below what the DMA2D does even to and from SDRAM.
+   A transfer still running past it is aborted, so the handle can be set up again. */
+static void dma2d_poll(uint32_t pixels)
+{
+	if (HAL_DMA2D_PollForTransfer(&dma2d, 25 + pixels / 10000) != HAL_OK) {
+		HAL_DMA2D_Abort(&dma2d);
+	}
+}
+
+static void LL_CopyArea(uint32_t src, uint32_t dst, uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize)
+{
+	uint32_t offset = (y * lcd_x_size + x) * BYTES_PER_PIXEL;
+
+	dma2d_wait();
+
+	dma2d.Init.Mode         = DMA2D_M2M;
+	dma2d.Init.ColorMode    = DMA2D_OUTPUT_RGB565;
+	dma2d.Init.OutputOffset = lcd_x_size - xSize;
+
+	dma2d.LayerCfg[1].AlphaMode = DMA2D_NO_MODIF_ALPHA;
+	dma2d.LayerCfg[1].InputAlpha = 0xFF;
+	dma2d.LayerCfg[1].InputColorMode = DMA2D_INPUT_RGB565;
+	dma2d.LayerCfg[1].InputOffset = lcd_x_size - xSize;
+
+	dma2d.Instance = DMA2D;
+
+	if(HAL_DMA2D_Init(&dma2d) == HAL_OK)
+	{
+		if(HAL_DMA2D_ConfigLayer(&dma2d, 1) == HAL_OK)
+		{
+			if (HAL_DMA2D_Start(&dma2d, src + offset, dst + offset, xSize, ySize) == HAL_OK)
+			{
+				dma2d_poll(xSize * ySize);
+			}
+		}
+	}
+}
+
 static void LL_FillBuffer(uint32_t LayerIndex, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorIndex)
 {
+	dma2d_wait();
+
 	/* Register to memory mode with ARGB8888 as color Mode */
 	dma2d.Init.Mode         = DMA2D_R2M;
 	dma2d.Init.ColorMode    = DMA2D_OUTPUT_RGB565;	//DMA2D_OUTPUT_ARGB8888
@@ -1214,7 +1401,7 @@ static void LL_FillBuffer(uint32_t LayerIndex, void *pDst, uint32_t xSize, uint3
 			if (HAL_DMA2D_Start(&dma2d, ColorIndex, (uint32_t)pDst, xSize, ySize) == HAL_OK)
 			{
 				/* Polling For DMA transfer */
-				HAL_DMA2D_PollForTransfer(&dma2d, 25);
+				dma2d_poll(xSize * ySize);
 			}
 		}
 	}
@@ -1240,6 +1427,8 @@ void stm32_LCD_FillArea(void *pDst, uint32_t xSize, uint32_t ySize, uint32_t Col
 
 void stm32_LCD_DrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t ColorMode)
 {
+	dma2d_wait();
+
 	/* Configure the DMA2D Mode, Color Mode and output offset */
 	dma2d.Init.Mode         = DMA2D_M2M_PFC;
 	dma2d.Init.ColorMode    = DMA2D_OUTPUT_RGB565;
@@ -1265,7 +1454,7 @@ void stm32_LCD_DrawImage(void *pSrc, void *pDst, uint32_t xSize, uint32_t ySize,
 			if (HAL_DMA2D_Start(&dma2d, (uint32_t)pSrc, (uint32_t)pDst, xSize, ySize) == HAL_OK)
 			{
 				/* Polling For DMA transfer */
-				HAL_DMA2D_PollForTransfer(&dma2d, 25);
+				dma2d_poll(xSize * ySize);
 			}
 		}
 	}
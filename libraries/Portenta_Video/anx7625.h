@@ -374,4 +374,28 @@ uint32_t stm32_getYSize();
 uint32_t getFramebufferEnd();
 DMA2D_HandleTypeDef* stm32_get_DMA2D(void);
 
+/* Tear free double buffering: draw into the buffer returned by
+ * stm32_LCD_BeginFrame(), list the areas that changed with
+ * stm32_LCD_AddDirtyRect() and queue the buffer for scanout at the next vertical
+ * blanking with stm32_LCD_PresentFrame(). The next stm32_LCD_BeginFrame() waits
+ * for the flip and copies the listed areas to the new back buffer, so only the
+ * changes need to be drawn. A frame with no dirty rectangle is expected to be
+ * redrawn entirely and nothing is copied. */
+#define STM32_LCD_MAX_DIRTY_RECTS	16
+
+/* How long stm32_LCD_WaitFlip() waits for the vertical blanking, in ms. If it
+ * does not come the flip is cancelled, the back buffer keeps the frame and
+ * WaitFlip() returns false; the frame is presented along with the next one. */
+#ifndef STM32_LCD_FLIP_TIMEOUT
+#define STM32_LCD_FLIP_TIMEOUT		100
+#endif
+
+uint32_t stm32_LCD_BeginFrame(void);
+void stm32_LCD_AddDirtyRect(uint32_t x, uint32_t y, uint32_t xSize, uint32_t ySize);
+void stm32_LCD_PresentFrame(bool wait);
+bool stm32_LCD_FlipPending(void);
+bool stm32_LCD_WaitFlip(void);
+/* Called from the LTDC interrupt once a presented frame is being scanned out */
+void stm32_LCD_SetFlipCallback(void (*callback)(uint32_t front));
+
 #endif  /* __ANX7625_H__ */
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "Portenta_Video.h"
+#include "SDRAM.h"
+#include "mbed.h"
+
+/**
+ * Tear free animation with dirty rectangles.
+ * A square bounces around the screen: each frame only erases the square at
+ * its old position, draws it at the new one and marks both areas dirty, then
+ * presents the frame at the next vertical blanking. Serial shows the frame
+ * rate and the time spent waiting for the flips.
+ **/
+
+#define SIZE 64
+
+struct edid recognized_edid;
+
+mbed::DigitalOut video_on(PK_2);
+mbed::DigitalOut video_rst(PJ_3);
+
+void setup() {
+  Serial.begin(115200);
+
+  delay(1000);
+  video_on = 1;
+  delay(10);
+  video_rst = 1;
+  delay(10);
+
+  int ret = -1;
+  video_on = 0;
+  delay(10);
+  video_rst = 0;
+  delay(100);
+  while (ret < 0) {
+
+    video_on = 0;
+    delay(10);
+    video_rst = 0;
+    delay(100);
+
+    video_on = 1;
+    delay(100);
+    video_rst = 1;
+
+    ret = anx7625_init(0);
+  }
+  anx7625_dp_get_edid(0, &recognized_edid);
+  anx7625_dp_start(0, &recognized_edid, EDID_MODE_640x480_60Hz);
+
+  SDRAM.begin(getFramebufferEnd());
+}
+
+static int x = 0, y = 0, dx = 3, dy = 2;
+static uint32_t frames = 0;
+static uint32_t wait_us = 0;
+static uint32_t last_report = 0;
+
+static void fill(uint32_t fb, int x, int y, uint32_t color) {
+  uint16_t* p = (uint16_t*)fb + y * stm32_getXSize() + x;
+  stm32_LCD_FillArea(p, SIZE, SIZE, color);
+  stm32_LCD_AddDirtyRect(x, y, SIZE, SIZE);
+}
+
+void loop() {
+  uint32_t start = micros();
+  uint32_t fb = stm32_LCD_BeginFrame();
+  wait_us += micros() - start;
+
+  fill(fb, x, y, 0x0000);
+
+  x += dx;
+  y += dy;
+  if (x < 0 || x + SIZE > (int)stm32_getXSize()) {
+    dx = -dx;
+    x += 2 * dx;
+  }
+  if (y < 0 || y + SIZE > (int)stm32_getYSize()) {
+    dy = -dy;
+    y += 2 * dy;
+  }
+
+  fill(fb, x, y, 0xF800);
+
+  stm32_LCD_PresentFrame(false);
+  frames++;
+
+  if (millis() - last_report >= 2000) {
+    Serial.print("fps: ");
+    Serial.print(frames * 1000.0f / (millis() - last_report));
+    Serial.print(" us waiting for vsync per frame: ");
+    Serial.println(wait_us / frames);
+    frames = 0;
+    wait_us = 0;
+    last_report = millis();
+  }
+}
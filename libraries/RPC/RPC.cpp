@@ -2,6 +2,73 @@
 
 static struct rpmsg_endpoint rp_endpoints[4];
 
+/*
+ * Shared SRAM layout: a header with one owner byte per block, then the bulk pool blocks.
+ * An allocation spanning several blocks stores its length in the first owner byte and marks
+ * the others as continuation. The CM7 sizes the pool from its linker region and clears the
+ * header before booting the CM4, which takes the block count from there; both cores
+ * serialize owner updates with a hardware semaphore.
+ * The header also carries, for each core, how many bytes its call and response feeds have
+ * let go of: the other core only sends a chunk once there is room for it (see RPC::write()).
+ */
+#define RPC_BULK_HSEM_ID		10
+#define RPC_BULK_MAGIC			0x424C4B31
+#define RPC_BULK_HEADER_SIZE	64
+#define RPC_BULK_MAX_BLOCKS		40
+#define RPC_BULK_FREE			0x00
+#define RPC_BULK_CONT			0xFF
+
+#define RPC_FEED_CALL			0
+#define RPC_FEED_RESP			1
+
+#ifdef CORE_CM7
+#define RPC_LOCAL_CORE			0
+#define RPC_REMOTE_CORE			1
+#else
+#define RPC_LOCAL_CORE			1
+#define RPC_REMOTE_CORE			0
+#endif
+
+typedef struct {
+  uint32_t magic;
+  uint32_t blocks;
+  uint32_t feed_done[2][2];
+  uint8_t owner[RPC_BULK_MAX_BLOCKS];
+} rpc_shm_header;
+
+static_assert(sizeof(rpc_shm_header) == RPC_BULK_HEADER_SIZE, "shared memory header does not fit");
+
+static volatile rpc_shm_header* const rpc_shm = (rpc_shm_header*)BULK_SHM_ADDRESS;
+
+static inline uint8_t* bulk_block(int index) {
+  return (uint8_t*)BULK_SHM_ADDRESS + RPC_BULK_HEADER_SIZE + index * RPC_BULK_BLOCK_SIZE;
+}
+
+static inline int bulk_blocks() {
+  // Nothing to hand out until the CM7 has set the pool up
+  return (rpc_shm->magic == RPC_BULK_MAGIC) ? rpc_shm->blocks : 0;
+}
+
+static inline int bulk_index(void* buf) {
+  int offset = (uint8_t*)buf - bulk_block(0);
+  if (offset < 0 || (offset % RPC_BULK_BLOCK_SIZE) != 0 || offset / RPC_BULK_BLOCK_SIZE >= bulk_blocks()) {
+    return -1;
+  }
+  return offset / RPC_BULK_BLOCK_SIZE;
+}
+
+static void bulk_lock() {
+  core_util_critical_section_enter();
+  while (HAL_HSEM_FastTake(RPC_BULK_HSEM_ID) != HAL_OK) {}
+}
+
+static void bulk_unlock() {
+  HAL_HSEM_Release(RPC_BULK_HSEM_ID, 0);
+  core_util_critical_section_exit();
+}
+
+static_assert(RPC_CALL_SLOTS > 0 && RPC_CALL_SLOTS <= 32, "RPC_CALL_SLOTS must be between 1 and 32");
+
 void rpc::client::post(RPCLIB_MSGPACK::sbuffer *buffer) {
 #ifdef CORE_CM7
   RPC1.write(ENDPOINT_CM7TOCM4, (const uint8_t*)buffer->data(), buffer->size());
@@ -10,17 +77,184 @@ void rpc::client::post(RPCLIB_MSGPACK::sbuffer *buffer) {
 #endif
 }
 
+int RPC::acquire_call(uint32_t timeout) {
+  if (!call_slots.try_acquire_for(rtos::Kernel::Clock::duration_u32(timeout))) {
+    return -1;
+  }
+  core_util_critical_section_enter();
+  int slot = __builtin_ctz(free_calls);
+  free_calls &= ~(1UL << slot);
+  call_generation++;
+  rpc::client& c = clients[slot];
+  c.id = (call_generation << 8) | slot;
+  c.state = rpc::client::CALL_PENDING;
+  core_util_critical_section_exit();
+  // Drop a completion nobody waited for during the previous use of the slot
+  while (c.done.try_acquire()) {}
+  return slot;
+}
+
+void RPC::release_call(int slot) {
+  rpc::client& c = clients[slot];
+  core_util_critical_section_enter();
+  if (c.state == rpc::client::CALL_PENDING) {
+    // The response is still on its way, dispatch() frees the slot when it lands
+    c.state = rpc::client::CALL_ABANDONED;
+    core_util_critical_section_exit();
+    return;
+  }
+  // Clear the slot before it is published as free, the next caller may grab it right away.
+  // The zone stays with the slot, complete_call() hands it back to the dispatcher
+  c.result.set(RPCLIB_MSGPACK::object());
+  c.error = false;
+  c.state = rpc::client::CALL_FREE;
+  free_calls |= (1UL << slot);
+  core_util_critical_section_exit();
+  call_slots.release();
+}
+
+void RPC::complete_call(uint32_t id, const RPCLIB_MSGPACK::object& result, bool error) {
+  uint32_t slot = id & 0xFF;
+  if (slot >= RPC_CALL_SLOTS || clients[slot].id != id) {
+    // Stale or unknown id, most likely the answer to an abandoned call whose slot got reused
+    return;
+  }
+  rpc::client& c = clients[slot];
+  core_util_critical_section_enter();
+  if (c.state == rpc::client::CALL_PENDING) {
+    // The slot keeps the zone the response was parsed into and gives the dispatcher the
+    // one from its previous call, so no zone is allocated unless get() took that away
+    RPCLIB_MSGPACK::unique_ptr<RPCLIB_MSGPACK::zone> spare(std::move(c.result.zone()));
+    c.result.set(result);
+    c.result.zone() = std::move(resp_zone);
+    resp_zone = std::move(spare);
+    c.error = error;
+    c.state = rpc::client::CALL_DONE;
+    core_util_critical_section_exit();
+    c.done.release();
+    return;
+  }
+  bool abandoned = (c.state == rpc::client::CALL_ABANDONED);
+  if (abandoned) {
+    c.state = rpc::client::CALL_DONE;
+  }
+  core_util_critical_section_exit();
+  if (abandoned) {
+    release_call(slot);
+  }
+}
+
+rpc::future& rpc::future::operator=(rpc::future&& other) {
+  if (this != &other) {
+    release();
+    rpc = other.rpc;
+    slot = other.slot;
+    id = other.id;
+    other.rpc = NULL;
+  }
+  return *this;
+}
+
+rpc::future::~future() {
+  release();
+}
+
+void rpc::future::release() {
+  if (rpc != NULL) {
+    rpc->release_call(slot);
+    rpc = NULL;
+  }
+}
+
+bool rpc::future::ready() {
+  return rpc != NULL && rpc->clients[slot].state == rpc::client::CALL_DONE;
+}
+
+bool rpc::future::failed() {
+  return ready() && rpc->clients[slot].error;
+}
+
+bool rpc::future::wait(uint32_t timeout) {
+  if (rpc == NULL) {
+    return false;
+  }
+  rpc::client& c = rpc->clients[slot];
+  if (c.state == rpc::client::CALL_DONE) {
+    return true;
+  }
+  return c.done.try_acquire_for(rtos::Kernel::Clock::duration_u32(timeout));
+}
+
+RPCLIB_MSGPACK::object_handle rpc::future::get() {
+  RPCLIB_MSGPACK::object_handle ret;
+  if (wait()) {
+    ret = std::move(rpc->clients[slot].result);
+  }
+  release();
+  return ret;
+}
+
+// Called with feed_mutex held: tells the other core how much room it has in this feed
+static void publish_feed(rpc::feed& f, int index) {
+  rpc_shm->feed_done[RPC_LOCAL_CORE][index] = f.received - f.pending();
+}
+
+int RPC::feed_chunk(rpc::feed& f, int index, const void* data, size_t len, int32_t signal) {
+  // Never waits: the sender only sends a chunk once publish_feed() says it fits,
+  // so it only finds the feed full when it gave up waiting for room
+  bool last = len < RPC_CHUNK_SIZE;
+  feed_mutex.lock();
+  rpc::feed::result ret = f.write((const uint8_t*)data, len, last);
+  if (ret == rpc::feed::FEED_FULL) {
+    f.drop(last);
+  }
+  f.received += len;
+  publish_feed(f, index);
+  feed_mutex.unlock();
+  if (ret == rpc::feed::FEED_OK && last) {
+    osSignalSet(dispatcherThreadId, signal);
+  }
+  return 0;
+}
+
+bool RPC::next_message(rpc::feed& f, int index, RPCLIB_MSGPACK::zone& z, RPCLIB_MSGPACK::object& msg) {
+  feed_mutex.lock();
+  bool ret = f.next(z, msg);
+  // Parsing frees the message bytes, the sender may go on
+  publish_feed(f, index);
+  feed_mutex.unlock();
+  return ret;
+}
+
+// The feed on the other core that messages sent on ep end up in
+static inline int remote_feed(enum endpoints_t ep) {
+#ifdef CORE_CM7
+  return (ep == ENDPOINT_CM7TOCM4) ? RPC_FEED_CALL : RPC_FEED_RESP;
+#else
+  return (ep == ENDPOINT_CM4TOCM7) ? RPC_FEED_CALL : RPC_FEED_RESP;
+#endif
+}
+
+void RPC::wait_feed_space(int index, size_t len) {
+  // Called with write_mutex held. Waits on the sending thread, never on the other core's
+  // event thread; after RPC_RX_TIMEOUT the chunk goes anyway and is dropped over there,
+  // as a handler that is itself waiting for a response would never make room
+  uint32_t start = millis();
+  while ((int32_t)(tx_sent[index] - rpc_shm->feed_done[RPC_REMOTE_CORE][index]) + (int32_t)len > RPC_RX_BUFFER_SIZE) {
+    if (millis() - start >= RPC_RX_TIMEOUT) {
+      break;
+    }
+    rtos::ThisThread::sleep_for(rtos::Kernel::Clock::duration_u32(1));
+  }
+}
+
 int RPC::rpmsg_recv_cm7tocm4_callback(struct rpmsg_endpoint *ept, void *data,
                                        size_t len, uint32_t src, void *priv)
 {
   // This fuction gets called when we are the rpc server and need to execute a function
   RPC* rpc = (RPC*)priv;
-  memcpy(rpc->pac_.buffer(), (const void*)data, len);
-  rpc->pac_.buffer_consumed(len);
-
-  osSignalSet(rpc->dispatcherThreadId, 0x1);
-
-  return 0;
+  rpc->count_rx();
+  return rpc->feed_chunk(rpc->call_feed, RPC_FEED_CALL, data, len, 0x1);
 }
 
 int RPC::rpmsg_recv_cm4tocm7_callback(struct rpmsg_endpoint *ept, void *data,
@@ -28,18 +262,15 @@ int RPC::rpmsg_recv_cm4tocm7_callback(struct rpmsg_endpoint *ept, void *data,
 {
   // This fuction gets called when we want to retrieve the rpc response (as clients)
   RPC* rpc = (RPC*)priv;
-  memcpy(rpc->pac_.buffer(), (const void*)data, len);
-  rpc->pac_.buffer_consumed(len);
-
-  osSignalSet(rpc->dispatcherThreadId, 0x2);
-
-  return 0;
+  rpc->count_rx();
+  return rpc->feed_chunk(rpc->resp_feed, RPC_FEED_RESP, data, len, 0x2);
 }
 
 int RPC::rpmsg_recv_raw_callback(struct rpmsg_endpoint *ept, void *data,
                                        size_t len, uint32_t src, void *priv)
 {
   RPC* rpc = (RPC*)priv;
+  rpc->count_rx();
   uint8_t* buf = (uint8_t*)data;
   for (int i=0; i<len; i++) {
     rpc->rx_buffer.store_char(buf[i]);
@@ -52,6 +283,103 @@ int RPC::rpmsg_recv_raw_callback(struct rpmsg_endpoint *ept, void *data,
   return 0;
 }
 
+int RPC::rpmsg_recv_bulk_callback(struct rpmsg_endpoint *ept, void *data,
+                                       size_t len, uint32_t src, void *priv)
+{
+  RPC* rpc = (RPC*)priv;
+  rpc->count_rx();
+  // Anything that is not a descriptor (like the channel enabling message) is dropped
+  if (len != sizeof(bulk_descriptor)) {
+    return 0;
+  }
+  bulk_descriptor desc;
+  memcpy(&desc, data, sizeof(desc));
+  if (rpc->bulk_queue.full()) {
+    // Nobody is going to read it, give the buffer back so the pool does not leak
+    rpc->bulkRelease(bulk_block(desc.block));
+    return 0;
+  }
+  rpc->bulk_queue.push(desc);
+  rpc->bulk_sem.release();
+  return 0;
+}
+
+void* RPC::bulkAlloc(size_t len) {
+  int count = (len + RPC_BULK_BLOCK_SIZE - 1) / RPC_BULK_BLOCK_SIZE;
+  int blocks = bulk_blocks();
+  if (count == 0 || count > blocks) {
+    return NULL;
+  }
+  void* ret = NULL;
+  bulk_lock();
+  int run = 0;
+  for (int i = 0; i < blocks; i++) {
+    run = (rpc_shm->owner[i] == RPC_BULK_FREE) ? run + 1 : 0;
+    if (run == count) {
+      int first = i - count + 1;
+      rpc_shm->owner[first] = count;
+      for (int j = first + 1; j <= i; j++) {
+        rpc_shm->owner[j] = RPC_BULK_CONT;
+      }
+      ret = bulk_block(first);
+      break;
+    }
+  }
+  bulk_unlock();
+  return ret;
+}
+
+void RPC::bulkRelease(void* buf) {
+  int index = bulk_index(buf);
+  if (index < 0) {
+    return;
+  }
+  bulk_lock();
+  int count = rpc_shm->owner[index];
+  if (count != RPC_BULK_FREE && count != RPC_BULK_CONT) {
+    for (int i = index; i < index + count; i++) {
+      rpc_shm->owner[i] = RPC_BULK_FREE;
+    }
+  }
+  bulk_unlock();
+}
+
+int RPC::bulkSend(void* buf, size_t len, uint32_t tag) {
+  int index = bulk_index(buf);
+  if (index < 0) {
+    return -1;
+  }
+  bulk_descriptor desc;
+  desc.block = index;
+  bulk_lock();
+  desc.count = rpc_shm->owner[index];
+  bulk_unlock();
+  desc.len = len;
+  desc.tag = tag;
+  if (desc.count == RPC_BULK_FREE || desc.count == RPC_BULK_CONT || len > desc.count * RPC_BULK_BLOCK_SIZE) {
+    return -1;
+  }
+  // From here on the buffer belongs to the other core
+  return OPENAMP_send(&rp_endpoints[ENDPOINT_BULK], &desc, sizeof(desc)) < 0 ? -1 : 0;
+}
+
+void* RPC::bulkReceive(size_t* len, uint32_t* tag, uint32_t timeout) {
+  if (!bulk_sem.try_acquire_for(rtos::Kernel::Clock::duration_u32(timeout))) {
+    return NULL;
+  }
+  bulk_descriptor desc;
+  if (!bulk_queue.pop(desc)) {
+    return NULL;
+  }
+  if (len != NULL) {
+    *len = desc.len;
+  }
+  if (tag != NULL) {
+    *tag = desc.tag;
+  }
+  return bulk_block(desc.block);
+}
+
 void RPC::new_service_cb(struct rpmsg_device *rdev, const char *name, uint32_t dest)
 {
   int idx = -1;
@@ -64,19 +392,44 @@ void RPC::new_service_cb(struct rpmsg_device *rdev, const char *name, uint32_t d
   if (strcmp(name, "raw") == 0) {
     OPENAMP_create_endpoint(&rp_endpoints[ENDPOINT_RAW], name, dest, rpmsg_recv_raw_callback, NULL);
   }
+  if (strcmp(name, "bulk") == 0) {
+    OPENAMP_create_endpoint(&rp_endpoints[ENDPOINT_BULK], name, dest, rpmsg_recv_bulk_callback, NULL);
+  }
 }
 
 osThreadId eventHandlerThreadId;
 
-void eventHandler() {
+void RPC::eventHandler() {
   eventHandlerThreadId = osThreadGetId();
   while (1) {
+    // Woken by the HSEM notification: every message queued meanwhile is
+    // delivered by this one call, so there is no need to wait for more
     osEvent v = osSignalWait(0, osWaitForever);
-#ifdef CORE_CM4
-    delay(50);
-#endif
     OPENAMP_check_for_message();
+    RPC1.end_rx_batch();
+  }
+}
+
+void RPC::count_rx() {
+  uint32_t latency = MAILBOX_Notify_Latency();
+  rx_stats.messages++;
+  rx_depth++;
+  rx_stats.latency = latency;
+  if (latency > rx_stats.max_latency) {
+    rx_stats.max_latency = latency;
+  }
+}
+
+void RPC::end_rx_batch() {
+  if (rx_depth == 0) {
+    return;
+  }
+  rx_stats.batches++;
+  rx_stats.depth = rx_depth;
+  if (rx_depth > rx_stats.max_depth) {
+    rx_stats.max_depth = rx_depth;
   }
+  rx_depth = 0;
 }
 
 #ifdef CORE_CM4
@@ -98,6 +451,7 @@ int RPC::begin() {
   rp_endpoints[0].priv = this;
   rp_endpoints[1].priv = this;
   rp_endpoints[2].priv = this;
+  rp_endpoints[3].priv = this;
 
   /* create a endpoint for rmpsg communication */
   int status = OPENAMP_create_endpoint(&rp_endpoints[ENDPOINT_CM7TOCM4], "cm7tocm4", RPMSG_ADDR_ANY,
@@ -122,11 +476,18 @@ int RPC::begin() {
     return 0;
   }
 
+  /* create a endpoint for bulk buffer descriptors */
+  status = OPENAMP_create_endpoint(&rp_endpoints[ENDPOINT_BULK], "bulk", RPMSG_ADDR_ANY,
+                                   rpmsg_recv_bulk_callback, NULL);
+  if (status < 0)
+  {
+    return 0;
+  }
+
   dispatcherThread = new rtos::Thread(osPriorityNormal);
   dispatcherThread->start(mbed::callback(this, &RPC::dispatch));
 
   initialized = true;
-  pac_.reserve_buffer(1024);
 
   return 1;
 }
@@ -141,7 +502,8 @@ static void OpenAMP_MPU_Config(void)
 	/* Disable the MPU */
 	HAL_MPU_Disable();
 
-	/* Configure the MPU attributes as WT for SDRAM */
+	/* The resource table, the vrings and the bulk pool live in D3 SRAM,
+	   shared with the M4: not cached, strongly ordered */
 	MPU_InitStruct.Enable = MPU_REGION_ENABLE;
 	MPU_InitStruct.BaseAddress = D3_SRAM_BASE;
 	MPU_InitStruct.Size = MPU_REGION_SIZE_64KB;
@@ -164,6 +526,11 @@ int RPC::begin() {
 
 	OpenAMP_MPU_Config();
 
+	// The CM4 is not running yet, so the bulk pool can be reset without locking
+	memset((void*)rpc_shm, 0, RPC_BULK_HEADER_SIZE);
+	rpc_shm->magic = RPC_BULK_MAGIC;
+	rpc_shm->blocks = min((BULK_SHM_SIZE - RPC_BULK_HEADER_SIZE) / RPC_BULK_BLOCK_SIZE, (size_t)RPC_BULK_MAX_BLOCKS);
+
 	//resource_table_load_from_flash();
 	//HAL_SYSCFG_EnableCM4BOOT();
 	HAL_RCCEx_EnableBootCore(RCC_BOOT_C2);
@@ -184,9 +551,12 @@ int RPC::begin() {
 
 	rpmsg_init_ept(&rp_endpoints[2], "raw", RPMSG_ADDR_ANY, RPMSG_ADDR_ANY, NULL, NULL);
 
+	rpmsg_init_ept(&rp_endpoints[3], "bulk", RPMSG_ADDR_ANY, RPMSG_ADDR_ANY, NULL, NULL);
+
 	rp_endpoints[0].priv = this;
 	rp_endpoints[1].priv = this;
 	rp_endpoints[2].priv = this;
+	rp_endpoints[3].priv = this;
 
 	/*
 	* The rpmsg service is initiate by the remote processor, on H7 new_service_cb
@@ -195,18 +565,21 @@ int RPC::begin() {
 	OPENAMP_Wait_EndPointready(&rp_endpoints[0], HAL_GetTick() + 500);
 	OPENAMP_Wait_EndPointready(&rp_endpoints[1], HAL_GetTick() + 500);
 	OPENAMP_Wait_EndPointready(&rp_endpoints[2], HAL_GetTick() + 500);
+	OPENAMP_Wait_EndPointready(&rp_endpoints[3], HAL_GetTick() + 500);
 
 	// Send first dummy message to enable the channel
 	int message = 0x00;
 	OPENAMP_send(&rp_endpoints[0], &message, sizeof(message));
 	OPENAMP_send(&rp_endpoints[1], &message, sizeof(message));
+	tx_sent[remote_feed(ENDPOINT_CM7TOCM4)] += sizeof(message);
+	tx_sent[remote_feed(ENDPOINT_CM4TOCM7)] += sizeof(message);
 	OPENAMP_send(&rp_endpoints[2], &message, sizeof(message));
+	OPENAMP_send(&rp_endpoints[3], &message, sizeof(message));
 
 	dispatcherThread = new rtos::Thread(osPriorityNormal);
 	dispatcherThread->start(mbed::callback(this, &RPC::dispatch));
 
 	initialized = true;
-	pac_.reserve_buffer(1024);
 	return 1;
 }
 #endif
@@ -220,37 +593,46 @@ void RPC::dispatch() {
 
     if (v.status == osEventSignal) {
        if (v.value.signals & 0x1) {
-        RPCLIB_MSGPACK::unpacked result;
-        while (pac_.next(result)) {
-          auto msg = result.get();
-          auto resp = rpc::detail::dispatcher::dispatch(msg, true);
-          auto data = resp.get_data();
-          if (resp.is_empty()) {
-            //printf("no response\n");
-          } else {
+        RPCLIB_MSGPACK::object msg;
+        while (next_message(call_feed, RPC_FEED_CALL, call_zone, msg)) {
+          // Anything but a call or notification (like the channel enabling message) is ignored
+          if (msg.type == RPCLIB_MSGPACK::type::ARRAY &&
+              rpc::detail::dispatcher::dispatch(msg, resp_buffer, true)) {
 #ifdef CORE_CM7
-            write(ENDPOINT_CM4TOCM7, (const uint8_t*)data.data(), data.size());
+            write(ENDPOINT_CM4TOCM7, (const uint8_t*)resp_buffer.data(), resp_buffer.size());
 #else
-            write(ENDPOINT_CM7TOCM4, (const uint8_t*)data.data(), data.size());
+            write(ENDPOINT_CM7TOCM4, (const uint8_t*)resp_buffer.data(), resp_buffer.size());
 #endif
           }
+          call_zone.clear();
         }
       }
       if (v.value.signals & 0x2) {
-        RPCLIB_MSGPACK::unpacked result;
-        while (pac_.next(result)) {
-          auto r = rpc::detail::response(std::move(result));
-          auto id = r.get_id();
-          // fill the correct client stuff
-          int i = 0;
-          for (i = 0; i<10; i++) {
-            if (clients[i] != NULL && (int)clients[i]->callThreadId == id) {
-              break;
-            }
+        RPCLIB_MSGPACK::object msg;
+        while (true) {
+          // Parsed straight into a zone the call slot can keep, see complete_call()
+          if (!resp_zone) {
+            resp_zone.reset(new RPCLIB_MSGPACK::zone(256));
+          }
+          resp_zone->clear();
+          if (!next_message(resp_feed, RPC_FEED_RESP, *resp_zone, msg)) {
+            break;
           }
-          clients[i]->result = std::move(*r.get_result());
-          // Unlock callThreadId thread
-          osSignalSet(clients[i]->callThreadId, 0x1);
+          // Anything but an array (like the channel enabling message) is ignored, like calls
+          if (msg.type != RPCLIB_MSGPACK::type::ARRAY) {
+            continue;
+          }
+          // [1, id, error, result]: any other array is counted as unparsable and dropped
+          RPCLIB_MSGPACK::object* fields = (msg.via.array.size == 4) ? msg.via.array.ptr : NULL;
+          if (fields == NULL ||
+              fields[0].type != RPCLIB_MSGPACK::type::POSITIVE_INTEGER || fields[0].via.u64 != 1 ||
+              fields[1].type != RPCLIB_MSGPACK::type::POSITIVE_INTEGER || fields[1].via.u64 > UINT32_MAX) {
+            resp_feed.errors++;
+            continue;
+          }
+          // The error, if any, is what the caller gets
+          bool error = !fields[2].is_nil();
+          complete_call((uint32_t)fields[1].via.u64, error ? fields[2] : fields[3], error);
         }
       }
     }
@@ -268,8 +650,29 @@ size_t RPC::write(uint8_t c) {
 }
 
 size_t RPC::write(enum endpoints_t ep, const uint8_t* buf, size_t len) {
-  int ret = OPENAMP_send(&rp_endpoints[ep], buf, len);
-  return len;
+  // Every chunk but the last is exactly RPC_CHUNK_SIZE long; if the message
+  // fills the last one too, an empty chunk tells the receiver it is complete.
+  // The lock keeps chunks of messages from different threads from interleaving
+  size_t sent = 0;
+  int index = remote_feed(ep);
+  write_mutex.lock();
+  while (true) {
+    size_t chunk = min(len - sent, (size_t)RPC_CHUNK_SIZE);
+    if (len <= RPC_RX_BUFFER_SIZE) {
+      // A larger message is dropped over there anyway, no point waiting for it
+      wait_feed_space(index, chunk);
+    }
+    if (OPENAMP_send(&rp_endpoints[ep], buf + sent, chunk) < 0) {
+      break;
+    }
+    sent += chunk;
+    tx_sent[index] += chunk;
+    if (chunk < RPC_CHUNK_SIZE) {
+      break;
+    }
+  }
+  write_mutex.unlock();
+  return sent;
 }
 
 arduino::RPC RPC1;
@@ -6,68 +6,132 @@ namespace arduino {
 class RPC;
 }
 
-namespace rpc {
-class client {
-
-  public:
-    template <typename... Args>
-    RPCLIB_MSGPACK::object_handle call(std::string const &func_name,
-                                       Args... args) {
-      LOG_DEBUG("Call function {} and wait for result", func_name);
-
-      callThreadId = osThreadGetId();
-
-      auto args_obj = std::make_tuple(args...);
-      auto call_obj = std::make_tuple(
-                        static_cast<uint8_t>(client::request_type::call), (const int)callThreadId, func_name,
-                        args_obj);
+// Number of calls that can be in flight at the same time (at most 32)
+#ifndef RPC_CALL_SLOTS
+#define RPC_CALL_SLOTS		10
+#endif
 
-      auto buffer = new RPCLIB_MSGPACK::sbuffer;
-      RPCLIB_MSGPACK::pack(*buffer, call_obj);
+// Initial size of each call slot's pack buffer, it only grows for larger requests
+#ifndef RPC_PACK_BUFFER_SIZE
+#define RPC_PACK_BUFFER_SIZE	128
+#endif
 
-      post(buffer);
-
-      osSignalWait(0, osWaitForever);
+namespace rpc {
 
-      //getResult(result);
+class future;
 
-      delete buffer;
+class client {
 
-      RPCLIB_MSGPACK::object_handle q = std::move(result);
-      return q;
+  public:
+    //! \brief Posts a call with the given function and arguments, tagged with
+    //! this client's call id. The response is routed back by RPC::dispatch().
+    //! \param func_id The name id of the function (see rpc::detail::name_id).
+    //! \note The request is packed into this client's own buffer, which keeps
+    //! its capacity between calls, so steady state calls do not allocate.
+    template <typename... Args>
+    void post_call(uint32_t func_id, Args const&... args) {
+      LOG_DEBUG("Call function {:08x}", func_id);
+
+      buffer.clear();
+      RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer> pk(buffer);
+      pk.pack_array(4);
+      pk.pack(static_cast<uint8_t>(client::request_type::call));
+      pk.pack(id);
+      pk.pack(func_id);
+      pack_args(pk, args...);
+
+      post(&buffer);
     }
 
-    //! \brief Sends a notification with the given name and arguments (if any).
-    //! \param func_name The name of the notification to call.
+    //! \brief Sends a notification with the given function and arguments (if any).
+    //! \param func_id The name id of the function to call.
     //! \param args The arguments to pass to the function.
     //! \note This function returns when the notification is written to the
     //! socket.
     //! \tparam Args THe types of the arguments.
     template <typename... Args>
-    void send(std::string const &func_name, Args... args) {
-      LOG_DEBUG("Call function {} and forget", func_name);
-
-      auto args_obj = std::make_tuple(args...);
-      auto call_obj = std::make_tuple(
-                        static_cast<uint8_t>(client::request_type::notification), func_name,
-                        args_obj);
+    void send(uint32_t func_id, Args const&... args) {
+      LOG_DEBUG("Call function {:08x} and forget", func_id);
 
-      auto buffer = new RPCLIB_MSGPACK::sbuffer;
-      RPCLIB_MSGPACK::pack(*buffer, call_obj);
+      buffer.clear();
+      RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer> pk(buffer);
+      pk.pack_array(3);
+      pk.pack(static_cast<uint8_t>(client::request_type::notification));
+      pk.pack(func_id);
+      pack_args(pk, args...);
 
-      post(buffer);
-      delete buffer;
+      post(&buffer);
     }
 
   protected:
-    osThreadId callThreadId;
     friend class arduino::RPC;
+    friend class future;
+
+    enum call_state { CALL_FREE = 0, CALL_PENDING, CALL_DONE, CALL_ABANDONED };
+
+    // Slot index in the low byte, generation counter above it
+    uint32_t id = 0;
+    volatile uint8_t state = CALL_FREE;
+    // The remote function reported an error, result holds it
+    bool error = false;
+    rtos::Semaphore done;
     RPCLIB_MSGPACK::object_handle result;
+    RPCLIB_MSGPACK::sbuffer buffer{RPC_PACK_BUFFER_SIZE};
 
   private:
     enum class request_type { call = 0, notification = 2 };
 
+    // Packs the arguments as an array in place, without building a tuple of copies
+    template <typename... Args>
+    static void pack_args(RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer>& pk, Args const&... args) {
+      pk.pack_array(sizeof...(Args));
+      int expand[] = { 0, (pk.pack(args), 0)... };
+      (void)expand;
+    }
+
     void post(RPCLIB_MSGPACK::sbuffer *buffer);
-    void getResult(RPCLIB_MSGPACK::object_handle& res);
+};
+
+//! \brief Handle to a call started with RPC::call_async(). The slot in the
+//! call table is held until get() is called or the handle goes out of scope.
+class future {
+
+  public:
+    future() {}
+    future(arduino::RPC* rpc, int slot, uint32_t id) : rpc(rpc), slot(slot), id(id) {}
+    future(future&& other) : rpc(other.rpc), slot(other.slot), id(other.id) {
+      other.rpc = NULL;
+    }
+    future& operator=(future&& other);
+    ~future();
+
+    //! \brief False if the call could not be started.
+    bool valid() const {
+      return rpc != NULL;
+    }
+    //! \brief True once the response has arrived.
+    bool ready();
+    //! \brief True if the remote function reported an error instead of a
+    //! result. get() then returns the error object.
+    bool failed();
+    //! \brief Waits up to timeout milliseconds for the response.
+    bool wait(uint32_t timeout = osWaitForever);
+    //! \brief Waits for the response and returns it, releasing the call slot.
+    RPCLIB_MSGPACK::object_handle get();
+    //! \brief Waits for the response and converts the result into value,
+    //! releasing the call slot. Unlike get() the result stays in the slot's
+    //! zone, which the next response reuses instead of allocating one.
+    //! \returns False if the call failed or the result is not a T.
+    template <typename T>
+    bool get(T& value);
+
+  private:
+    future(const future&) = delete;
+    future& operator=(const future&) = delete;
+    void release();
+
+    arduino::RPC* rpc = NULL;
+    int slot = -1;
+    uint32_t id = 0;
 };
 }
@@ -0,0 +1,77 @@
+#include "RPC_feed.h"
+#include <string.h>
+#include <stdlib.h>
+
+rpc::feed::feed(size_t size) : size(size) {
+  buf = (uint8_t*)malloc(size);
+  if (buf == NULL) {
+    this->size = 0;
+  }
+}
+
+rpc::feed::~feed() {
+  free(buf);
+}
+
+rpc::feed::result rpc::feed::write(const uint8_t* data, size_t len, bool last) {
+  if (skipping) {
+    skipping = !last;
+    return FEED_DROPPED;
+  }
+  if (used - boundary + len > size) {
+    // The message would never fit, even with the buffer empty
+    drop(last);
+    return FEED_DROPPED;
+  }
+  if (used - off + len > size) {
+    return FEED_FULL;
+  }
+  if (size - used < len) {
+    // Slide the unread bytes to the start instead of growing the buffer
+    memmove(buf, buf + off, used - off);
+    boundary -= off;
+    used -= off;
+    off = 0;
+  }
+  memcpy(buf + used, data, len);
+  used += len;
+  if (last) {
+    boundary = used;
+  }
+  return FEED_OK;
+}
+
+void rpc::feed::drop(bool last) {
+  used = boundary;
+  skipping = !last;
+  dropped++;
+}
+
+bool rpc::feed::next(RPCLIB_MSGPACK::zone& z, RPCLIB_MSGPACK::object& obj) {
+  while (off < boundary) {
+    size_t noff = off;
+    bool referenced;
+    // No container or string can have more elements than the message has bytes,
+    // a corrupted length must not get to allocate (or recurse) that much
+    size_t len = boundary - off;
+    RPCLIB_MSGPACK::unpack_limit limit(len, len, len, len, len, RPC_FEED_MAX_DEPTH);
+    RPCLIB_MSGPACK::parse_return ret = RPCLIB_MSGPACK::PARSE_PARSE_ERROR;
+    try {
+      ret = RPCLIB_MSGPACK::detail::unpack_imp((const char*)buf, boundary, noff, z, obj,
+                                               referenced, NULL, NULL, limit);
+    } catch (...) {
+    }
+    if (ret == RPCLIB_MSGPACK::PARSE_SUCCESS || ret == RPCLIB_MSGPACK::PARSE_EXTRA_BYTES) {
+      off = noff;
+      return true;
+    }
+    // Truncated or malformed, skip to the end of what was received
+    errors++;
+    off = boundary;
+    z.clear();
+  }
+  if (off == used) {
+    off = boundary = used = 0;
+  }
+  return false;
+}
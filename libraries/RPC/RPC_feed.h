@@ -0,0 +1,75 @@
+#ifndef __RPC_FEED_H__
+#define __RPC_FEED_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rpc/config.h"
+#include "rpc/msgpack.hpp"
+
+// Deepest nesting of arrays and maps accepted in a message
+#ifndef RPC_FEED_MAX_DEPTH
+#define RPC_FEED_MAX_DEPTH	16
+#endif
+
+namespace rpc {
+
+//! \brief Bounded buffer between an rpmsg endpoint and the msgpack parser.
+//! Messages larger than one rpmsg payload arrive in several chunks: every chunk
+//! but the last one is exactly the maximum payload size, so a shorter chunk
+//! marks the end of a message (see RPC::write()). Only complete messages are
+//! parsed, from a single buffer that is compacted in place and never grows.
+//! The class does no locking, the producer and the consumer must serialize
+//! their calls.
+class feed {
+
+  public:
+    enum result { FEED_OK = 0, FEED_FULL, FEED_DROPPED };
+
+    feed(size_t size);
+    ~feed();
+
+    //! \brief Appends a chunk of a message.
+    //! \param last True if the chunk ends a message.
+    //! \returns FEED_OK, FEED_FULL if there is no room until the consumer reads
+    //! the messages already queued (the call can be retried) or FEED_DROPPED if
+    //! the message is larger than the whole buffer or is being skipped.
+    result write(const uint8_t* data, size_t len, bool last);
+
+    //! \brief Gives up on a chunk that got FEED_FULL: the partial message is
+    //! thrown away, as is the rest of it if more chunks follow.
+    void drop(bool last);
+
+    //! \brief Parses the next complete message.
+    //! \param z Zone the object is allocated in, it can be reused between calls.
+    //! \returns False if no complete message is queued.
+    bool next(RPCLIB_MSGPACK::zone& z, RPCLIB_MSGPACK::object& obj);
+
+    //! \brief Number of bytes waiting to be parsed.
+    size_t pending() const {
+      return used - off;
+    }
+
+    //! \brief Bytes of all the chunks offered to the feed, kept up to date by
+    //! the caller. Less pending(), it is how much the feed has let go of.
+    uint32_t received = 0;
+    //! \brief Messages thrown away because they did not fit or timed out.
+    uint32_t dropped = 0;
+    //! \brief Messages thrown away because they could not be parsed.
+    uint32_t errors = 0;
+
+  private:
+    feed(const feed&) = delete;
+    feed& operator=(const feed&) = delete;
+
+    uint8_t* buf;
+    size_t size;
+    // buf[off, boundary) holds complete messages, buf[boundary, used) a partial one
+    size_t off = 0;
+    size_t boundary = 0;
+    size_t used = 0;
+    // Set after a drop until the chunk that ends the dropped message arrives
+    bool skipping = false;
+};
+}
+
+#endif
@@ -12,6 +12,7 @@
 #include "rpclib.h"
 #include "rpc/dispatcher.h"
 #include "RPC_client.h"
+#include "RPC_feed.h"
 #ifdef _BIN
 #undef BIN
 #define BIN _BIN
@@ -38,9 +39,51 @@ extern "C" {
 enum endpoints_t {
 	ENDPOINT_CM7TOCM4 = 0,
 	ENDPOINT_CM4TOCM7,
-	ENDPOINT_RAW
+	ENDPOINT_RAW,
+	ENDPOINT_BULK
 };
 
+#ifndef RPC_BULK_BLOCK_SIZE
+#define RPC_BULK_BLOCK_SIZE		4096
+#endif
+
+// Room for incoming calls and for responses, each; a larger message is dropped
+#ifndef RPC_RX_BUFFER_SIZE
+#define RPC_RX_BUFFER_SIZE		2048
+#endif
+
+// How long a sender waits for room in the other core's receive buffer before sending anyway
+// (the message is then dropped over there)
+#ifndef RPC_RX_TIMEOUT
+#define RPC_RX_TIMEOUT			100
+#endif
+
+// Largest rpmsg payload. Longer messages are split into chunks of exactly this
+// size, followed by a shorter (possibly empty) one that ends the message
+#define RPC_CHUNK_SIZE			(RPMSG_BUFFER_SIZE - 16)
+
+#ifndef RPC_BULK_QUEUE_LEN
+#define RPC_BULK_QUEUE_LEN		16
+#endif
+
+// Sent over the bulk endpoint in place of the payload, which stays in the shared pool
+typedef struct _bulk_descriptor {
+  uint16_t block;
+  uint16_t count;
+  uint32_t len;
+  uint32_t tag;
+} bulk_descriptor;
+
+// Receive path instrumentation, see RPC::rxStats()
+typedef struct _rpc_rx_stats {
+  uint32_t messages;      // rpmsg messages delivered to the endpoints
+  uint32_t batches;       // notifications that delivered at least one message
+  uint32_t depth;         // messages delivered by the last batch
+  uint32_t max_depth;     // most messages delivered by a single batch
+  uint32_t latency;       // us from the sender raising the notification to the endpoint callback
+  uint32_t max_latency;
+} rpc_rx_stats;
+
 typedef struct _service_request {
   uint8_t* data;
 } service_request;
@@ -71,6 +114,16 @@ class RPC : public Stream, public rpc::detail::dispatcher {
 			return initialized;
 		}
 
+		rpc_rx_stats rxStats() {
+			return rx_stats;
+		}
+
+		// Incoming calls and responses thrown away because they did not fit,
+		// timed out waiting for room or could not be parsed
+		uint32_t rxDropped() {
+			return call_feed.dropped + call_feed.errors + resp_feed.dropped + resp_feed.errors;
+		}
+
 	    void attach(void (*fptr)(void))
 	    {
 	        if (fptr != NULL) {
@@ -78,29 +131,59 @@ class RPC : public Stream, public rpc::detail::dispatcher {
 	        }
 	    }
 
+		// Starts a call and returns immediately, so one thread can keep several calls in flight.
+		// The function travels as its name id (rpc::detail::name_id), not as a string.
 		template <typename... Args>
-    	RPCLIB_MSGPACK::object_handle call(std::string const &func_name,
-                                       Args... args) {
-    		// find a free spot in clients[]
-    		// create new object
-    		// protect this with mutex
-    		int i = 0;
-    		for (i=0; i<10; i++) {
-    			if (clients[i] == NULL) {
-    				clients[i] = new rpc::client();
-    				break;
-    			}
-    		}
-    		// thread start and client .call
-    		clients[i]->call(func_name, args...);
-    		RPCLIB_MSGPACK::object_handle ret = std::move(clients[i]->result);
-
-    		delete clients[i];
-    		clients[i] = NULL;
-    		return ret;
-    	}
-
-		rpc::client* clients[10];
+		rpc::future call_async(const char* func_name, Args const&... args) {
+			int slot = acquire_call();
+			if (slot < 0) {
+				return rpc::future();
+			}
+			clients[slot].post_call(rpc::detail::name_id(func_name), args...);
+			return rpc::future(this, slot, clients[slot].id);
+		}
+
+		template <typename... Args>
+		rpc::future call_async(std::string const &func_name, Args const&... args) {
+			return call_async(func_name.c_str(), args...);
+		}
+
+		template <typename... Args>
+		RPCLIB_MSGPACK::object_handle call(const char* func_name,
+										Args const&... args) {
+			return call_async(func_name, args...).get();
+		}
+
+		template <typename... Args>
+		RPCLIB_MSGPACK::object_handle call(std::string const &func_name,
+										Args const&... args) {
+			return call_async(func_name.c_str(), args...).get();
+		}
+
+		// Fire and forget: the remote function runs but no response comes back
+		template <typename... Args>
+		void send(const char* func_name, Args const&... args) {
+			int slot = acquire_call();
+			if (slot < 0) {
+				return;
+			}
+			clients[slot].send(rpc::detail::name_id(func_name), args...);
+			clients[slot].state = rpc::client::CALL_DONE;
+			release_call(slot);
+		}
+
+		rpc::client clients[RPC_CALL_SLOTS];
+
+		// Zero-copy transfers between the cores: buffers come from a pool in shared SRAM
+		// and only a descriptor travels over rpmsg. The receiver hands the buffer back
+		// to the pool with bulkRelease() once it is done with it.
+		void* bulkAlloc(size_t len);
+		int bulkSend(void* buf, size_t len, uint32_t tag = 0);
+		void* bulkReceive(size_t* len, uint32_t* tag = NULL, uint32_t timeout = osWaitForever);
+		void bulkRelease(void* buf);
+		size_t bulkAvailable() {
+			return bulk_queue.size();
+		}
 
 	private:
 		RingBufferN<256> rx_buffer;
@@ -111,15 +194,47 @@ class RPC : public Stream, public rpc::detail::dispatcher {
                                        size_t len, uint32_t src, void *priv);
 		static int rpmsg_recv_raw_callback(struct rpmsg_endpoint *ept, void *data,
                                        size_t len, uint32_t src, void *priv);
+		static int rpmsg_recv_bulk_callback(struct rpmsg_endpoint *ept, void *data,
+                                       size_t len, uint32_t src, void *priv);
 		static void new_service_cb(struct rpmsg_device *rdev, const char *name, uint32_t dest);
 
+		friend class rpc::future;
+		int acquire_call(uint32_t timeout = osWaitForever);
+		void release_call(int slot);
+		void complete_call(uint32_t id, const RPCLIB_MSGPACK::object& result, bool error);
+		// One bit per free slot in clients[]
+		uint32_t free_calls = (RPC_CALL_SLOTS == 32) ? 0xFFFFFFFF : ((1UL << RPC_CALL_SLOTS) - 1);
+		uint32_t call_generation = 0;
+		rtos::Semaphore call_slots{RPC_CALL_SLOTS};
+
 		void dispatch();
+		static void eventHandler();
+		void count_rx();
+		void end_rx_batch();
+		rpc_rx_stats rx_stats = {};
+		uint32_t rx_depth = 0;
 		events::EventQueue eventQueue;
 		mbed::Ticker ticker;
 		rtos::Thread* eventThread;
 		rtos::Thread* dispatcherThread;
-		RPCLIB_MSGPACK::unpacker pac_;
+		// Incoming calls and responses are kept apart, so neither can be mistaken for the other
+		int feed_chunk(rpc::feed& f, int index, const void* data, size_t len, int32_t signal);
+		bool next_message(rpc::feed& f, int index, RPCLIB_MSGPACK::zone& z, RPCLIB_MSGPACK::object& msg);
+		void wait_feed_space(int index, size_t len);
+		// Bytes sent to the other core's call and response feeds
+		uint32_t tx_sent[2] = {};
+		rpc::feed call_feed{RPC_RX_BUFFER_SIZE};
+		rpc::feed resp_feed{RPC_RX_BUFFER_SIZE};
+		rtos::Mutex feed_mutex;
+		rtos::Mutex write_mutex;
+		RPCLIB_MSGPACK::zone call_zone{512};
+		// Responses are parsed here, complete_call() trades it for the call slot's zone
+		RPCLIB_MSGPACK::unique_ptr<RPCLIB_MSGPACK::zone> resp_zone;
+		// Responses to incoming calls are packed here, reused for every call
+		RPCLIB_MSGPACK::sbuffer resp_buffer;
 		mbed::Callback<void()> _rx;
+		mbed::CircularBuffer<bulk_descriptor, RPC_BULK_QUEUE_LEN> bulk_queue;
+		rtos::Semaphore bulk_sem;
 
 		//rpc::detail::response response;
 		RPCLIB_MSGPACK::object_handle call_result;
@@ -128,6 +243,20 @@ class RPC : public Stream, public rpc::detail::dispatcher {
 };
 }
 
+template <typename T>
+bool rpc::future::get(T& value) {
+  bool ret = wait() && !failed();
+  if (ret) {
+    try {
+      rpc->clients[slot].result.get().convert(value);
+    } catch (...) {
+      ret = false;
+    }
+  }
+  release();
+  return ret;
+}
+
 extern arduino::RPC RPC1;
 
 #endif
@@ -0,0 +1,142 @@
+#include "Arduino.h"
+#include "RPC_internal.h"
+#include "mbed_mem_trace.h"
+
+/**
+ * Measures the cost of small RPC calls from the M4 to the M7.
+ * Upload the same sketch to both cores and open the Serial monitor:
+ * the M4 reports, through the RPC1 stream, the time and the number of
+ * heap allocations per call and per notification.
+ *
+ * The "baseline" lines run a copy of the request path RPC1 used before
+ * calls were packed into per-slot buffers: a client object and an sbuffer
+ * allocated for every request, and the name packed as a std::string
+ * inside a std::tuple. The baseline notification is the old send() as a
+ * whole. The baseline call only covers building and posting the request,
+ * its response is not waited for (the old call() also unpacked each
+ * response into a newly allocated zone, which is not counted here).
+ **/
+
+#define ITERATIONS 1000
+
+#ifdef CORE_CM7
+
+int reportSample(int channel, float value) {
+  return channel;
+}
+
+void setup() {
+  Serial.begin(115200);
+  RPC1.begin();
+  RPC1.bind("reportSample", reportSample);
+}
+
+void loop() {
+  while (RPC1.available()) {
+    Serial.write(RPC1.read());
+  }
+}
+
+#else
+
+// Counts every malloc, calloc and realloc made on this core, from any thread
+static volatile uint32_t alloc_count = 0;
+
+static void count_alloc(uint8_t op, void *res, void *caller, ...) {
+  if (op != MBED_MEM_TRACE_FREE) {
+    alloc_count++;
+  }
+}
+
+// What the old rpc::client kept for a call
+struct baseline_client {
+  osThreadId callThreadId;
+  RPCLIB_MSGPACK::object_handle result;
+};
+
+static void baseline_post(RPCLIB_MSGPACK::sbuffer *buffer) {
+  RPC1.write(ENDPOINT_CM4TOCM7, (const uint8_t*)buffer->data(), buffer->size());
+}
+
+// The old RPC::call() up to the point where it waited for the response
+template <typename... Args>
+void baseline_call(std::string const &func_name, Args... args) {
+  baseline_client* client = new baseline_client();
+  client->callThreadId = osThreadGetId();
+
+  auto args_obj = std::make_tuple(args...);
+  auto call_obj = std::make_tuple(
+                    static_cast<uint8_t>(0), (const int)client->callThreadId, func_name,
+                    args_obj);
+
+  auto buffer = new RPCLIB_MSGPACK::sbuffer;
+  RPCLIB_MSGPACK::pack(*buffer, call_obj);
+
+  baseline_post(buffer);
+
+  delete buffer;
+  delete client;
+}
+
+// The old rpc::client::send()
+template <typename... Args>
+void baseline_send(std::string const &func_name, Args... args) {
+  auto args_obj = std::make_tuple(args...);
+  auto call_obj = std::make_tuple(
+                    static_cast<uint8_t>(2), func_name,
+                    args_obj);
+
+  auto buffer = new RPCLIB_MSGPACK::sbuffer;
+  RPCLIB_MSGPACK::pack(*buffer, call_obj);
+
+  baseline_post(buffer);
+  delete buffer;
+}
+
+static void report(const char* label, uint32_t us, uint32_t allocs) {
+  RPC1.println(String(label) + String((float)us / ITERATIONS) + " us, " +
+               String((float)allocs / ITERATIONS) + " allocations");
+}
+
+void setup() {
+  RPC1.begin();
+  delay(1000);
+  mbed_mem_trace_set_callback(count_alloc);
+}
+
+void loop() {
+  // Warm up, so every call slot already owns a pack buffer
+  RPC1.call("reportSample", 0, 0.0f);
+
+  uint32_t allocs = alloc_count;
+  uint32_t start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    RPC1.call("reportSample", i, i * 0.5f);
+  }
+  report("call: ", micros() - start, alloc_count - allocs);
+
+  allocs = alloc_count;
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    RPC1.send("reportSample", i, i * 0.5f);
+  }
+  report("send: ", micros() - start, alloc_count - allocs);
+
+  allocs = alloc_count;
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    baseline_call("reportSample", i, i * 0.5f);
+  }
+  report("baseline call (request only): ", micros() - start, alloc_count - allocs);
+
+  allocs = alloc_count;
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    baseline_send("reportSample", i, i * 0.5f);
+  }
+  report("baseline send: ", micros() - start, alloc_count - allocs);
+
+  delay(5000);
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "Arduino.h"
+#include "RPC_internal.h"
+#include "mbed_mem_trace.h"
+#include <unordered_map>
+
+/**
+ * Measures how long the dispatcher takes to serve a call, and how many heap
+ * allocations it makes, compared with the dispatcher RPC1 used before.
+ * The baseline below is a copy of that dispatcher: handlers kept in an
+ * unordered_map of std::function by name, each returning a heap allocated
+ * object_handle that is wrapped in a response and packed afterwards.
+ * Each dispatcher gets the request its own client sent: the name id for
+ * the current one, the name string for the baseline.
+ * Runs on a single core, no M4 firmware is needed.
+ **/
+
+#define ITERATIONS 10000
+
+class baseline_dispatcher {
+public:
+  using adaptor_type = std::function<std::unique_ptr<RPCLIB_MSGPACK::object_handle>(
+      RPCLIB_MSGPACK::object const &)>;
+  using call_t = std::tuple<int8_t, uint32_t, std::string, RPCLIB_MSGPACK::object>;
+
+  // Only the non-void result, non-zero argument case is needed here
+  template <typename F>
+  void bind(std::string const &name, F func) {
+    using args_type = typename rpc::detail::func_traits<F>::args_type;
+    funcs_.insert(std::make_pair(name, [func, name](RPCLIB_MSGPACK::object const &args) {
+      constexpr int args_count = std::tuple_size<args_type>::value;
+      if (args.via.array.size != args_count) {
+        throw std::runtime_error("wrong argument count");
+      }
+      args_type args_real;
+      args.convert(args_real);
+      auto z = rpc::detail::make_unique<RPCLIB_MSGPACK::zone>();
+      auto result = RPCLIB_MSGPACK::object(rpc::detail::call(func, args_real), *z);
+      return rpc::detail::make_unique<RPCLIB_MSGPACK::object_handle>(result, std::move(z));
+    }));
+  }
+
+  rpc::detail::response dispatch(RPCLIB_MSGPACK::object const &msg) {
+    call_t the_call;
+    msg.convert(the_call);
+
+    auto &&id = std::get<1>(the_call);
+    auto &&name = std::get<2>(the_call);
+    auto &&args = std::get<3>(the_call);
+
+    auto it_func = funcs_.find(name);
+    if (it_func != end(funcs_)) {
+      try {
+        auto result = (it_func->second)(args);
+        return rpc::detail::response::make_result(id, std::move(result));
+      } catch (std::exception &e) {
+        return rpc::detail::response::make_error(id, std::string(e.what()));
+      }
+    }
+    return rpc::detail::response::make_error(id, std::string("function not found"));
+  }
+
+private:
+  std::unordered_map<std::string, adaptor_type> funcs_;
+};
+
+rpc::detail::dispatcher d;
+baseline_dispatcher baseline;
+RPCLIB_MSGPACK::sbuffer request;
+RPCLIB_MSGPACK::sbuffer baseline_request;
+
+int add(int a, int b) {
+  return a + b;
+}
+
+// Counts every malloc, calloc and realloc, including the ones freed again
+static volatile uint32_t alloc_count = 0;
+
+static void count_alloc(uint8_t op, void *res, void *caller, ...) {
+  if (op != MBED_MEM_TRACE_FREE) {
+    alloc_count++;
+  }
+}
+
+static void report(const char* label, uint32_t us, uint32_t allocs) {
+  Serial.print(label);
+  Serial.print((float)us / ITERATIONS);
+  Serial.print(" us/call, ");
+  Serial.print((float)allocs / ITERATIONS);
+  Serial.println(" allocations/call");
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {}
+
+  d.bind("add", add);
+  baseline.bind("add", add);
+
+  // The same request RPC1.call("add", 1, 2) puts on the wire
+  RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer> pk(request);
+  pk.pack_array(4);
+  pk.pack(0);
+  pk.pack(1);
+  pk.pack(rpc::detail::name_id("add"));
+  pk.pack_array(2);
+  pk.pack(1);
+  pk.pack(2);
+
+  // And the one the old client sent, with the name as a string
+  RPCLIB_MSGPACK::pack(baseline_request,
+                       std::make_tuple(static_cast<uint8_t>(0), 1, std::string("add"),
+                                       std::make_tuple(1, 2)));
+
+  mbed_mem_trace_set_callback(count_alloc);
+}
+
+void loop() {
+  auto msg = RPCLIB_MSGPACK::unpack(request.data(), request.size());
+  RPCLIB_MSGPACK::sbuffer out;
+  d.dispatch(msg.get(), out, true);
+
+  uint32_t allocs = alloc_count;
+  uint32_t start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    d.dispatch(msg.get(), out, true);
+  }
+  report("current:  ", micros() - start, alloc_count - allocs);
+
+  // As the old RPC::dispatch() did: build the response, then pack it
+  auto baseline_msg = RPCLIB_MSGPACK::unpack(baseline_request.data(), baseline_request.size());
+  allocs = alloc_count;
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    auto resp = baseline.dispatch(baseline_msg.get());
+    auto data = resp.get_data();
+  }
+  report("baseline: ", micros() - start, alloc_count - allocs);
+
+  delay(5000);
+}
@@ -0,0 +1,96 @@
+#include "Arduino.h"
+#include "RPC_internal.h"
+
+/**
+ * Round trip latency between the two cores.
+ * Upload the same sketch to both cores: the M7 calls a function on the M4
+ * that returns its argument, and prints on Serial the round trip times and
+ * the receive statistics of both cores.
+ **/
+
+#define ITERATIONS 1000
+
+#ifdef CORE_CM7
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {}
+
+  // Initialize RPC library; this also boots the M4 core
+  RPC1.begin();
+  delay(500);
+}
+
+static void printStats(const char* core, rpc_rx_stats s) {
+  Serial.print(core);
+  Serial.print(" messages: ");
+  Serial.print(s.messages);
+  Serial.print(" batches: ");
+  Serial.print(s.batches);
+  Serial.print(" max depth: ");
+  Serial.print(s.max_depth);
+  Serial.print(" notify to callback us last/max: ");
+  Serial.print(s.latency);
+  Serial.print("/");
+  Serial.println(s.max_latency);
+}
+
+void loop() {
+  uint32_t min_us = 0xFFFFFFFF;
+  uint32_t max_us = 0;
+  uint32_t errors = 0;
+  uint32_t start = micros();
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    uint32_t t0 = micros();
+    int ret = RPC1.call("ping", i).as<int>();
+    uint32_t elapsed = micros() - t0;
+    if (ret != i) {
+      errors++;
+    }
+    min_us = min(min_us, elapsed);
+    max_us = max(max_us, elapsed);
+  }
+
+  uint32_t total_us = micros() - start;
+
+  Serial.print("round trip us min/avg/max: ");
+  Serial.print(min_us);
+  Serial.print("/");
+  Serial.print(total_us / ITERATIONS);
+  Serial.print("/");
+  Serial.println(max_us);
+  Serial.print("errors: ");
+  Serial.println(errors);
+
+  printStats("M7", RPC1.rxStats());
+  auto m4 = RPC1.call("stats").as<std::vector<uint32_t>>();
+  if (m4.size() == 6) {
+    rpc_rx_stats s = { m4[0], m4[1], m4[2], m4[3], m4[4], m4[5] };
+    printStats("M4", s);
+  }
+
+  delay(2000);
+}
+
+#else
+
+int ping(int i) {
+  return i;
+}
+
+std::vector<uint32_t> stats() {
+  rpc_rx_stats s = RPC1.rxStats();
+  return { s.messages, s.batches, s.depth, s.max_depth, s.latency, s.max_latency };
+}
+
+void setup() {
+  RPC1.begin();
+  RPC1.bind("ping", ping);
+  RPC1.bind("stats", stats);
+}
+
+void loop() {
+}
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * Sustained throughput of SerialUSB in each direction. On the computer:
+ *   stty -F /dev/ttyACM0 raw -echo
+ *   cat /dev/ttyACM0 | grep -a MB &
+ * then send 't' to time device to host:
+ *   printf t > /dev/ttyACM0
+ * or 'r' followed by the data to time host to device:
+ *   (printf r; head -c 4194304 /dev/zero) > /dev/ttyACM0
+ *
+ * The "print" part of the 't' test writes a few bytes at a time, the way
+ * print() of formatted text does; SerialUSB collects them into full packets.
+ **/
+
+#define TOTAL_SIZE  (4 * 1024 * 1024)
+#define PRINT_MS    2000
+
+uint8_t buffer[4096];
+
+static void report(const char* name, uint32_t bytes, uint32_t us) {
+  SerialUSB.print("\r\n");
+  SerialUSB.print(name);
+  SerialUSB.print(": ");
+  SerialUSB.print(bytes);
+  SerialUSB.print(" bytes, ");
+  SerialUSB.print((float)bytes / us);
+  SerialUSB.println(" MB/s");
+}
+
+static void deviceToHost() {
+  memset(buffer, '.', sizeof(buffer));
+  uint32_t start = micros();
+  for (uint32_t sent = 0; sent < TOTAL_SIZE; sent += sizeof(buffer)) {
+    SerialUSB.write(buffer, sizeof(buffer));
+  }
+  SerialUSB.flush();
+  report("write", TOTAL_SIZE, micros() - start);
+
+  uint32_t bytes = 0;
+  uint32_t n = 0;
+  start = micros();
+  while (micros() - start < PRINT_MS * 1000UL) {
+    bytes += SerialUSB.print("sample ");
+    bytes += SerialUSB.print(n++);
+    bytes += SerialUSB.print(" value ");
+    bytes += SerialUSB.println(n * 7 % 1024);
+  }
+  SerialUSB.flush();
+  report("print", bytes, micros() - start);
+}
+
+static void hostToDevice() {
+  uint32_t received = 0;
+  uint32_t start = 0;
+  uint32_t end = 0;
+  uint32_t last = millis();
+  // Stops at TOTAL_SIZE, or when nothing comes for a second
+  while (received < TOTAL_SIZE && millis() - last < 1000) {
+    int n = SerialUSB.read(buffer, sizeof(buffer));
+    if (n > 0) {
+      if (received == 0) {
+        start = micros();
+      }
+      received += n;
+      end = micros();
+      last = millis();
+    }
+  }
+  report("read", received, end - start);
+}
+
+void setup() {
+  SerialUSB.begin(115200);
+  while (!SerialUSB);
+}
+
+void loop() {
+  int c = SerialUSB.read();
+  if (c == 't') {
+    deviceToHost();
+  } else if (c == 'r') {
+    hostToDevice();
+  }
+}
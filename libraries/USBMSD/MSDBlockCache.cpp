@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2018-2019, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "MSDBlockCache.h"
+
+using namespace arduino;
+
+// disk_read() and disk_write() take an 8 bit block count
+#define MAX_RUN_BLOCKS  255
+
+MSDBlockCache::MSDBlockCache()
+    : _buf(NULL), _block_size(0), _block_count(0), _capacity(0),
+      _start(0), _count(0), _dirty(false)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+MSDBlockCache::~MSDBlockCache()
+{
+    deinit();
+}
+
+bool MSDBlockCache::init(read_t read, write_t write, uint32_t block_size, uint64_t block_count, uint32_t size)
+{
+    deinit();
+
+    _read = read;
+    _write = write;
+    _block_size = block_size;
+    _block_count = block_count;
+
+    uint32_t capacity = (block_size != 0) ? size / block_size : 0;
+    if (capacity > MAX_RUN_BLOCKS) {
+        capacity = MAX_RUN_BLOCKS;
+    }
+    // A single block would only add a copy
+    if (capacity >= 2) {
+        _buf = (uint8_t *)malloc(capacity * block_size);
+        if (_buf != NULL) {
+            _capacity = capacity;
+        }
+    }
+    return _capacity != 0;
+}
+
+void MSDBlockCache::deinit()
+{
+    free(_buf);
+    _buf = NULL;
+    _capacity = 0;
+    _count = 0;
+    _dirty = false;
+}
+
+int MSDBlockCache::write(const uint8_t *data, uint64_t block)
+{
+    if (_capacity == 0) {
+        _stats.disk_writes++;
+        _stats.blocks_written++;
+        return _write(data, block, 1);
+    }
+
+    int ret = 0;
+    if (_dirty && block >= _start && block < _start + _count) {
+        // Written again before it reached the disk, e.g. the FAT
+        _stats.write_hits++;
+    } else if (_dirty && block == _start + _count && _count < _capacity) {
+        _count++;
+    } else {
+        // Starts a new run, what was read ahead is dropped
+        ret = flush();
+        _start = block;
+        _count = 1;
+        _dirty = true;
+    }
+
+    memcpy(&_buf[(block - _start) * _block_size], data, _block_size);
+    return ret;
+}
+
+const uint8_t *MSDBlockCache::read(uint64_t block, uint32_t ahead, uint8_t *scratch)
+{
+    if (_count != 0 && block >= _start && block < _start + _count) {
+        _stats.read_hits++;
+        return &_buf[(block - _start) * _block_size];
+    }
+
+    if (_capacity == 0 || _dirty || ahead <= 1) {
+        // Dirty blocks stay where they are until they are flushed
+        _stats.disk_reads++;
+        _stats.blocks_read++;
+        return (_read(scratch, block, 1) == 0) ? scratch : NULL;
+    }
+
+    uint32_t n = (ahead < _capacity) ? ahead : _capacity;
+    if (block + n > _block_count) {
+        n = _block_count - block;
+    }
+    _stats.disk_reads++;
+    _stats.blocks_read += n;
+    _count = 0;
+    if (_read(_buf, block, n) != 0) {
+        return NULL;
+    }
+    _start = block;
+    _count = n;
+    return _buf;
+}
+
+int MSDBlockCache::flush()
+{
+    if (!_dirty) {
+        return 0;
+    }
+
+    _stats.disk_writes++;
+    _stats.blocks_written += _count;
+    int ret = _write(_buf, _start, _count);
+    // The blocks stay in the cache for reads, unless the write failed
+    _dirty = false;
+    if (ret != 0) {
+        _count = 0;
+    }
+    return ret;
+}
+
+void MSDBlockCache::stats(Stats *stats, bool reset)
+{
+    memcpy(stats, &_stats, sizeof(*stats));
+    if (reset) {
+        memset(&_stats, 0, sizeof(_stats));
+    }
+}
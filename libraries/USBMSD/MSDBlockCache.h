@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018-2019, Arm Limited and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MSD_BLOCK_CACHE_H
+#define MSD_BLOCK_CACHE_H
+
+#include <stdint.h>
+#include "platform/Callback.h"
+
+// RAM for the cache, at most 255 blocks are used
+#ifndef USBMSD_CACHE_SIZE
+#if defined(NRF52840_XXAA)
+#define USBMSD_CACHE_SIZE       (16 * 1024)
+#else
+#define USBMSD_CACHE_SIZE       (64 * 1024)
+#endif
+#endif
+
+namespace arduino {
+
+/**
+ * Read-ahead and write-back cache between the SCSI commands of USBMSD and
+ * its disk_read()/disk_write() hooks.
+ *
+ * The cache holds one run of consecutive blocks. The blocks are the erase
+ * sectors of the block device. Sequential writes collect in the run, and
+ * the run goes to the disk in one disk_write(), so one erase and one
+ * program. That happens when the run is full, when a write lands outside
+ * it, or on flush(). A multi block read fetches up to a run of blocks in
+ * one disk_read().
+ *
+ * Without the RAM for two blocks the cache passes everything through.
+ */
+class MSDBlockCache {
+public:
+    typedef mbed::Callback<int(uint8_t *, uint64_t, uint8_t)> read_t;
+    typedef mbed::Callback<int(const uint8_t *, uint64_t, uint8_t)> write_t;
+
+    struct Stats {
+        uint32_t disk_reads;        // disk_read() calls
+        uint32_t disk_writes;       // disk_write() calls
+        uint32_t blocks_read;       // Blocks read from the disk
+        uint32_t blocks_written;    // Blocks written to the disk
+        uint32_t read_hits;         // Blocks the host read from the cache
+        uint32_t write_hits;        // Blocks the host wrote again before they were flushed
+    };
+
+    MSDBlockCache();
+    ~MSDBlockCache();
+
+    /**
+     * Allocate the cache, dropping any previous one without flushing it
+     *
+     * @param read Reads blocks from the disk
+     * @param write Erases and programs blocks on the disk
+     * @param block_size Bytes per block
+     * @param block_count Blocks on the disk
+     * @param size Bytes of RAM for the cache
+     * @return true if the cache is in use, false if it only passes through
+     */
+    bool init(read_t read, write_t write, uint32_t block_size, uint64_t block_count,
+              uint32_t size = USBMSD_CACHE_SIZE);
+    void deinit();
+
+    /**
+     * Write a block, it may only reach the disk on a later call
+     *
+     * @return 0, or the error of a disk_write() this had to do
+     */
+    int write(const uint8_t *data, uint64_t block);
+
+    /**
+     * Read a block
+     *
+     * @param block First block of the read
+     * @param ahead Blocks the host is about to read from block on, including block
+     * @param scratch A block of RAM for data that does not go through the cache
+     * @return The data of the block, valid until the next call, or NULL on error
+     */
+    const uint8_t *read(uint64_t block, uint32_t ahead, uint8_t *scratch);
+
+    /**
+     * Write the cached blocks to the disk
+     *
+     * @return 0 or the error of disk_write()
+     */
+    int flush();
+
+    bool dirty() const
+    {
+        return _dirty;
+    }
+
+    void stats(Stats *stats, bool reset = false);
+
+private:
+    read_t _read;
+    write_t _write;
+    uint8_t *_buf;
+    uint32_t _block_size;
+    uint64_t _block_count;
+    uint32_t _capacity;     // Blocks _buf holds, 0 passes through
+
+    // The run: _count blocks from _start, not on the disk yet if _dirty
+    uint64_t _start;
+    uint32_t _count;
+    bool _dirty;
+
+    Stats _stats;
+};
+
+}
+
+#endif
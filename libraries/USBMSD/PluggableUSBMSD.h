@@ -33,6 +33,7 @@
 #include "FATFileSystem.h"
 #include "Callback.h"
 #include "rtos/Thread.h"
+#include "MSDBlockCache.h"
 
 #if defined(MBED_CONF_TARGET_USB_SPEED) && (MBED_CONF_TARGET_USB_SPEED == USE_USB_OTG_HS)
 #define MSD_MAX_PACKET_SIZE    512
@@ -40,6 +41,11 @@
 #define MSD_MAX_PACKET_SIZE    64
 #endif
 
+// Cached writes go to the disk once the host has been idle this long (ms)
+#ifndef USBMSD_FLUSH_DELAY
+#define USBMSD_FLUSH_DELAY     500
+#endif
+
 namespace arduino {
 
 /**
@@ -147,6 +153,16 @@ public:
     */
     bool media_removed();
 
+    /**
+    * Write the blocks the host wrote, and that are still cached, to the disk
+    *
+    * They also go when the host syncs or ejects the disk, and after
+    * USBMSD_FLUSH_DELAY ms without transfers.
+    *
+    * @returns 0 if successful
+    */
+    int flush();
+
 protected:
 
     /*
@@ -253,6 +269,15 @@ private:
     // cache in RAM before writing in memory. Useful also to read a block.
     uint8_t *_page;
 
+    // Block of data memoryRead() and memoryVerify() are working on
+    const uint8_t *_read_ptr;
+
+    // Read-ahead and write-back cache in front of disk_read() and disk_write()
+    MSDBlockCache _cache;
+
+    // millis() of the last bulk transfer, for the idle flush
+    volatile uint32_t _last_activity;
+
     int _block_size;
     uint64_t _memory_size;
     uint64_t _block_count;
@@ -329,6 +354,7 @@ private:
     void memoryWrite(uint8_t *buf, uint16_t size);
     void msd_reset();
     void fail();
+    void startStopUnit(void);
 };
 }
 
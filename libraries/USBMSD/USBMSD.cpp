@@ -50,6 +50,7 @@ using namespace arduino;
 #define WRITE12                    0xAA
 #define MODE_SELECT10              0x55
 #define MODE_SENSE10               0x5A
+#define SYNCHRONIZE_CACHE10        0x35
 
 // MSC class specific requests
 #define MSC_REQUEST_RESET          0xFF
@@ -100,6 +101,8 @@ void USBMSD::init(EndpointResolver& resolver)
     memset((void *)&_cbw, 0, sizeof(CBW));
     memset((void *)&_csw, 0, sizeof(CSW));
     _page = NULL;
+    _read_ptr = NULL;
+    _last_activity = 0;
     connect();
 
     _t.start(mbed::callback(this, &USBMSD::process));
@@ -149,6 +152,9 @@ bool USBMSD::connect()
                 //_mutex_init.unlock();
                 return false;
             }
+            // Passes through if there isn't enough memory for it
+            _cache.init(mbed::callback(this, &USBMSD::disk_read), mbed::callback(this, &USBMSD::disk_write),
+                        _block_size, _block_count);
         }
     } else {
         //_mutex.unlock();
@@ -173,6 +179,11 @@ void USBMSD::disconnect()
     //USBDevice::disconnect();
     _initialized = false;
 
+    _mutex.lock();
+    _cache.flush();
+    _cache.deinit();
+    _mutex.unlock();
+
     //De-allocate MSD page size:
     free(_page);
     _page = NULL;
@@ -188,6 +199,15 @@ void USBMSD::process()
             _data_available.wait_any(0xFF, 10);
             _queue.dispatch();
             //yield();
+
+            // The host went quiet between two commands: write back what it wrote
+            if (_cache.dirty() && (millis() - _last_activity) > USBMSD_FLUSH_DELAY) {
+                _mutex.lock();
+                if (_stage == READ_CBW) {
+                    _cache.flush();
+                }
+                _mutex.unlock();
+            }
         }
     }
 }
@@ -201,6 +221,14 @@ bool USBMSD::media_removed()
     return _media_removed;
 }
 
+int USBMSD::flush()
+{
+    _mutex.lock();
+    int ret = _cache.flush();
+    _mutex.unlock();
+    return ret;
+}
+
 int USBMSD::disk_read(uint8_t *data, uint64_t block, uint8_t count)
 {
     // this operation must be executed in another thread
@@ -392,6 +420,7 @@ void USBMSD::_out()
 
     _bulk_out_size = read_finish(_bulk_out);
     _out_ready = true;
+    _last_activity = millis();
     _process();
 
     _mutex.unlock();
@@ -403,6 +432,7 @@ void USBMSD::_in()
 
     write_finish(_bulk_in);
     _in_ready = true;
+    _last_activity = millis();
     _process();
 
     _mutex.unlock();
@@ -561,14 +591,16 @@ void USBMSD::memoryWrite(uint8_t *buf, uint16_t size)
     }
 
     // we fill an array in RAM of 1 block before writing it in memory
-    for (int i = 0; i < size; i++) {
-        _page[_addr % _block_size + i] = buf[i];
-    }
+    memcpy(&_page[_addr % _block_size], buf, size);
 
-    // if the array is filled, write it in memory
+    // if the array is filled, hand it to the cache, consecutive blocks go
+    // to the disk together
     if (!((_addr + size) % _block_size)) {
         if (!(disk_status() & WRITE_PROTECT)) {
-            disk_write(_page, _addr / _block_size, 1);
+            if (_cache.write(_page, _addr / _block_size) != 0 && _stage == PROCESS_CBW) {
+                _stage = ERROR;
+                endpoint_stall(_bulk_out);
+            }
         }
     }
 
@@ -594,12 +626,16 @@ void USBMSD::memoryVerify(uint8_t *buf, uint16_t size)
 
     // beginning of a new block -> load a whole block in RAM
     if (!(_addr % _block_size)) {
-        disk_read(_page, _addr / _block_size, 1);
+        _read_ptr = _cache.read(_addr / _block_size, 1, _page);
+        if (_read_ptr == NULL) {
+            _read_ptr = _page;
+            _mem_ok = false;
+        }
     }
 
     // info are in RAM -> no need to re-read memory
     for (n = 0; n < size; n++) {
-        if (_page[_addr % _block_size + n] != buf[n]) {
+        if (_read_ptr[_addr % _block_size + n] != buf[n]) {
             _mem_ok = false;
             break;
         }
@@ -820,10 +856,17 @@ void USBMSD::CBWDecode(uint8_t *buf, uint16_t size)
                         }
                         break;
                     case MEDIA_REMOVAL:
-                        _csw.Status = CSW_PASSED;
+                        _csw.Status = (_cache.flush() == 0) ? CSW_PASSED : CSW_FAILED;
                         sendCSW();
                         _media_removed = true;
                         break;
+                    case SYNCHRONIZE_CACHE10:
+                        _csw.Status = (_cache.flush() == 0) ? CSW_PASSED : CSW_FAILED;
+                        sendCSW();
+                        break;
+                    case START_STOP_UNIT:
+                        startStopUnit();
+                        break;
                     case MODE_SENSE10:
                         modeSense10();
                         break;
@@ -836,6 +879,22 @@ void USBMSD::CBWDecode(uint8_t *buf, uint16_t size)
     }
 }
 
+void USBMSD::startStopUnit(void)
+{
+    // Stopping or ejecting the medium writes the cache back first
+    bool start = _cbw.CB[4] & 0x01;
+    bool eject = _cbw.CB[4] & 0x02;
+
+    _csw.Status = CSW_PASSED;
+    if (!start && _cache.flush() != 0) {
+        _csw.Status = CSW_FAILED;
+    }
+    if (!start && eject) {
+        _media_removed = true;
+    }
+    sendCSW();
+}
+
 void USBMSD::testUnitReady(void)
 {
 
@@ -863,13 +922,17 @@ void USBMSD::memoryRead(void)
         _stage = ERROR;
     }
 
-    // we read an entire block
+    // we read an entire block, the rest of the command is read ahead with it
     if (!(_addr % _block_size)) {
-        disk_read(_page, _addr / _block_size, 1);
+        _read_ptr = _cache.read(_addr / _block_size, _length / _block_size, _page);
+        if (_read_ptr == NULL) {
+            _read_ptr = _page;
+            _stage = ERROR;
+        }
     }
 
     // write data which are in RAM
-    _write_next(&_page[_addr % _block_size], MAX_PACKET);
+    _write_next((uint8_t *)&_read_ptr[_addr % _block_size], MAX_PACKET);
 
     _addr += n;
     _length -= n;
@@ -0,0 +1,64 @@
+#include "WiFi.h"
+#include "utility/http_request.h"
+#include "arduino_secrets.h"
+
+/**
+ * Polls a URL with HttpRequest in streaming mode. The responses are received
+ * in the buffers below, only the headers asked for are kept, and the body is
+ * passed to on_body() as it arrives. Nothing is allocated per request, and
+ * the requests share one connection while the server keeps it open.
+ **/
+
+char ssid[] = SECRET_SSID;
+char pass[] = SECRET_PASS;
+
+#define URL         "http://example.com/"
+#define REQUESTS    20
+
+uint8_t buffer[2048];
+char headers[128];
+uint32_t body_bytes;
+
+static void on_body(const char* at, uint32_t length) {
+  body_bytes += length;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  while (WiFi.begin(ssid, pass) != WL_CONNECTED) {
+    Serial.println("Connecting...");
+    delay(1000);
+  }
+
+  HttpRequest request(WiFi.getNetwork(), HTTP_GET, URL, on_body);
+  request.set_stream_buffers(buffer, sizeof(buffer), headers, sizeof(headers));
+  request.keep_header("Content-Type");
+  request.keep_header("ETag");
+
+  uint32_t start = millis();
+  for (int i = 0; i < REQUESTS; i++) {
+    body_bytes = 0;
+    HttpResponse* response = request.send();
+    if (response == NULL) {
+      Serial.print("error ");
+      Serial.println(request.get_error());
+      return;
+    }
+    const char* type = response->get_header("Content-Type");
+    const char* etag = response->get_header("ETag");
+    Serial.print(response->get_status_code());
+    Serial.print(" ");
+    Serial.print(type ? type : "-");
+    Serial.print(" ETag ");
+    Serial.print(etag ? etag : "-");
+    Serial.print(" body ");
+    Serial.println(body_bytes);
+  }
+  Serial.print("ms per request: ");
+  Serial.println((float)(millis() - start) / REQUESTS);
+}
+
+void loop() {
+}
@@ -0,0 +1,111 @@
+#include "WiFi.h"
+#include "arduino_secrets.h"
+
+/**
+ * TCP throughput to and from a computer on the same network.
+ * On the computer run both of:
+ *   nc -lk 5001 > /dev/null
+ *   nc -lk 5002 < /dev/zero
+ * and set HOST to its address.
+ *
+ * The "lines" test writes the way print() of formatted text does, a few
+ * bytes at a time; the client collects them into full segments. The "bulk"
+ * test writes 4KB at a time, the "read" test reads 4KB at a time straight
+ * from the socket.
+ **/
+
+char ssid[] = SECRET_SSID;
+char pass[] = SECRET_PASS;
+
+IPAddress HOST(192, 168, 1, 100);
+
+#define TEST_MS     5000
+
+uint8_t buffer[4096];
+
+static void report(const char* name, uint32_t bytes, uint32_t ms) {
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(bytes);
+  Serial.print(" bytes, ");
+  Serial.print((float)bytes / ms / 1000);
+  Serial.println(" MB/s");
+}
+
+static void lines() {
+  WiFiClient client;
+  if (!client.connect(HOST, 5001)) {
+    Serial.println("lines: cannot connect to port 5001");
+    return;
+  }
+  uint32_t bytes = 0;
+  uint32_t n = 0;
+  uint32_t start = millis();
+  while (millis() - start < TEST_MS) {
+    bytes += client.print("sample ");
+    bytes += client.print(n++);
+    bytes += client.print(" value ");
+    bytes += client.println(analogRead(A0));
+  }
+  client.flush();
+  report("lines", bytes, millis() - start);
+  client.stop();
+}
+
+static void bulk() {
+  WiFiClient client;
+  if (!client.connect(HOST, 5001)) {
+    Serial.println("bulk: cannot connect to port 5001");
+    return;
+  }
+  memset(buffer, 'x', sizeof(buffer));
+  uint32_t bytes = 0;
+  uint32_t start = millis();
+  while (millis() - start < TEST_MS) {
+    size_t n = client.write(buffer, sizeof(buffer));
+    if (n == 0) {
+      break;
+    }
+    bytes += n;
+  }
+  report("bulk", bytes, millis() - start);
+  client.stop();
+}
+
+static void receive() {
+  WiFiClient client;
+  if (!client.connect(HOST, 5002)) {
+    Serial.println("read: cannot connect to port 5002");
+    return;
+  }
+  uint32_t bytes = 0;
+  uint32_t start = millis();
+  while (millis() - start < TEST_MS && client.connected()) {
+    int n = client.read(buffer, sizeof(buffer));
+    if (n > 0) {
+      bytes += n;
+    }
+  }
+  report("read", bytes, millis() - start);
+  client.stop();
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial);
+
+  Serial.print("Connecting to ");
+  Serial.println(ssid);
+  while (WiFi.begin(ssid, pass) != WL_CONNECTED) {
+    delay(5000);
+  }
+  Serial.print("IP address: ");
+  Serial.println(WiFi.localIP());
+
+  lines();
+  bulk();
+  receive();
+}
+
+void loop() {
+}
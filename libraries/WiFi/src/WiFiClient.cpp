@@ -1,4 +1,6 @@
 #include "WiFiClient.h"
+#include "events/mbed_shared_queues.h"
+#include <stdlib.h>
 
 extern WiFiClass WiFi;
 
@@ -10,7 +12,41 @@ extern WiFiClass WiFi;
 #define SOCKET_TIMEOUT 1000
 #endif
 
-arduino::WiFiClient::WiFiClient() {
+// The transmit buffers of all the clients, and the list of the ones the
+// flush timer has to send, are only touched under tx_mutex. A send from a
+// buffer runs without it: _tx_busy keeps the buffer and the socket in use
+// meanwhile, and tx_done tells when it is over. No server lock is taken
+// with tx_mutex held.
+static rtos::Mutex tx_mutex;
+static rtos::ConditionVariable tx_done(tx_mutex);
+static arduino::WiFiClient* tx_pending = NULL;
+static int tx_event = 0;
+
+arduino::WiFiClient::WiFiClient() : sock(NULL), _rx_pos(0), _rx_size(0), _status(WL_IDLE_STATUS), _server(NULL), _generation(0),
+	_tx_buffer(NULL), _tx_size(0), _tx_sent(0), _tx_next(NULL), _tx_queued(false), _tx_started(false), _tx_busy(false) {
+}
+
+arduino::WiFiClient::WiFiClient(const WiFiClient& other) : sock(NULL), _rx_pos(0), _rx_size(0), _server(NULL), _generation(0),
+	_tx_buffer(NULL), _tx_size(0), _tx_sent(0), _tx_next(NULL), _tx_queued(false), _tx_started(false), _tx_busy(false) {
+	*this = other;
+}
+
+arduino::WiFiClient& arduino::WiFiClient::operator=(const WiFiClient& other) {
+	if (this != &other) {
+		// Written data goes out first, a copy starts with nothing to send
+		const_cast<WiFiClient&>(other).flush();
+		flush();
+		arduino::Client::operator=(other);
+		sock = other.sock;
+		_rx_size = other._rx_size - other._rx_pos;
+		memcpy(_rx_buffer, &other._rx_buffer[other._rx_pos], _rx_size);
+		_rx_pos = 0;
+		_status = other._status;
+		beforeConnect = other.beforeConnect;
+		_server = other._server;
+		_generation = other._generation;
+	}
+	return *this;
 }
 
 uint8_t arduino::WiFiClient::status() {
@@ -18,16 +54,37 @@ uint8_t arduino::WiFiClient::status() {
 }
 
 void arduino::WiFiClient::getStatus() {
-    uint8_t data[256];
-    int ret = sock->recv(data, rxBuffer.availableForStore());
-    for (int i = 0; i < ret; i++) {
-      rxBuffer.store_char(data[i]);
+    if (!attached()) {
+        return;
     }
-    if (ret < 0 && ret != NSAPI_ERROR_WOULD_BLOCK) {
+    // Only called once everything received so far was read
+    _rx_pos = 0;
+    _rx_size = 0;
+    int ret = sock->recv(_rx_buffer, sizeof(_rx_buffer));
+    if (ret > 0) {
+        _rx_size = ret;
+        if (_server != NULL) {
+            _server->touch(sock, _generation);
+        }
+    }
+    // Nothing where there was room for something means the peer closed
+    if ((ret < 0 && ret != NSAPI_ERROR_WOULD_BLOCK) || ret == 0) {
         _status = WL_CONNECTION_LOST;
     }
 }
 
+// A client from WiFiServer::available() loses its socket when the server closes it
+bool arduino::WiFiClient::attached() {
+	if (_server != NULL && sock != NULL && !_server->holds(sock, _generation)) {
+		// The flush timer reads it under tx_mutex
+		tx_mutex.lock();
+		sock = NULL;
+		tx_mutex.unlock();
+		_status = WL_CONNECTION_LOST;
+	}
+	return sock != NULL;
+}
+
 int arduino::WiFiClient::connect(SocketAddress socketAddress) {
 	if (sock == NULL) {
 		sock = new TCPSocket();		
@@ -39,7 +96,12 @@ int arduino::WiFiClient::connect(SocketAddress socketAddress) {
 	//sock->set_blocking(false);
 	sock->set_timeout(SOCKET_TIMEOUT);		
 	nsapi_error_t returnCode = static_cast<TCPSocket*>(sock)->connect(socketAddress);
-	return returnCode == NSAPI_ERROR_OK ? 1 : 0;
+	if (returnCode != NSAPI_ERROR_OK) {
+		return 0;
+	}
+	// From here on it does not block, send() waits for room itself
+	sock->set_blocking(false);
+	return 1;
 }
 
 int arduino::WiFiClient::connect(IPAddress ip, uint16_t port) {	
@@ -65,7 +127,11 @@ int arduino::WiFiClient::connectSSL(SocketAddress socketAddress){
 	}
 	sock->set_timeout(SOCKET_TIMEOUT);	
 	nsapi_error_t returnCode = static_cast<TLSSocket*>(sock)->connect(socketAddress);
-	return returnCode == NSAPI_ERROR_OK ? 1 : 0;
+	if (returnCode != NSAPI_ERROR_OK) {
+		return 0;
+	}
+	sock->set_blocking(false);
+	return 1;
 }
 
 int arduino::WiFiClient::connectSSL(IPAddress ip, uint16_t port) {
@@ -80,18 +146,227 @@ int arduino::WiFiClient::connectSSL(const char *host, uint16_t port) {
 }
 
 size_t arduino::WiFiClient::write(uint8_t c) {
-	sock->send(&c, 1);
+	return write(&c, 1);
 }
 
+// Collects small writes into one segment, it goes out when the buffer is
+// full, on flush(), as far as the socket takes it right away before reading,
+// or WIFI_CLIENT_FLUSH_DELAY ms later
 size_t arduino::WiFiClient::write(const uint8_t *buf, size_t size) {
-	sock->send(buf, size);
+	if (!attached()) {
+		return 0;
+	}
+	if (_server != NULL) {
+		_server->touch(sock, _generation);
+	}
+
+	tx_mutex.lock();
+	waitTx();
+	// Nothing is added to data the flush timer has started on, a TLS socket
+	// has to be given the same data again
+	if ((_tx_started || _tx_size + size > WIFI_CLIENT_TX_BUFFER_SIZE) && !sendBuffered()) {
+		tx_mutex.unlock();
+		return 0;
+	}
+	if (_tx_buffer == NULL && size < WIFI_CLIENT_TX_BUFFER_SIZE) {
+		_tx_buffer = (uint8_t*)malloc(WIFI_CLIENT_TX_BUFFER_SIZE);
+	}
+	if (size >= WIFI_CLIENT_TX_BUFFER_SIZE || _tx_buffer == NULL) {
+		// Nothing to gain from copying it, or nowhere to copy it to
+		Socket* s = sock;
+		_tx_busy = true;
+		tx_mutex.unlock();
+		nsapi_size_or_error_t ret = send(s, buf, size, SOCKET_TIMEOUT);
+		tx_mutex.lock();
+		_tx_busy = false;
+		tx_done.notify_all();
+		tx_mutex.unlock();
+		return ret > 0 ? ret : 0;
+	}
+	memcpy(&_tx_buffer[_tx_size], buf, size);
+	_tx_size += size;
+	if (!_tx_queued) {
+		_tx_next = tx_pending;
+		tx_pending = this;
+		_tx_queued = true;
+		scheduleFlush();
+	}
+	tx_mutex.unlock();
+	return size;
+}
+
+// Waits for a send from the buffer to be over, with tx_mutex held
+void arduino::WiFiClient::waitTx() {
+	while (_tx_busy) {
+		tx_done.wait();
+	}
+}
+
+// Takes the client off the flush timer's list, with tx_mutex held
+void arduino::WiFiClient::unqueue() {
+	if (_tx_queued) {
+		WiFiClient** p = &tx_pending;
+		while (*p != this) {
+			p = &(*p)->_tx_next;
+		}
+		*p = _tx_next;
+		_tx_queued = false;
+	}
+}
+
+// Sends what is left in the buffer, waiting up to SOCKET_TIMEOUT for room.
+// tx_mutex is held on entry and on return, but not while sending.
+bool arduino::WiFiClient::sendBuffered() {
+	waitTx();
+	size_t size = _tx_size - _tx_sent;
+	size_t sent = 0;
+	if (size > 0) {
+		Socket* s = sock;
+		_tx_busy = true;
+		tx_mutex.unlock();
+		nsapi_size_or_error_t ret = send(s, &_tx_buffer[_tx_sent], size, SOCKET_TIMEOUT);
+		tx_mutex.lock();
+		sent = ret > 0 ? ret : 0;
+		_tx_busy = false;
+		tx_done.notify_all();
+	}
+	// Only once the send is over can the buffer take new data. What could
+	// not be sent is dropped.
+	unqueue();
+	_tx_size = 0;
+	_tx_sent = 0;
+	_tx_started = false;
+	return sent == size;
+}
+
+// Gives the socket what it takes of the buffer right away, with tx_mutex held
+// and _tx_busy set. Returns false once nothing is left to send.
+bool arduino::WiFiClient::trySend() {
+	Socket* s = sock;
+	size_t size = _tx_size - _tx_sent;
+	_tx_started = true;
+	tx_mutex.unlock();
+	nsapi_size_or_error_t ret = send(s, &_tx_buffer[_tx_sent], size, 0);
+	tx_mutex.lock();
+	if (ret > 0) {
+		_tx_sent += ret;
+	}
+	if (_tx_sent == _tx_size || (ret < 0 && ret != NSAPI_ERROR_WOULD_BLOCK)) {
+		// All sent, or the connection is gone
+		_tx_size = 0;
+		_tx_sent = 0;
+		_tx_started = false;
+		return false;
+	}
+	return true;
+}
+
+// Before reading: the peer may be waiting for what was written before it
+// answers. Only what the socket takes right away is sent, the flush timer
+// keeps going with the rest.
+void arduino::WiFiClient::kickTx() {
+	tx_mutex.lock();
+	if (_tx_size > _tx_sent && !_tx_busy) {
+		_tx_busy = true;
+		if (trySend()) {
+			scheduleFlush();
+		} else {
+			unqueue();
+		}
+		_tx_busy = false;
+		tx_done.notify_all();
+	}
+	tx_mutex.unlock();
+}
+
+// Hands the buffer back once its data is out, the next write() allocates it again
+void arduino::WiFiClient::freeTx() {
+	tx_mutex.lock();
+	waitTx();
+	unqueue();
+	_tx_size = 0;
+	_tx_sent = 0;
+	_tx_started = false;
+	free(_tx_buffer);
+	_tx_buffer = NULL;
+	tx_mutex.unlock();
+}
+
+// Arms the flush timer unless it is already, with tx_mutex held
+void arduino::WiFiClient::scheduleFlush() {
+	if (tx_event == 0) {
+		tx_event = mbed_event_queue()->call_in(std::chrono::milliseconds(WIFI_CLIENT_FLUSH_DELAY), &WiFiClient::flushPending);
+	}
+}
+
+// Runs on the shared event queue, which must not be kept waiting: each
+// client gets what its socket takes right away, the rest waits for the next
+// round. A client that is being sent already is left to its sender.
+void arduino::WiFiClient::flushPending() {
+	tx_mutex.lock();
+	tx_event = 0;
+	WiFiClient* round = NULL;
+	WiFiClient** p = &tx_pending;
+	while (*p != NULL) {
+		WiFiClient* client = *p;
+		if (client->_tx_busy) {
+			p = &client->_tx_next;
+			continue;
+		}
+		*p = client->_tx_next;
+		client->_tx_busy = true;
+		client->_tx_next = round;
+		round = client;
+	}
+	while (round != NULL) {
+		WiFiClient* client = round;
+		round = client->_tx_next;
+		if (client->trySend()) {
+			client->_tx_next = tx_pending;
+			tx_pending = client;
+			scheduleFlush();
+		} else {
+			client->_tx_queued = false;
+		}
+		client->_tx_busy = false;
+		tx_done.notify_all();
+	}
+	tx_mutex.unlock();
+}
+
+// Sends without tx_mutex, waiting up to timeout ms for s to take it all.
+// Returns how much was sent, or the error if nothing was.
+nsapi_size_or_error_t arduino::WiFiClient::send(Socket* s, const uint8_t *buf, size_t size, unsigned long timeout) {
+	// A socket from WiFiServer is not closed while this sends on it
+	if (s == NULL || (_server != NULL && !_server->pin(s, _generation))) {
+		return NSAPI_ERROR_NO_SOCKET;
+	}
+	// The sockets do not block, wait for room as a blocking one would
+	size_t written = 0;
+	nsapi_size_or_error_t ret = 0;
+	unsigned long start = millis();
+	while (written < size) {
+		ret = s->send(buf + written, size - written);
+		if (ret > 0) {
+			written += ret;
+		} else if (ret == NSAPI_ERROR_WOULD_BLOCK && millis() - start < timeout) {
+			delay(1);
+		} else {
+			break;
+		}
+	}
+	if (_server != NULL) {
+		_server->unpin(s, _generation);
+	}
+	return (written > 0 || ret >= 0) ? (nsapi_size_or_error_t)written : ret;
 }
 
 int arduino::WiFiClient::available() {
-	if (rxBuffer.available() == 0) {
+	kickTx();
+	if (_rx_pos == _rx_size) {
 		getStatus();
 	}
-    return rxBuffer.available();
+    return _rx_size - _rx_pos;
 }
 
 int arduino::WiFiClient::read() {
@@ -99,44 +374,77 @@ int arduino::WiFiClient::read() {
     	return -1;
 	}
 
-	return rxBuffer.read_char();
+	return _rx_buffer[_rx_pos++];
 }
 
 int arduino::WiFiClient::read(uint8_t *data, size_t len) {
-	int avail = available();
-
-	if (!avail) {
-		return -1;
+	kickTx();
+	if (_rx_pos == _rx_size) {
+		// Straight from the socket into the caller's buffer
+		if (!attached() || len == 0) {
+			return -1;
+		}
+		int ret = sock->recv(data, len);
+		if ((ret < 0 && ret != NSAPI_ERROR_WOULD_BLOCK) || ret == 0) {
+			_status = WL_CONNECTION_LOST;
+		} else if (ret > 0 && _server != NULL) {
+			_server->touch(sock, _generation);
+		}
+		return ret > 0 ? ret : -1;
 	}
 
-	if ((int)len > avail) {
+	size_t avail = _rx_size - _rx_pos;
+
+	if (len > avail) {
 		len = avail;
 	}
 
-	for (size_t i = 0; i < len; i++) {
-		data[i] = rxBuffer.read_char();
-	}
+	memcpy(data, &_rx_buffer[_rx_pos], len);
+	_rx_pos += len;
 
 	return len;
 }
 
 int arduino::WiFiClient::peek() {
-	return rxBuffer.peek();
+	return (_rx_pos < _rx_size) ? _rx_buffer[_rx_pos] : -1;
 }
 
 void arduino::WiFiClient::flush() {
+	flushTx();
+}
 
+bool arduino::WiFiClient::flushTx() {
+	// Also waits for a send the flush timer has going, the buffer and the
+	// socket are in use until it is over
+	tx_mutex.lock();
+	bool ret = sendBuffered();
+	tx_mutex.unlock();
+	return ret;
 }
 
 void arduino::WiFiClient::stop() {
-	if (sock != NULL) {
+	flush();
+	freeTx();
+	if (_server != NULL) {
+		// The server closes it and takes the next connection in its place
+		if (sock != NULL) {
+			_server->release(sock, _generation);
+		}
+	} else if (sock != NULL) {
 		sock->close();
-		sock = NULL;
 	}
+	sock = NULL;
+	_status = WL_IDLE_STATUS;
+	_rx_pos = 0;
+	_rx_size = 0;
 }
 
 uint8_t arduino::WiFiClient::connected() {
-	return _status != WL_CONNECTION_LOST;
+	// Unread data keeps a closed connection readable
+	if (_rx_pos < _rx_size) {
+		return 1;
+	}
+	return attached() && _status != WL_CONNECTION_LOST;
 }
 
 IPAddress arduino::WiFiClient::remoteIP() {
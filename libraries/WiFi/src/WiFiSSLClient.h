@@ -38,6 +38,7 @@ public:
     return connectSSL(host, port);
   }
   void stop() {
+    flush();
     if (sock != NULL) {
       sock->close();
       delete ((TLSSocket*)sock);
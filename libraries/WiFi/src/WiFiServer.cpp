@@ -1,5 +1,7 @@
 #include "WiFiServer.h"
 #include "WiFiClient.h"
+#include "events/mbed_shared_queues.h"
+#include "platform/mbed_atomic.h"
 
 extern WiFiClass WiFi;
 
@@ -9,6 +11,14 @@ extern WiFiClass WiFi;
 
 arduino::WiFiServer::WiFiServer(uint16_t port) {
 	_port = port;
+	sock = NULL;
+	_clients = NULL;
+	_next = 0;
+	_idle_timeout = 0;
+	_accept_pending = false;
+	memset(_pins, 0, sizeof(_pins));
+	memset(_closing, 0, sizeof(_closing));
+	memset(_generations, 0, sizeof(_generations));
 }
 
 uint8_t arduino::WiFiServer::status() {
@@ -20,25 +30,203 @@ void arduino::WiFiServer::begin() {
 		sock = new TCPSocket();
 		((TCPSocket*)sock)->open(WiFi.getNetwork());
 	}
+	if (_clients == NULL) {
+		_clients = new WiFiClient[WIFI_SERVER_MAX_CLIENTS];
+	}
 	sock->bind(_port);
 	sock->listen(5);
+
+	// Connections are accepted as they come, available() never waits
+	sock->set_blocking(false);
+	// The socket callback can only post to the shared queue once it exists
+	mbed_event_queue();
+	sock->sigio(mbed::callback(this, &WiFiServer::onSocketEvent));
+	onSocketEvent();
+}
+
+void arduino::WiFiServer::setIdleTimeout(uint32_t ms) {
+	_idle_timeout = ms;
+}
+
+// Called by the network stack, which must not be kept waiting
+void arduino::WiFiServer::onSocketEvent() {
+	if (!core_util_atomic_exchange_bool(&_accept_pending, true)) {
+		if (mbed_event_queue()->call(this, &WiFiServer::acceptClients) == 0) {
+			_accept_pending = false;
+		}
+	}
+}
+
+// Runs on the shared event queue, fills the free slots from the backlog
+void arduino::WiFiServer::acceptClients() {
+	core_util_atomic_store_bool(&_accept_pending, false);
+
+	_mutex.lock();
+	for (uint32_t i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
+		WiFiClient* client = &_clients[i];
+		if (client->sock != NULL) {
+			continue;
+		}
+		nsapi_error_t error;
+		TCPSocket* clientSocket = sock->accept(&error);
+		if (clientSocket == NULL) {
+			break;
+		}
+		clientSocket->set_blocking(false);
+		client->setSocket(clientSocket);
+		_generations[i]++;
+		_last_activity[i] = millis();
+	}
+	_mutex.unlock();
+}
+
+void arduino::WiFiServer::closeClient(uint32_t index) {
+	if (_pins[index] > 0) {
+		// A client from available() is sending on it, the last unpin() closes it
+		_closing[index] = true;
+		return;
+	}
+	_closing[index] = false;
+	_clients[index].stop();
+	// Copies from available() no longer match the slot, even once the socket address is reused
+	_generations[index]++;
+	// A connection waiting in the backlog can have the slot
+	onSocketEvent();
+}
+
+// Slot of the connection a client from available() was copied from, -1 if it was closed since
+int arduino::WiFiServer::slot(Socket* s, uint32_t generation) {
+	for (uint32_t i = 0; i < WIFI_SERVER_MAX_CLIENTS && _clients != NULL; i++) {
+		if (_clients[i].sock == s && _generations[i] == generation) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool arduino::WiFiServer::holds(Socket* s, uint32_t generation) {
+	_mutex.lock();
+	int i = slot(s, generation);
+	bool found = i >= 0 && !_closing[i];
+	_mutex.unlock();
+	return found;
+}
+
+// A client from available() sends on s, it stays open until unpin()
+bool arduino::WiFiServer::pin(Socket* s, uint32_t generation) {
+	_mutex.lock();
+	int i = slot(s, generation);
+	bool found = i >= 0 && !_closing[i];
+	if (found) {
+		_pins[i]++;
+	}
+	_mutex.unlock();
+	return found;
+}
+
+void arduino::WiFiServer::unpin(Socket* s, uint32_t generation) {
+	_mutex.lock();
+	int i = slot(s, generation);
+	if (i >= 0 && --_pins[i] == 0 && _closing[i]) {
+		closeClient(i);
+	}
+	_mutex.unlock();
+}
+
+// A client from available() read or wrote something
+void arduino::WiFiServer::touch(Socket* s, uint32_t generation) {
+	_mutex.lock();
+	int i = slot(s, generation);
+	if (i >= 0) {
+		_last_activity[i] = millis();
+	}
+	_mutex.unlock();
+}
+
+void arduino::WiFiServer::release(Socket* s, uint32_t generation) {
+	_mutex.lock();
+	int i = slot(s, generation);
+	if (i >= 0) {
+		closeClient(i);
+	}
+	_mutex.unlock();
 }
 
 size_t arduino::WiFiServer::write(uint8_t c) {
-	sock->send(&c, 1);
+	return write(&c, 1);
 }
 
 size_t arduino::WiFiServer::write(const uint8_t *buf, size_t size) {
-	sock->send(buf, size);
+	size_t written = 0;
+	if (_clients == NULL) {
+		return 0;
+	}
+
+	uint32_t start = millis();
+	for (uint32_t i = 0; i < WIFI_SERVER_MAX_CLIENTS; i++) {
+		WiFiClient* client = &_clients[i];
+		// Only the sketch closes slots, an open one stays open over the write.
+		// The lock is not held while sending, that can take a while.
+		_mutex.lock();
+		bool open = client->sock != NULL && !_closing[i];
+		_mutex.unlock();
+		if (!open) {
+			continue;
+		}
+		// One slow client does not hold up the others for long: the ones
+		// reached after the timeout only get what they can take right away
+		uint32_t now = millis();
+		uint32_t timeout = (now - start < WIFI_SERVER_WRITE_TIMEOUT) ? WIFI_SERVER_WRITE_TIMEOUT - (now - start) : 0;
+		if (client->send(client->sock, buf, size, timeout) != (nsapi_size_or_error_t)size) {
+			// Gone, or too slow to keep up with the others
+			_mutex.lock();
+			closeClient(i);
+			_mutex.unlock();
+			continue;
+		}
+		_last_activity[i] = now;
+		written += size;
+	}
+	return written;
 }
 
 arduino::WiFiClient arduino::WiFiServer::available(uint8_t* status) {
 	WiFiClient client;
-	nsapi_error_t error;
-	TCPSocket* clientSocket = sock->accept(&error);
-	if(status != nullptr) {
-		*status = error == NSAPI_ERROR_OK ? 1 : 0;
+	if (_clients == NULL) {
+		if (status != nullptr) {
+			*status = 0;
+		}
+		return client;
+	}
+
+	_mutex.lock();
+	uint32_t now = millis();
+	for (uint32_t n = 0; n < WIFI_SERVER_MAX_CLIENTS; n++) {
+		uint32_t i = (_next + n) % WIFI_SERVER_MAX_CLIENTS;
+		WiFiClient* c = &_clients[i];
+		if (c->sock == NULL || _closing[i]) {
+			continue;
+		}
+		if (c->available() > 0) {
+			// The returned client takes what was read so far
+			client = *c;
+			client._server = this;
+			client._generation = _generations[i];
+			c->_rx_pos = 0;
+			c->_rx_size = 0;
+			_last_activity[i] = now;
+			// The others go first next time
+			_next = i + 1;
+			break;
+		}
+		if (!c->connected() || (_idle_timeout != 0 && now - _last_activity[i] >= _idle_timeout)) {
+			closeClient(i);
+		}
+	}
+	_mutex.unlock();
+
+	if (status != nullptr) {
+		*status = client ? 1 : 0;
 	}
-	client.setSocket(clientSocket);
 	return client;
 }
@@ -24,6 +24,16 @@
 #include "TLSSocket.h"
 #include "TCPSocket.h"
 
+// Connections served at the same time, further ones wait in the listen backlog
+#ifndef WIFI_SERVER_MAX_CLIENTS
+#define WIFI_SERVER_MAX_CLIENTS     4
+#endif
+
+// Milliseconds write() waits, in all, for the clients to take the data
+#ifndef WIFI_SERVER_WRITE_TIMEOUT
+#define WIFI_SERVER_WRITE_TIMEOUT   100
+#endif
+
 namespace arduino {
 
 class WiFiClient;
@@ -32,15 +42,46 @@ class WiFiServer : public arduino::Server {
 private:
   uint16_t _port;
   TCPSocket* sock;
+
+  // Connections accepted in the background, a NULL socket is a free slot
+  WiFiClient* _clients;
+  uint32_t _last_activity[WIFI_SERVER_MAX_CLIENTS];
+  uint8_t _pins[WIFI_SERVER_MAX_CLIENTS];     // Sends in progress from clients available() returned
+  bool _closing[WIFI_SERVER_MAX_CLIENTS];     // Closed, once the sends are over
+  uint32_t _generations[WIFI_SERVER_MAX_CLIENTS];  // Bumped on every accept and close of the slot
+  uint32_t _next;           // Slot available() looks at first
+  uint32_t _idle_timeout;
+  rtos::Mutex _mutex;
+  volatile bool _accept_pending;
+
+  void onSocketEvent();
+  void acceptClients();
+  void closeClient(uint32_t index);
+  int slot(Socket* s, uint32_t generation);
+  bool holds(Socket* s, uint32_t generation);
+  void release(Socket* s, uint32_t generation);
+  void touch(Socket* s, uint32_t generation);
+  bool pin(Socket* s, uint32_t generation);
+  void unpin(Socket* s, uint32_t generation);
+
 public:
   WiFiServer(uint16_t);
+  // Return the next connected client with data to read, in turn, or a false client if none has any
+  // The client stays open when it goes out of scope, until it is stopped or the peer closes
   arduino::WiFiClient available(uint8_t* status = NULL);
   void begin();
+  // Write to all the connected clients, a client that cannot take the data
+  // within WIFI_SERVER_WRITE_TIMEOUT ms of the call is closed
   virtual size_t write(uint8_t);
   virtual size_t write(const uint8_t *buf, size_t size);
   uint8_t status();
+  // Close a client that exchanged no data, through the server or the WiFiClient
+  // available() returned, for ms milliseconds; 0 never does
+  void setIdleTimeout(uint32_t ms);
 
   using Print::write;
+
+  friend class WiFiClient;
 };
 
 }
@@ -94,6 +94,15 @@ public:
 protected:
 
     virtual nsapi_error_t connect_socket(char *host, uint16_t port) {
+        if (_socket_closed) {
+            // A socket can be opened again after it is closed, unlike a TLSSocket
+            nsapi_error_t ret = ((TCPSocket*)_socket)->open(_network);
+            if (ret != NSAPI_ERROR_OK) {
+                return ret;
+            }
+            _socket_closed = false;
+        }
+
         SocketAddress socketAddress = SocketAddress();
         socketAddress.set_port(port);
         _network->gethostbyname(host, &socketAddress);
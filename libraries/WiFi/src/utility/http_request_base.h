@@ -39,6 +39,11 @@
 #define HTTP_RECEIVE_BUFFER_SIZE 8 * 1024
 #endif
 
+// Headers a request in streaming mode can keep, see keep_header()
+#ifndef HTTP_STREAM_MAX_HEADERS
+#define HTTP_STREAM_MAX_HEADERS 8
+#endif
+
 class HttpRequest;
 class HttpsRequest;
 
@@ -51,7 +56,9 @@ class HttpRequestBase {
 
 public:
     HttpRequestBase(Socket *socket, mbed::Callback<void(const char *at, uint32_t length)> bodyCallback)
-        : _socket(socket), _body_callback(bodyCallback), _request_buffer(NULL), _request_buffer_ix(0)
+        : _socket(socket), _body_callback(bodyCallback), _request_buffer(NULL), _request_buffer_ix(0),
+          _recv_buffer(NULL), _recv_buffer_size(0), _header_arena(NULL), _header_arena_size(0),
+          _keep_headers_count(0), _connected(false), _socket_closed(false)
     {}
 
     /**
@@ -86,6 +93,7 @@ public:
      *         See get_error() for the error code.
      */
     HttpResponse* send(const void* body = NULL, nsapi_size_t body_size = 0) {
+        bool reused = _connected;
         nsapi_size_or_error_t ret = connect_socket();
 
         if (ret != NSAPI_ERROR_OK) {
@@ -96,18 +104,24 @@ public:
         _request_buffer_ix = 0;
 
         uint32_t request_size = 0;
-        char* request = _request_builder->build(body, body_size, request_size);
+        char* request = build_request(body, body_size, request_size);
 
         ret = send_buffer(request, request_size);
 
-        free(request);
+        free_request(request);
 
         if (ret < 0) {
             _error = ret;
+            close_stream_socket();
             return NULL;
         }
 
-        return create_http_response();
+        HttpResponse* response = create_http_response();
+        if (response == NULL && reused && _error == NSAPI_ERROR_CONNECTION_LOST && _response->get_status_code() == 0) {
+            // The server closed the kept connection before it saw the request, try a new one
+            return send(body, body_size);
+        }
+        return response;
     }
 
     /**
@@ -131,14 +145,15 @@ public:
         set_header("Transfer-Encoding", "chunked");
 
         uint32_t request_size = 0;
-        char* request = _request_builder->build(NULL, 0, request_size);
+        char* request = build_request(NULL, 0, request_size);
 
         // first... send this request headers without the body
         nsapi_size_or_error_t total_send_count = send_buffer(request, request_size);
 
         if (total_send_count < 0) {
-            free(request);
+            free_request(request);
             _error = total_send_count;
+            close_stream_socket();
             return NULL;
         }
 
@@ -153,24 +168,27 @@ public:
             char size_buff[10]; // if sending length of more than 8 digits, you have another problem on a microcontroller...
             int size_buff_size = sprintf(size_buff, "%X\r\n", static_cast<size_t>(size));
             if ((total_send_count = send_buffer(size_buff, static_cast<uint32_t>(size_buff_size))) < 0) {
-                free(request);
+                free_request(request);
                 _error = total_send_count;
+                close_stream_socket();
                 return NULL;
             }
 
             // now send the normal buffer... and then \r\n at the end
             total_send_count = send_buffer((char*)buffer, size);
             if (total_send_count < 0) {
-                free(request);
+                free_request(request);
                 _error = total_send_count;
+                close_stream_socket();
                 return NULL;
             }
 
             // and... \r\n
             const char* rn = "\r\n";
             if ((total_send_count = send_buffer((char*)rn, 2)) < 0) {
-                free(request);
+                free_request(request);
                 _error = total_send_count;
+                close_stream_socket();
                 return NULL;
             }
         }
@@ -178,12 +196,13 @@ public:
         // finalize...?
         const char* fin = "0\r\n\r\n";
         if ((total_send_count = send_buffer((char*)fin, strlen(fin))) < 0) {
-            free(request);
+            free_request(request);
             _error = total_send_count;
+            close_stream_socket();
             return NULL;
         }
 
-        free(request);
+        free_request(request);
 
         return create_http_response();
     }
@@ -202,6 +221,40 @@ public:
         _request_builder->set_header(key, value);
     }
 
+    /**
+     * Receive the responses in streaming mode, in buffers owned by the caller.
+     * The body only goes to the body callback, and only the headers named with
+     * keep_header() are stored, see HttpResponse::get_header(). Nothing is allocated
+     * per request, and the response object is reused by every send().
+     *
+     * The connection stays open after a response when the server allows it, and the
+     * next send() goes out on it. Otherwise it is opened again, except for HTTPS.
+     *
+     * @param recv_buffer Buffer for the data received, the request is built in it too when it fits
+     * @param recv_buffer_size Size of the receive buffer
+     * @param header_arena Buffer for the headers that are kept
+     * @param header_arena_size Size of the header arena
+     */
+    void set_stream_buffers(uint8_t *recv_buffer, size_t recv_buffer_size, char *header_arena = NULL, size_t header_arena_size = 0) {
+        _recv_buffer = recv_buffer;
+        _recv_buffer_size = recv_buffer_size;
+        _header_arena = header_arena;
+        _header_arena_size = header_arena_size;
+    }
+
+    /**
+     * Keep a header of the responses in streaming mode, the name is not copied.
+     *
+     * @return false if HTTP_STREAM_MAX_HEADERS headers are kept already
+     */
+    bool keep_header(const char *name) {
+        if (_keep_headers_count == HTTP_STREAM_MAX_HEADERS) {
+            return false;
+        }
+        _keep_headers[_keep_headers_count++] = name;
+        return true;
+    }
+
     /**
      * Get the error code.
      *
@@ -237,22 +290,55 @@ protected:
 
 private:
     nsapi_error_t connect_socket( ) {
-        if (_response != NULL) {
+        if (_response != NULL && _recv_buffer == NULL) {
             // already executed this response
             return -2100; // @todo, make a lookup table with errors
         }
 
 
-        if (_we_created_socket) {
+        if (_we_created_socket && !_connected) {
             nsapi_error_t connection_result = connect_socket(_parsed_url->host(), _parsed_url->port());
             if (connection_result != NSAPI_ERROR_OK) {
                 return connection_result;
             }
+            _connected = true;
         }
 
         return NSAPI_ERROR_OK;
     }
 
+    void close_socket() {
+        if (_we_created_socket) {
+            _socket->close();
+            _connected = false;
+            _socket_closed = true;
+        }
+    }
+
+    // After an error the state of a kept connection is unknown
+    void close_stream_socket() {
+        if (_recv_buffer != NULL) {
+            close_socket();
+        }
+    }
+
+    char* build_request(const void* body, uint32_t body_size, uint32_t &size) {
+        // In streaming mode the request goes in the receive buffer, it is sent before anything is received
+        if (_recv_buffer != NULL) {
+            size = _request_builder->build(body, body_size, (char*)_recv_buffer, _recv_buffer_size);
+            if (size != 0) {
+                return (char*)_recv_buffer;
+            }
+        }
+        return _request_builder->build(body, body_size, size);
+    }
+
+    void free_request(char* request) {
+        if (request != (char*)_recv_buffer) {
+            free(request);
+        }
+    }
+
     nsapi_size_or_error_t send_buffer(char* buffer, uint32_t buffer_size) {
         nsapi_size_or_error_t total_send_count = 0;
         while (total_send_count < buffer_size) {
@@ -285,24 +371,43 @@ private:
     }
 
     HttpResponse* create_http_response() {
-        // Create a response object
-        _response = new HttpResponse();
+        bool streaming = _recv_buffer != NULL;
+        uint8_t* recv_buffer;
+        size_t recv_buffer_size;
+
+        if (streaming) {
+            // One response object for all the requests, and the caller's buffers
+            if (_response == NULL) {
+                _response = new HttpResponse();
+            }
+            _response->set_stream_buffers(_header_arena, _header_arena_size, _keep_headers, _keep_headers_count);
+            recv_buffer = _recv_buffer;
+            recv_buffer_size = _recv_buffer_size;
+        } else {
+            // Create a response object
+            _response = new HttpResponse();
+            // Set up a receive buffer (on the heap)
+            recv_buffer = (uint8_t*)malloc(HTTP_RECEIVE_BUFFER_SIZE);
+            recv_buffer_size = HTTP_RECEIVE_BUFFER_SIZE;
+        }
         // And a response parser
         HttpParser parser(_response, HTTP_RESPONSE, _body_callback);
 
-        // Set up a receive buffer (on the heap)
-        uint8_t* recv_buffer = (uint8_t*)malloc(HTTP_RECEIVE_BUFFER_SIZE);
-
         // Socket::recv is called until we don't have any data anymore
         nsapi_size_or_error_t recv_ret;
-        while ((recv_ret = _socket->recv(recv_buffer, HTTP_RECEIVE_BUFFER_SIZE)) > 0) {
+        uint32_t received = 0;
+        while ((recv_ret = _socket->recv(recv_buffer, recv_buffer_size)) > 0) {
+            received += recv_ret;
 
             // Pass the chunk into the http_parser
             uint32_t nparsed = parser.execute((const char*)recv_buffer, recv_ret);
             if (nparsed != recv_ret) {
                 // printf("Parsing failed... parsed %d bytes, received %d bytes\n", nparsed, recv_ret);
                 _error = -2101;
-                free(recv_buffer);
+                if (!streaming) {
+                    free(recv_buffer);
+                }
+                close_stream_socket();
                 return NULL;
             }
 
@@ -310,22 +415,33 @@ private:
                 break;
             }
         }
+        if (streaming && received == 0) {
+            // Closed without a response
+            _error = NSAPI_ERROR_CONNECTION_LOST;
+            close_socket();
+            return NULL;
+        }
         // error?
         if (recv_ret < 0) {
             _error = recv_ret;
-            free(recv_buffer);
+            if (!streaming) {
+                free(recv_buffer);
+            }
+            close_stream_socket();
             return NULL;
         }
 
         // When done, call parser.finish()
         parser.finish();
 
-        // Free the receive buffer
-        free(recv_buffer);
+        if (!streaming) {
+            // Free the receive buffer
+            free(recv_buffer);
+        }
 
-        if (_we_created_socket) {
-            // Close the socket
-            _socket->close();
+        // In streaming mode the connection stays open for the next request, unless it ended the response
+        if (!streaming || recv_ret == 0 || !parser.should_keep_alive()) {
+            close_socket();
         }
 
         return _response;
@@ -348,6 +464,17 @@ private:
     uint8_t *_request_buffer;
     size_t _request_buffer_size;
     size_t _request_buffer_ix;
+
+    // Streaming mode, see set_stream_buffers()
+    uint8_t *_recv_buffer;
+    size_t _recv_buffer_size;
+    char *_header_arena;
+    size_t _header_arena_size;
+    const char *_keep_headers[HTTP_STREAM_MAX_HEADERS];
+    uint32_t _keep_headers_count;
+
+    bool _connected;
+    bool _socket_closed;    // Closed after a response, it has to be opened again for the next one
 };
 
 #endif // _HTTP_REQUEST_BASE_H_
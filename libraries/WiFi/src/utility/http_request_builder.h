@@ -65,6 +65,39 @@ public:
     }
 
     char* build(const void* body, uint32_t body_size, uint32_t &size, bool skip_content_length = false) {
+        size = prepare(body_size);
+
+        // Now let's print it
+        char* req = (char*)calloc(size + 1, 1);
+        print(req, body, body_size);
+
+        // Uncomment to debug...
+        // printf("----- BEGIN REQUEST -----\n");
+        // printf("%s", req);
+        // printf("----- END REQUEST -----\n");
+
+        return req;
+    }
+
+    /**
+     * Build the request in a buffer of the caller, instead of one allocated for it
+     *
+     * @return The size of the request, or 0 if it does not fit in the buffer
+     */
+    uint32_t build(const void* body, uint32_t body_size, char* buffer, uint32_t buffer_size) {
+        uint32_t size = prepare(body_size);
+
+        // sprintf() terminates the last line
+        if (size + 1 > buffer_size) {
+            return 0;
+        }
+        print(buffer, body, body_size);
+        return size;
+    }
+
+private:
+    // Sets the Content-Length header and returns the size of the request
+    uint32_t prepare(uint32_t body_size) {
         const char* method_str = http_method_str(method);
 
         bool is_chunked = has_header("Transfer-Encoding", "chunked");
@@ -75,7 +108,7 @@ public:
             set_header("Content-Length", std::string(buffer));
         }
 
-        size = 0;
+        uint32_t size = 0;
 
         // first line is METHOD PATH+QUERY HTTP/1.1\r\n
         size += strlen(method_str) + 1 + strlen(parsed_url->path()) + (strlen(parsed_url->query()) ? strlen(parsed_url->query()) + 1 : 0) + 1 + 8 + 2;
@@ -95,9 +128,11 @@ public:
             size += body_size;
         }
 
-        // Now let's print it
-        char* req = (char*)calloc(size + 1, 1);
-        char* originalReq = req;
+        return size;
+    }
+
+    void print(char* req, const void* body, uint32_t body_size) {
+        const char* method_str = http_method_str(method);
 
         if (strlen(parsed_url->query())) {
             sprintf(req, "%s %s?%s HTTP/1.1\r\n", method_str, parsed_url->path(), parsed_url->query());
@@ -120,16 +155,8 @@ public:
             memcpy(req, body, body_size);
         }
         req += body_size;
-
-        // Uncomment to debug...
-        // printf("----- BEGIN REQUEST -----\n");
-        // printf("%s", originalReq);
-        // printf("----- END REQUEST -----\n");
-
-        return originalReq;
     }
 
-private:
     bool has_header(const char* key, const char* value = NULL) {
         typedef std::map<std::string, std::string>::iterator it_type;
         for(it_type it = headers.begin(); it != headers.end(); it++) {
@@ -27,40 +27,37 @@ public:
     HttpParser(HttpResponse* a_response, http_parser_type parser_type, mbed::Callback<void(const char *at, uint32_t length)> a_body_callback = 0)
         : response(a_response), body_callback(a_body_callback)
     {
-        settings = new http_parser_settings();
-
-        settings->on_message_begin = &HttpParser::on_message_begin_callback;
-        settings->on_url = &HttpParser::on_url_callback;
-        settings->on_status = &HttpParser::on_status_callback;
-        settings->on_header_field = &HttpParser::on_header_field_callback;
-        settings->on_header_value = &HttpParser::on_header_value_callback;
-        settings->on_headers_complete = &HttpParser::on_headers_complete_callback;
-        settings->on_chunk_header = &HttpParser::on_chunk_header_callback;
-        settings->on_chunk_complete = &HttpParser::on_chunk_complete_callback;
-        settings->on_body = &HttpParser::on_body_callback;
-        settings->on_message_complete = &HttpParser::on_message_complete_callback;
-
-        // Construct the http_parser object
-        parser = new http_parser();
-        http_parser_init(parser, parser_type);
-        parser->data = (void*)this;
-    }
-
-    ~HttpParser() {
-        if (parser) {
-            delete parser;
-        }
-        if (settings) {
-            delete settings;
-        }
+        memset(&settings, 0, sizeof(settings));
+
+        settings.on_message_begin = &HttpParser::on_message_begin_callback;
+        settings.on_url = &HttpParser::on_url_callback;
+        settings.on_status = &HttpParser::on_status_callback;
+        settings.on_header_field = &HttpParser::on_header_field_callback;
+        settings.on_header_value = &HttpParser::on_header_value_callback;
+        settings.on_headers_complete = &HttpParser::on_headers_complete_callback;
+        settings.on_chunk_header = &HttpParser::on_chunk_header_callback;
+        settings.on_chunk_complete = &HttpParser::on_chunk_complete_callback;
+        settings.on_body = &HttpParser::on_body_callback;
+        settings.on_message_complete = &HttpParser::on_message_complete_callback;
+
+        // The parser lives in this object, so one on the stack allocates nothing
+        http_parser_init(&parser, parser_type);
+        parser.data = (void*)this;
     }
 
     uint32_t execute(const char* buffer, uint32_t buffer_size) {
-        return http_parser_execute(parser, settings, buffer, buffer_size);
+        return http_parser_execute(&parser, &settings, buffer, buffer_size);
     }
 
     void finish() {
-        http_parser_execute(parser, settings, NULL, 0);
+        http_parser_execute(&parser, &settings, NULL, 0);
+    }
+
+    /**
+     * Whether the connection can be used for another request, once the message is complete
+     */
+    bool should_keep_alive() {
+        return http_should_keep_alive(&parser) != 0;
     }
 
 private:
@@ -70,26 +67,31 @@ private:
     }
 
     int on_url(http_parser* parser, const char *at, uint32_t length) {
+        if (response->is_streaming()) {
+            return 0;
+        }
         string s(at, length);
         response->set_url(s);
         return 0;
     }
 
     int on_status(http_parser* parser, const char *at, uint32_t length) {
+        if (response->is_streaming()) {
+            response->set_status(parser->status_code);
+            return 0;
+        }
         string s(at, length);
         response->set_status(parser->status_code, s);
         return 0;
     }
 
     int on_header_field(http_parser* parser, const char *at, uint32_t length) {
-        string s(at, length);
-        response->set_header_field(s);
+        response->add_header_field(at, length);
         return 0;
     }
 
     int on_header_value(http_parser* parser, const char *at, uint32_t length) {
-        string s(at, length);
-        response->set_header_value(s);
+        response->add_header_value(at, length);
         return 0;
     }
 
@@ -107,6 +109,11 @@ private:
             return 0;
         }
 
+        if (response->is_streaming()) {
+            // Nowhere to put it
+            return 0;
+        }
+
         response->set_body(at, length);
         return 0;
     }
@@ -170,8 +177,8 @@ private:
 
     HttpResponse* response;
     mbed::Callback<void(const char *at, uint32_t length)> body_callback;
-    http_parser* parser;
-    http_parser_settings* settings;
+    http_parser parser;
+    http_parser_settings settings;
 };
 
 #endif // _HTTP_RESPONSE_PARSER_H_
@@ -35,6 +35,14 @@ public:
         body_length = 0;
         body_offset = 0;
         body = NULL;
+        streaming = false;
+        arena = NULL;
+        arena_size = 0;
+        arena_used = 0;
+        keep = NULL;
+        keep_count = 0;
+        header_start = 0;
+        header_kept = false;
     }
 
     ~HttpResponse() {
@@ -53,6 +61,10 @@ public:
         status_message = a_status_message;
     }
 
+    void set_status(int a_status_code) {
+        status_code = a_status_code;
+    }
+
     int get_status_code() {
         return status_code;
     }
@@ -105,7 +117,79 @@ public:
         concat_header_value = true;
     }
 
+    /**
+     * Switch to streaming mode, and get ready to receive a new response.
+     * Only the headers named in keep are stored, as "field\0value\0" pairs in arena,
+     * and the body only goes to the body callback. Nothing is allocated.
+     *
+     * @param an_arena Buffer for the headers, headers that do not fit are dropped
+     * @param an_arena_size Size of the arena
+     * @param a_keep Names of the headers to store, compared ignoring case. They are not copied.
+     * @param a_keep_count Number of names in a_keep
+     */
+    void set_stream_buffers(char* an_arena, uint32_t an_arena_size, const char* const* a_keep, uint32_t a_keep_count) {
+        arena = an_arena;
+        arena_size = an_arena_size;
+        keep = a_keep;
+        keep_count = a_keep_count;
+        streaming = true;
+
+        status_code = 0;
+        concat_header_field = false;
+        concat_header_value = false;
+        is_chunked = false;
+        is_message_completed = false;
+        body_length = 0;
+        arena_used = 0;
+        header_kept = false;
+    }
+
+    bool is_streaming() {
+        return streaming;
+    }
+
+    void add_header_field(const char *at, uint32_t length) {
+        if (!is_streaming()) {
+            set_header_field(string(at, length));
+            return;
+        }
+
+        if (!concat_header_field) {
+            end_stream_header();
+            header_start = arena_used;
+            header_kept = true;
+        }
+        concat_header_value = false;
+        concat_header_field = true;
+
+        append_stream_header(at, length);
+    }
+
+    void add_header_value(const char *at, uint32_t length) {
+        if (!is_streaming()) {
+            set_header_value(string(at, length));
+            return;
+        }
+
+        if (!concat_header_value) {
+            // The field is complete, see if it is one to keep
+            append_stream_header("", 1);
+            if (header_kept && !is_kept_header(arena + header_start)) {
+                drop_stream_header();
+            }
+        }
+        concat_header_field = false;
+        concat_header_value = true;
+
+        append_stream_header(at, length);
+    }
+
     void set_headers_complete() {
+        if (is_streaming()) {
+            end_stream_header();
+            return;
+        }
+
         for (uint32_t ix = 0; ix < header_fields.size(); ix++) {
             if (strcicmp(header_fields[ix]->c_str(), "content-length") == 0) {
                 expected_content_length = (uint32_t)atoi(header_values[ix]->c_str());
@@ -118,6 +202,31 @@ public:
         return header_fields.size();
     }
 
+    /**
+     * Get the value of a header, or NULL if the response does not have it.
+     * In streaming mode only the headers it was told to keep are there.
+     */
+    const char* get_header(const char* field) {
+        if (is_streaming()) {
+            const char* p = arena;
+            while (p < arena + arena_used) {
+                const char* value = p + strlen(p) + 1;
+                if (strcicmp(p, field) == 0) {
+                    return value;
+                }
+                p = value + strlen(value) + 1;
+            }
+            return NULL;
+        }
+
+        for (uint32_t ix = 0; ix < header_fields.size(); ix++) {
+            if (strcicmp(header_fields[ix]->c_str(), field) == 0) {
+                return header_values[ix]->c_str();
+            }
+        }
+        return NULL;
+    }
+
     vector<string*> get_headers_fields() {
         return header_fields;
     }
@@ -170,7 +279,8 @@ public:
     }
 
     uint32_t get_body_length() {
-        return body_offset;
+        // In streaming mode the body is not stored, this is what went to the callback
+        return is_streaming() ? body_length : body_offset;
     }
 
     bool is_message_complete() {
@@ -186,6 +296,42 @@ public:
     }
 
 private:
+    void append_stream_header(const char *at, uint32_t length) {
+        if (!header_kept) {
+            return;
+        }
+        if (length > arena_size - arena_used) {
+            drop_stream_header();
+            return;
+        }
+        memcpy(arena + arena_used, at, length);
+        arena_used += length;
+    }
+
+    void end_stream_header() {
+        // A field without a value is dropped too
+        if (header_kept && concat_header_value) {
+            append_stream_header("", 1);
+        } else if (header_kept) {
+            drop_stream_header();
+        }
+        header_kept = false;
+    }
+
+    void drop_stream_header() {
+        arena_used = header_start;
+        header_kept = false;
+    }
+
+    bool is_kept_header(const char* field) {
+        for (uint32_t ix = 0; ix < keep_count; ix++) {
+            if (strcicmp(keep[ix], field) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     // from http://stackoverflow.com/questions/5820810/case-insensitive-string-comp-in-c
     int strcicmp(char const *a, char const *b) {
         for (;; a++, b++) {
@@ -224,6 +370,16 @@ private:
     char * body;
     uint32_t body_length;
     uint32_t body_offset;
+
+    // Streaming mode, see set_stream_buffers()
+    bool streaming;
+    char* arena;
+    uint32_t arena_size;
+    uint32_t arena_used;
+    const char* const* keep;
+    uint32_t keep_count;
+    uint32_t header_start;  // Where the header being received starts in the arena
+    bool header_kept;       // The header being received is stored
 };
 
 #endif
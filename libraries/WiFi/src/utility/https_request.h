@@ -38,7 +38,8 @@ public:
      * Initializes the TCP socket, sets up event handlers and flags.
      *
      * @param[in] network The network interface
-     * @param[in] ssl_ca_pem String containing the trusted CAs
+     * @param[in] ssl_ca_pem String containing the trusted CAs, used again when the socket is reopened,
+                           it has to stay valid as long as the request
      * @param[in] method HTTP method to use
      * @param[in] url URL to the resource
      * @param[in] body_callback Callback on which to retrieve chunks of the response body.
@@ -59,12 +60,8 @@ public:
         _request_builder = new HttpRequestBuilder(method, _parsed_url);
         _response = NULL;
 
-        _socket = new TLSSocket();
-        ((TLSSocket*)_socket)->open(network);
-        if (ssl_ca_pem)
-          ((TLSSocket*)_socket)->set_root_ca_cert(ssl_ca_pem);
-        else
-          ((TLSSocket*)_socket)->set_root_ca_cert("/wlan/", 0);
+        _ssl_ca_pem = ssl_ca_pem;
+        open_socket();
         _we_created_socket = true;
     }
 
@@ -90,6 +87,7 @@ public:
         _request_builder = new HttpRequestBuilder(method, _parsed_url);
         _response = NULL;
 
+        _ssl_ca_pem = NULL;
         _we_created_socket = false;
     }
 
@@ -97,11 +95,38 @@ public:
 
 protected:
     virtual nsapi_error_t connect_socket(char *host, uint16_t port) {
+        if (_socket_closed) {
+            // A closed TLSSocket cannot be opened again, it is replaced by a new one
+            nsapi_error_t ret = open_socket();
+            if (ret != NSAPI_ERROR_OK) {
+                return ret;
+            }
+            _socket_closed = false;
+        }
+
+        ((TLSSocket*)_socket)->set_hostname(host);
+
         SocketAddress socketAddress = SocketAddress();
         socketAddress.set_port(port);
         _network->gethostbyname(host, &socketAddress);
         return ((TLSSocket*)_socket)->connect(socketAddress);
     }
+
+private:
+    nsapi_error_t open_socket() {
+        delete _socket;
+        _socket = new TLSSocket();
+        nsapi_error_t ret = ((TLSSocket*)_socket)->open(_network);
+        if (ret != NSAPI_ERROR_OK) {
+            return ret;
+        }
+        if (_ssl_ca_pem)
+          return ((TLSSocket*)_socket)->set_root_ca_cert(_ssl_ca_pem);
+        else
+          return ((TLSSocket*)_socket)->set_root_ca_cert("/wlan/", 0);
+    }
+
+    const char* _ssl_ca_pem;
 };
 
 #endif // _MBED_HTTPS_REQUEST_H_
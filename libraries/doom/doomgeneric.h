@@ -11,6 +11,14 @@
 
 extern uint32_t* DG_ScreenBuffer;
 
+typedef struct {
+  uint32_t frames;      // Frames handed to the display by the game
+  uint32_t presented;   // Frames converted and queued for scanout
+  uint32_t dropped;     // Frames replaced by a newer one before conversion
+  uint32_t submit_us;   // Time the game loop spent handing frames over
+  uint32_t convert_us;  // Time from the start of a conversion to its present
+} dg_profile_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,6 +29,8 @@ uint32_t DG_GetTicksMs();
 int DG_GetKey(int* pressed, unsigned char* key);
 void DG_SetWindowTitle(const char * title);
 void DG_OnPaletteReload();
+// Copies the counters accumulated since the last call
+void DG_GetProfile(dg_profile_t* profile);
 #ifdef __cplusplus
 }
 #endif
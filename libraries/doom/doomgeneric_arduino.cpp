@@ -3,6 +3,7 @@
 #include "Arduino.h"
 #include "mbed.h"
 #include "Portenta_Video.h"
+#include "MemoryRegions.h"
 
 #define sleep _sleep
 
@@ -95,74 +96,119 @@ mbed::DigitalOut video_on(PK_2);
 mbed::DigitalOut video_rst(PJ_3);
 
 uint32_t LCD_X_Size = 0, LCD_Y_Size = 0;
-DMA2D_HandleTypeDef    DMA2D_Handle;
 
+/*
+ * Present stage. The game's L8 frames are converted to RGB565 and scaled 2x
+ * by the DMA2D, in the background:
+ *  - each CLUT entry holds its palette color twice, as a pair of RGB565 pixels
+ *    read as one ARGB8888 pixel, so with an ARGB8888 output every L8 pixel
+ *    becomes two identical RGB565 pixels.
+ *  - the output skips every other line: two passes, even lines then odd lines,
+ *    chained from the DMA2D interrupt, give the vertical scaling.
+ * The frame goes to the display back buffer and is presented at vblank. The
+ * game only copies its frame to one of two staging buffers, if the display is
+ * busy the frame waits there and is replaced if a newer one comes first.
+ */
+#define SRC_X     (DOOMGENERIC_RESX / 2)
+#define SRC_Y     (DOOMGENERIC_RESY / 2)
+#define SRC_SIZE  (SRC_X * SRC_Y)
+
+/* As in i_video.c */
+struct color {
+    uint32_t b:8;
+    uint32_t g:8;
+    uint32_t r:8;
+    uint32_t a:8;
+};
 extern struct color colors[];
 
-static void InitCLUT(uint32_t * clut)
+static uint8_t* staging[2];
+static volatile int converting = -1;   /* Staging buffer read by the DMA2D */
+static volatile int queued = -1;       /* Staging buffer waiting for the display */
+static volatile int pass = 0;
+static uint32_t destination;
+
+/* Written alternately, so a palette change never touches the table the
+   DMA2D may be loading */
+static uint32_t __ALIGNED(32) L8_CLUT[2][256];
+static volatile int clut_pending = -1;
+static int clut_write = 0;
+
+static volatile uint32_t convert_start;
+static volatile dg_profile_t profile;
+
+static void convert_done(DMA2D_HandleTypeDef* dma2d)
 {
-  uint32_t  red = 0, green = 0, blue = 0;
-  uint32_t  i = 0x00;
-
-  /* Color map generation */
-  for (i = 0; i < 256; i++)
-  {
-    /* Generate red, green and blue values */
-    red = (i * 8) % 256;
-    green = (i * 6) % 256;
-    blue = (i * 4) % 256;
-
-    red = red << 16;
-    green = green << 8;
-
-    /* Store the 32-bit value */
-    clut[i] = 0xFF000000 | (red + green + blue);
+  if (pass == 0) {
+    pass = 1;
+    HAL_DMA2D_Start_IT(dma2d, (uint32_t)staging[converting], destination + LCD_X_Size * 2, SRC_X, SRC_Y);
+    return;
   }
-}
 
-uint32_t __ALIGNED(32) L8_CLUT[256];
-static DMA2D_CLUTCfgTypeDef clut;
+  profile.presented++;
+  profile.convert_us += micros() - convert_start;
+  converting = -1;
+  stm32_LCD_PresentFrame(false);
+}
 
-static void DMA2D_Init(uint16_t xsize, uint16_t ysize)
+/* Runs with interrupts masked or from an interrupt, with no flip pending */
+static void convert_start_frame(int s)
 {
+  DMA2D_HandleTypeDef* dma2d = stm32_get_DMA2D();
+
+  converting = s;
+  convert_start = micros();
+
+  uint32_t fb = stm32_LCD_BeginFrame();
+  destination = fb + (((LCD_Y_Size - DOOMGENERIC_RESY) / 2) * LCD_X_Size + (LCD_X_Size - DOOMGENERIC_RESX) / 2) * 2;
+
   /*##-1- Configure the DMA2D Mode, Color Mode and output offset #############*/
-  DMA2D_Handle.Init.Mode         = DMA2D_M2M_PFC;
-  DMA2D_Handle.Init.ColorMode    = DMA2D_OUTPUT_RGB565;
-  DMA2D_Handle.Init.OutputOffset = 0; //LCD_X_Size - xsize;
-  DMA2D_Handle.Init.AlphaInverted = DMA2D_REGULAR_ALPHA;  /* No Output Alpha Inversion*/
-  DMA2D_Handle.Init.RedBlueSwap   = DMA2D_RB_REGULAR;     /* No Output Red & Blue swap */
+  dma2d->Init.Mode         = DMA2D_M2M_PFC;
+  dma2d->Init.ColorMode    = DMA2D_OUTPUT_ARGB8888;
+  dma2d->Init.OutputOffset = LCD_X_Size - SRC_X;
+  dma2d->Init.AlphaInverted = DMA2D_REGULAR_ALPHA;  /* No Output Alpha Inversion*/
+  dma2d->Init.RedBlueSwap   = DMA2D_RB_REGULAR;     /* No Output Red & Blue swap */
 
   /*##-2- DMA2D Callbacks Configuration ######################################*/
-  DMA2D_Handle.XferCpltCallback  = NULL;
+  dma2d->XferCpltCallback  = convert_done;
 
   /*##-3- Foreground Configuration ###########################################*/
-  DMA2D_Handle.LayerCfg[1].AlphaMode = DMA2D_REPLACE_ALPHA; //DMA2D_NO_MODIF_ALPHA;
-  DMA2D_Handle.LayerCfg[1].InputAlpha = 0x00;
-  DMA2D_Handle.LayerCfg[1].InputColorMode = DMA2D_INPUT_L8; //DMA2D_OUTPUT_RGB565;
-  //DMA2D_Handle.LayerCfg[1].ChromaSubSampling = cssMode;
-  DMA2D_Handle.LayerCfg[1].InputOffset = 0; //LCD_Y_Size - ysize;
-  DMA2D_Handle.LayerCfg[1].RedBlueSwap = DMA2D_RB_REGULAR; /* No ForeGround Red/Blue swap */
-  DMA2D_Handle.LayerCfg[1].AlphaInverted = DMA2D_REGULAR_ALPHA; /* No ForeGround Alpha inversion */
+  dma2d->LayerCfg[1].AlphaMode = DMA2D_NO_MODIF_ALPHA;
+  dma2d->LayerCfg[1].InputAlpha = 0xFF;
+  dma2d->LayerCfg[1].InputColorMode = DMA2D_INPUT_L8;
+  dma2d->LayerCfg[1].InputOffset = 0;
+  dma2d->LayerCfg[1].RedBlueSwap = DMA2D_RB_REGULAR; /* No ForeGround Red/Blue swap */
+  dma2d->LayerCfg[1].AlphaInverted = DMA2D_REGULAR_ALPHA; /* No ForeGround Alpha inversion */
 
-  DMA2D_Handle.Instance          = DMA2D;
+  dma2d->Instance          = DMA2D;
 
   /*##-4- DMA2D Initialization     ###########################################*/
-  HAL_DMA2D_Init(&DMA2D_Handle);
-  HAL_DMA2D_ConfigLayer(&DMA2D_Handle, 1);
-
-  memcpy(L8_CLUT, colors, 256 * 4);
-  clut.pCLUT = (uint32_t *)L8_CLUT; //(uint32_t *)colors;
-  clut.CLUTColorMode = DMA2D_CCM_ARGB8888;
-  clut.Size = 0xFF;
+  HAL_DMA2D_Init(dma2d);
+  HAL_DMA2D_ConfigLayer(dma2d, 1);
+
+  /* The palette is uploaded once per change */
+  if (clut_pending >= 0) {
+    DMA2D_CLUTCfgTypeDef clut;
+    clut.pCLUT = L8_CLUT[clut_pending];
+    clut.CLUTColorMode = DMA2D_CCM_ARGB8888;
+    clut.Size = 0xFF;
+    HAL_DMA2D_CLUTLoad(dma2d, clut, 1);
+    HAL_DMA2D_PollForTransfer(dma2d, 100);
+    clut_pending = -1;
+  }
 
-#ifdef CORE_CM7
-  SCB_CleanInvalidateDCache();
-  SCB_InvalidateICache();
-  //SCB_InvalidateDCache_by_Addr(clut.pCLUT, clut.Size);
-#endif
+  pass = 0;
+  HAL_DMA2D_Start_IT(dma2d, (uint32_t)staging[s], destination, SRC_X, SRC_Y);
+}
 
-  HAL_DMA2D_CLUTLoad(&DMA2D_Handle, clut, 1);
-  HAL_DMA2D_PollForTransfer(&DMA2D_Handle, 100);
+/* Called from the LTDC interrupt once the last frame is on screen */
+static void flip_done(uint32_t front)
+{
+  if (queued >= 0) {
+    int s = queued;
+    queued = -1;
+    convert_start_frame(s);
+  }
 }
 
 void DG_Init()
@@ -199,10 +245,30 @@ void DG_Init()
 
   stm32_LCD_Clear(0);
   stm32_LCD_Clear(0);
+
+  for (int i = 0; i < 2; i++) {
+    /* Uncached DMA pool if the sketch set one up, the SDRAM heap otherwise */
+    staging[i] = (uint8_t*)MemoryRegions.malloc(MEMORY_POOL_DMA, SRC_SIZE);
+    if (staging[i] == NULL) {
+      staging[i] = (uint8_t*)SDRAM.malloc(SRC_SIZE, 32);
+    }
+  }
+  stm32_LCD_SetFlipCallback(flip_done);
 }
 
 void DG_OnPaletteReload() {
-  DMA2D_Init(DOOMGENERIC_RESX, DOOMGENERIC_RESY);
+  uint32_t* clut = L8_CLUT[clut_write];
+
+  for (int i = 0; i < 256; i++) {
+    uint32_t c = ((colors[i].r >> 3) << 11) | ((colors[i].g >> 2) << 5) | (colors[i].b >> 3);
+    clut[i] = (c << 16) | c;
+  }
+#ifdef CORE_CM7
+  SCB_CleanDCache_by_Addr(clut, sizeof(L8_CLUT[0]));
+#endif
+
+  clut_pending = clut_write;
+  clut_write ^= 1;
 }
 
 static void handleKeyInput()
@@ -230,37 +296,42 @@ static void handleKeyInput()
 #endif
 }
 
-//#define DEBUG_CM7_VIDEO
-
-static void DMA2D_CopyBuffer(uint32_t *pSrc, uint32_t *pDst)
+void DG_DrawFrame()
 {
-  uint32_t xPos, yPos, destination;
+  uint32_t start = micros();
 
-  /*##-1- calculate the destination transfer address  ############*/
-  xPos = (stm32_getXSize() - DOOMGENERIC_RESX) / 2;
-  yPos = (stm32_getYSize() - DOOMGENERIC_RESY) / 2;
-
-  destination = (uint32_t)pDst; // + ((yPos * stm32_getXSize()) + xPos) * 4;
+  /* A frame still waiting for the display is replaced by this one */
+  core_util_critical_section_enter();
+  if (queued >= 0) {
+    queued = -1;
+    profile.dropped++;
+  }
+  core_util_critical_section_exit();
+
+  /* The DMA2D reads one staging buffer at most */
+  int s = (converting == 0) ? 1 : 0;
+  memcpy(staging[s], DG_ScreenBuffer, SRC_SIZE);
+  MemoryRegions.clean(staging[s], SRC_SIZE);
+
+  core_util_critical_section_enter();
+  if (converting < 0 && !stm32_LCD_FlipPending()) {
+    convert_start_frame(s);
+  } else {
+    queued = s;
+  }
+  core_util_critical_section_exit();
 
-  HAL_DMA2D_PollForTransfer(&DMA2D_Handle, 100);  /* wait for the previous DMA2D transfer to ends */
-  /* copy the new decoded frame to the LCD Frame buffer*/
-  HAL_DMA2D_Start(&DMA2D_Handle, (uint32_t)pSrc, destination, DOOMGENERIC_RESX, DOOMGENERIC_RESY);
-#if defined(CORE_CM7) && !defined(DEBUG_CM7_VIDEO) 
-  HAL_DMA2D_PollForTransfer(&DMA2D_Handle, 100);  /* wait for the previous DMA2D transfer to ends */
-#endif
+  profile.frames++;
+  profile.submit_us += micros() - start;
+  //handleKeyInput();
 }
 
-void DG_DrawFrame()
+void DG_GetProfile(dg_profile_t* out)
 {
-  uint32_t fb = getNextFrameBuffer();
-#ifdef CORE_CM7
-  //SCB_CleanInvalidateDCache();
-  //SCB_InvalidateICache();
-  SCB_InvalidateDCache_by_Addr((uint32_t *)fb, DOOMGENERIC_RESX * DOOMGENERIC_RESY * 4);
-#endif
-
-  DMA2D_CopyBuffer((uint32_t *)DG_ScreenBuffer, (uint32_t *)fb);
-  //handleKeyInput();
+  core_util_critical_section_enter();
+  memcpy(out, (const void*)&profile, sizeof(*out));
+  memset((void*)&profile, 0, sizeof(profile));
+  core_util_critical_section_exit();
 }
 
 void DG_SleepMs(uint32_t ms)
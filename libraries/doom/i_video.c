@@ -89,7 +89,6 @@ void I_GetEvent(void);
 // The screen buffer; this is modified to draw things to the screen
 
 byte *I_VideoBuffer = NULL;
-byte *I_VideoBuffer_FB = NULL;
 
 // If true, game is running as a screensaver
 
@@ -220,8 +219,6 @@ void I_InitGraphics (void)
 
     /* Allocate screen to draw to */
 	I_VideoBuffer = (byte*)Z_Malloc (SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);  // For DOOM to draw on
-    printf("[%s] ea_malloc %d\n", __func__, s_Fb.xres * s_Fb.yres * (s_Fb.bits_per_pixel/8));
-	I_VideoBuffer_FB = (byte*)ea_malloc(s_Fb.xres * s_Fb.yres * (s_Fb.bits_per_pixel/8));     // For a single write() syscall to fbdev
 
 	screenvisible = true;
 
@@ -232,7 +229,6 @@ void I_InitGraphics (void)
 void I_ShutdownGraphics (void)
 {
 	Z_Free (I_VideoBuffer);
-	ea_free(I_VideoBuffer_FB);
 }
 
 void I_StartFrame (void)
@@ -263,25 +259,8 @@ void __attribute__((optimize("O0"))) readBuffer(uint32_t* buf, size_t len) {
 void I_FinishUpdate (void)
 {
 
-    uint8_t* inbuf = I_VideoBuffer;
-    uint8_t* outbuf = I_VideoBuffer_FB;
-
-    for (uint32_t i = 0; i < SCREENHEIGHT; i++) {
-        uint8_t* inbuf_temp = inbuf;
-        uint8_t* outbuf_temp = outbuf;
-        for (uint32_t pix = 0; pix < SCREENWIDTH; pix++) {
-            *outbuf++ = *inbuf;
-            *outbuf++ = *inbuf++;
-        }
-        memcpy(outbuf, outbuf_temp, SCREENWIDTH * 2);
-        outbuf += SCREENWIDTH * 2;
-    }
-
-    #ifdef DEBUG_CM7_VIDEO
-    memcpy (DG_ScreenBuffer, I_VideoBuffer_FB, SCREENWIDTH * SCREENHEIGHT * 4);
-    #else
-    DG_ScreenBuffer = I_VideoBuffer_FB;
-    #endif
+    /* The port converts and scales the 8 bit frame on its way to the display */
+    DG_ScreenBuffer = (uint32_t*)I_VideoBuffer;
 
 	DG_DrawFrame();
 }
@@ -64,12 +64,30 @@
 #define RX_NO_MSG           0
 #define RX_NEW_MSG          1
 
+#ifdef CORE_CM7
+#define MAILBOX_TX          0
+#define MAILBOX_RX          1
+#else
+#define MAILBOX_TX          1
+#define MAILBOX_RX          0
+#endif
+
+/* Notification stamps are read from the CM7 us ticker timer on both cores, so
+   the sender's and the receiver's readings compare */
+#define MAILBOX_CLOCK()     (TIM5->CNT)
+
 /* Private variables ---------------------------------------------------------*/
-static uint32_t msg_received = RX_NO_MSG;
+static volatile uint32_t msg_received = RX_NO_MSG;
+/* Notification time of the pass MAILBOX_Poll is running, as stamped by the sender */
+static volatile uint32_t poll_notify_time;
+static volatile mailbox_shm_t* const mailbox_shm = (mailbox_shm_t*)MAILBOX_SHM_ADDRESS;
+
+volatile mailbox_stats_t mailbox_stats;
 
 void OPENAMP_check_for_message(void);
 
 #include "cmsis_os.h"
+#include <string.h>
 extern osThreadId eventHandlerThreadId;
 
 /* Private functions ---------------------------------------------------------*/
@@ -78,6 +96,7 @@ void HAL_HSEM_FreeCallback(uint32_t SemMask)
   /* Prevent unused argument(s) compilation warning */
   UNUSED(SemMask);
   msg_received = RX_NEW_MSG;
+  mailbox_stats.notifications++;
 
 #ifdef CORE_CM7
   HAL_HSEM_ActivateNotification(__HAL_HSEM_SEMID_TO_MASK(HSEM_ID_1));   
@@ -99,6 +118,9 @@ int MAILBOX_Init(void)
   __HAL_RCC_HSEM_CLK_ENABLE();
 
 #ifdef CORE_CM7
+  /* The CM7 comes up first, no notification can be pending yet */
+  memset((void*)mailbox_shm, 0, sizeof(mailbox_shm_t));
+
   /* Enable CM7 receive irq */
   HAL_NVIC_SetPriority(HSEM1_IRQn, 0, 1);
   HAL_NVIC_EnableIRQ(HSEM1_IRQn);
@@ -121,21 +143,47 @@ int MAILBOX_Init(void)
   */
 int MAILBOX_Poll(struct virtio_device *vdev)
 {
-  /* If we got an interrupt, ask for the corresponding virtqueue processing */
+  int ret = -EAGAIN;
 
-  if (msg_received == RX_NEW_MSG)
+  /* If we got an interrupt, ask for the corresponding virtqueue processing.
+   * The flag is cleared before the virtqueue is walked, so a notification
+   * that lands meanwhile triggers another pass instead of being lost; each
+   * pass drains every message queued so far */
+  while (1)
   {
+    __disable_irq();
+    uint32_t received = msg_received;
+    msg_received = RX_NO_MSG;
+    poll_notify_time = mailbox_shm->notify_time[MAILBOX_RX];
+    /* The pass below sees every message queued so far, the next one gets a new stamp */
+    mailbox_shm->notify_pending[MAILBOX_RX] = 0;
+    __enable_irq();
+
+    if (received != RX_NEW_MSG) {
+      break;
+    }
+
+    mailbox_stats.passes++;
 #ifdef CORE_CM7   
     rproc_virtio_notified(vdev, VRING0_ID);
 #endif                
 #ifdef CORE_CM4   
     rproc_virtio_notified(vdev, VRING1_ID);
 #endif                
-    msg_received = RX_NO_MSG;
-    return 0;
+    ret = 0;
   }
 
-  return -EAGAIN;
+  return ret;
+}
+
+/**
+  * @brief  Time elapsed since the notification being serviced
+  * @param  None
+  * @retval Microseconds since the interrupt that started the current pass
+  */
+uint32_t MAILBOX_Notify_Latency(void)
+{
+  return MAILBOX_CLOCK() - poll_notify_time;
 }
 
 /**
@@ -148,6 +196,15 @@ int MAILBOX_Notify(void *priv, uint32_t id)
    (void)priv;
    (void)id;
 
+  /* Stamp the oldest notification the other core has not picked up yet */
+  if (!mailbox_shm->notify_pending[MAILBOX_TX]) {
+    mailbox_shm->notify_time[MAILBOX_TX] = MAILBOX_CLOCK();
+    mailbox_shm->notify_pending[MAILBOX_TX] = 1;
+  }
+
+  /* The other core must see the vring update and the stamp before the notification */
+  __DSB();
+
 #ifdef CORE_CM7 
   HAL_HSEM_FastTake(HSEM_ID_0); 
   HAL_HSEM_Release(HSEM_ID_0,0);
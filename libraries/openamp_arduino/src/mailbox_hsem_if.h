@@ -51,5 +51,6 @@
 int MAILBOX_Notify(void *priv, uint32_t id);
 int MAILBOX_Init(void);
 int MAILBOX_Poll(struct virtio_device *vdev);
+uint32_t MAILBOX_Notify_Latency(void);
 
 #endif /* MAILBOX_HSEM_IF_H_ */
@@ -27,6 +27,20 @@
 
 /* Includes ------------------------------------------------------------------*/
 /* Exported types ------------------------------------------------------------*/
+typedef struct {
+  uint32_t notifications;   /* HSEM notifications received */
+  uint32_t passes;          /* Virtqueue passes run by MAILBOX_Poll */
+} mailbox_stats_t;
+
+extern volatile mailbox_stats_t mailbox_stats;
+
+/* At MAILBOX_SHM_ADDRESS, indexed by the sending core (0 = CM7, 1 = CM4): the sender
+   stamps the first notification the other core has not serviced yet, before raising it */
+typedef struct {
+  volatile uint32_t notify_time[2];
+  volatile uint32_t notify_pending[2];
+} mailbox_shm_t;
+
 /* Exported constants --------------------------------------------------------*/
 #define HSEM_ID_0           0 /* CM7 to CM4 Notification */
 #define HSEM_ID_1           1 /* CM4 to CM7 Notification */
@@ -35,5 +49,6 @@
 int MAILBOX_Notify(void *priv, uint32_t id);
 int MAILBOX_Init(void);
 int MAILBOX_Poll(struct virtio_device *vdev);
+uint32_t MAILBOX_Notify_Latency(void);
 
 #endif /* MBOX_HSEM_IF_H_ */
@@ -158,6 +158,15 @@ extern int __OPENAMP_region_end__[];
 #define VRING_BUFF_ADDRESS      (SHM_START_ADDRESS + 0x800)
 #define VRING_ALIGNMENT         4
 #define VRING_NUM_BUFFS         16   /* number of rpmsg buffers */
+#define VRING_BUFF_SIZE         (2 * VRING_NUM_BUFFS * RPMSG_BUFFER_SIZE)
+
+/* After the rpmsg buffers, a few words the mailboxes of the two cores share (mailbox_shm_t) */
+#define MAILBOX_SHM_ADDRESS     (VRING_BUFF_ADDRESS + VRING_BUFF_SIZE)
+#define MAILBOX_SHM_SIZE        32
+
+/* Shared memory after that, up to the end of the OpenAMP region, is left to the RPC bulk channel */
+#define BULK_SHM_ADDRESS        (MAILBOX_SHM_ADDRESS + MAILBOX_SHM_SIZE)
+#define BULK_SHM_SIZE           (size_t)(SHM_START_ADDRESS + SHM_SIZE - BULK_SHM_ADDRESS)
 
 /* Fixed parameter */
 #define NUM_RESOURCE_ENTRIES    2
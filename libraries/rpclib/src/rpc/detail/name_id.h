@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef NAME_ID_H_K3F8QZ1M
+#define NAME_ID_H_K3F8QZ1M
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rpc {
+namespace detail {
+
+//! \brief Computes the compact id of a function name (32 bit FNV-1a).
+//! Calls can carry this id instead of the name; both sides derive it from
+//! the name alone, so nothing has to be negotiated beyond binding the name.
+//! \param name The function name.
+constexpr uint32_t name_id(const char *name, uint32_t hash = 2166136261u) {
+    return *name ? name_id(name + 1, (hash ^ static_cast<uint8_t>(*name)) * 16777619u)
+                 : hash;
+}
+
+//! \brief Computes the id of a name that is not null terminated, such as a
+//! string received in a msgpack object.
+//! \param name The first character of the name.
+//! \param len The length of the name.
+inline uint32_t name_id_n(const char *name, std::size_t len) {
+    uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < len; i++) {
+        hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    }
+    return hash;
+}
+
+}
+}
+
+#endif /* end of include guard: NAME_ID_H_K3F8QZ1M */
@@ -3,6 +3,9 @@
 #include "rpc/detail/client_error.h"
 #include "rpc/this_handler.h"
 
+#include <algorithm>
+#include <string.h>
+
 namespace rpc {
 namespace detail {
 
@@ -15,50 +18,93 @@ void dispatcher::dispatch(RPCLIB_MSGPACK::sbuffer const &msg) {
 
 response dispatcher::dispatch(RPCLIB_MSGPACK::object const &msg,
                               bool suppress_exceptions) {
+    RPCLIB_MSGPACK::sbuffer out;
+    if (!dispatch(msg, out, suppress_exceptions)) {
+        return response::empty();
+    }
+    return response(RPCLIB_MSGPACK::unpack(out.data(), out.size()));
+}
+
+bool dispatcher::dispatch(RPCLIB_MSGPACK::object const &msg,
+                          RPCLIB_MSGPACK::sbuffer &out,
+                          bool suppress_exceptions) {
+    out.clear();
     switch (msg.via.array.size) {
     case 3:
-        return dispatch_notification(msg, suppress_exceptions);
+        dispatch_notification(msg, suppress_exceptions);
+        return false;
     case 4:
-        return dispatch_call(msg, suppress_exceptions);
+        dispatch_call(msg, out, suppress_exceptions);
+        return true;
     default:
-        return response::empty();
+        return false;
     }
 }
 
-response dispatcher::dispatch_call(RPCLIB_MSGPACK::object const &msg,
-                                   bool suppress_exceptions) {
-    call_t the_call;
-    msg.convert(the_call);
+//! \brief Packs an error response, replacing whatever was already packed.
+static void pack_error(RPCLIB_MSGPACK::sbuffer &out, uint32_t id,
+                       std::string const &error) {
+    out.clear();
+    RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer> pk(out);
+    pk.pack_array(4);
+    pk.pack(static_cast<uint8_t>(1));
+    pk.pack(id);
+    pk.pack(error);
+    pk.pack_nil();
+}
 
+void dispatcher::dispatch_call(RPCLIB_MSGPACK::object const &msg,
+                               RPCLIB_MSGPACK::sbuffer &out,
+                               bool suppress_exceptions) {
+    // The fields are read in place instead of converting to call_t, which
+    // would copy the name into a std::string for every call.
     // TODO: proper validation of protocol (and responding to it)
-    // auto &&type = std::get<0>(the_call);
+    // auto &&type = msg.via.array.ptr[0];
     // assert(type == 0);
 
-    auto &&id = std::get<1>(the_call);
-    auto &&name = std::get<2>(the_call);
-    auto &&args = std::get<3>(the_call);
+    auto const &id_obj = msg.via.array.ptr[1];
+    auto const &method = msg.via.array.ptr[2];
+    auto const &args = msg.via.array.ptr[3];
 
-    auto it_func = funcs_.find(name);
+    // A malformed call still gets an answer, with id 0 if its own is unusable
+    if (id_obj.type != RPCLIB_MSGPACK::type::POSITIVE_INTEGER ||
+        id_obj.via.u64 > UINT32_MAX) {
+        pack_error(out, 0, "rpclib: invalid call id.");
+        return;
+    }
+    auto id = static_cast<uint32_t>(id_obj.via.u64);
+    if (args.type != RPCLIB_MSGPACK::type::ARRAY) {
+        pack_error(out, id, "rpclib: call arguments are not an array.");
+        return;
+    }
 
-    if (it_func != end(funcs_)) {
-        LOG_DEBUG("Dispatching call to '{}'", name);
+    auto h = find(method);
+
+    if (h != nullptr) {
+        LOG_DEBUG("Dispatching call to '{}'", h->name);
         try {
-            auto result = (it_func->second)(args);
-            return response::make_result(id, std::move(result));
+            packer_type pk(out);
+            // The result is packed by the handler right after the header
+            pk.pack_array(4);
+            pk.pack(static_cast<uint8_t>(1));
+            pk.pack(id);
+            pk.pack_nil();
+            h->thunk(*h, args, pk);
+            return;
         } catch (rpc::detail::client_error &e) {
-            return response::make_error(
-                id, RPCLIB_FMT::format("rpclib: {}", e.what()));
+            pack_error(out, id, RPCLIB_FMT::format("rpclib: {}", e.what()));
+            return;
         } catch (std::exception &e) {
             if (!suppress_exceptions) {
                 throw;
             }
-            return response::make_error(
-                id,
+            pack_error(out, id,
                 RPCLIB_FMT::format("rpclib: function '{0}' (called with {1} "
                                    "arg(s)) "
                                    "threw an exception. The exception "
                                    "contained this information: {2}.",
-                                   name, args.via.array.size, e.what()));
+                                   h->name, args.via.array.size, e.what()));
+            return;
         } catch (rpc::detail::handler_error &) {
             // doing nothing, the exception was only thrown to
             // return immediately
@@ -69,39 +115,44 @@ response dispatcher::dispatch_call(RPCLIB_MSGPACK::object const &msg,
             if (!suppress_exceptions) {
                 throw;
             }
-            return response::make_error(
-                id,
+            pack_error(out, id,
                 RPCLIB_FMT::format("rpclib: function '{0}' (called with {1} "
                                    "arg(s)) threw an exception. The exception "
                                    "is not derived from std::exception. No "
                                    "further information available.",
-                                   name, args.via.array.size));
+                                   h->name, args.via.array.size));
+            return;
         }
     }
-    return response::make_error(
-        id, RPCLIB_FMT::format("rpclib: server could not find "
-                               "function '{0}' with argument count {1}.",
-                               name, args.via.array.size));
+    pack_error(out, id,
+        RPCLIB_FMT::format("rpclib: server could not find "
+                           "function '{0}' with argument count {1}.",
+                           method_name(method), args.via.array.size));
 }
 
-response dispatcher::dispatch_notification(RPCLIB_MSGPACK::object const &msg,
-                                           bool suppress_exceptions) {
-    notification_t the_call;
-    msg.convert(the_call);
-
+void dispatcher::dispatch_notification(RPCLIB_MSGPACK::object const &msg,
+                                       bool suppress_exceptions) {
     // TODO: proper validation of protocol (and responding to it)
-    // auto &&type = std::get<0>(the_call);
+    // auto &&type = msg.via.array.ptr[0];
     // assert(type == static_cast<uint8_t>(request_type::notification));
 
-    auto &&name = std::get<1>(the_call);
-    auto &&args = std::get<2>(the_call);
+    auto const &method = msg.via.array.ptr[1];
+    auto const &args = msg.via.array.ptr[2];
 
-    auto it_func = funcs_.find(name);
+    if (args.type != RPCLIB_MSGPACK::type::ARRAY) {
+        return;
+    }
+
+    auto h = find(method);
 
-    if (it_func != end(funcs_)) {
-        LOG_DEBUG("Dispatching call to '{}'", name);
+    if (h != nullptr) {
+        LOG_DEBUG("Dispatching call to '{}'", h->name);
+        // The result of a notification is thrown away, so it is packed
+        // into a scratch buffer that only allocates if there is a result
+        RPCLIB_MSGPACK::sbuffer discard(0);
+        packer_type pk(discard);
         try {
-            auto result = (it_func->second)(args);
+            h->thunk(*h, args, pk);
         } catch (rpc::detail::handler_error &) {
             // doing nothing, the exception was only thrown to
             // return immediately
@@ -114,7 +165,6 @@ response dispatcher::dispatch_notification(RPCLIB_MSGPACK::object const &msg,
             }
         }
     }
-    return response::empty();
 }
 
 void dispatcher::enforce_arg_count(std::string const &func, std::size_t found,
@@ -131,12 +181,64 @@ void dispatcher::enforce_arg_count(std::string const &func, std::size_t found,
 }
 
 void dispatcher::enforce_unique_name(std::string const &func) {
-    auto pos = funcs_.find(func);
-    if (pos != end(funcs_)) {
+    auto h = find(name_id(func.c_str()));
+    if (h != nullptr && h->name == func) {
         throw std::logic_error(
             RPCLIB_FMT::format("Function name already bound: '{}'. "
                                "Please use unique function names", func));
     }
+    if (h != nullptr) {
+        throw std::logic_error(
+            RPCLIB_FMT::format("Function name '{}' has the same id as an "
+                               "already bound function. Please rename it", func));
+    }
+}
+
+void dispatcher::add_handler(std::string const &name, std::shared_ptr<void> func,
+                             decltype(handler::thunk) thunk) {
+    enforce_unique_name(name);
+    handler h;
+    h.id = name_id(name.c_str());
+    h.name = name;
+    h.func = std::move(func);
+    h.thunk = thunk;
+    auto pos = std::lower_bound(
+        handlers_.begin(), handlers_.end(), h.id,
+        [](handler const &a, uint32_t id) { return a.id < id; });
+    handlers_.insert(pos, std::move(h));
+}
+
+dispatcher::handler const *dispatcher::find(uint32_t id) const {
+    auto pos = std::lower_bound(
+        handlers_.begin(), handlers_.end(), id,
+        [](handler const &a, uint32_t id) { return a.id < id; });
+    return (pos != handlers_.end() && pos->id == id) ? &*pos : nullptr;
+}
+
+dispatcher::handler const *dispatcher::find(RPCLIB_MSGPACK::object const &method) const {
+    if (method.type == RPCLIB_MSGPACK::type::POSITIVE_INTEGER) {
+        return find(static_cast<uint32_t>(method.via.u64));
+    }
+    if (method.type == RPCLIB_MSGPACK::type::STR) {
+        // Names are hashed into their id, then checked to rule out a
+        // different name that happens to share it
+        auto h = find(name_id_n(method.via.str.ptr, method.via.str.size));
+        if (h != nullptr && h->name.size() == method.via.str.size &&
+            memcmp(h->name.data(), method.via.str.ptr, method.via.str.size) == 0) {
+            return h;
+        }
+    }
+    return nullptr;
+}
+
+std::string dispatcher::method_name(RPCLIB_MSGPACK::object const &method) {
+    if (method.type == RPCLIB_MSGPACK::type::STR) {
+        return std::string(method.via.str.ptr, method.via.str.size);
+    }
+    if (method.type == RPCLIB_MSGPACK::type::POSITIVE_INTEGER) {
+        return RPCLIB_FMT::format("#{:08x}", static_cast<uint32_t>(method.via.u64));
+    }
+    return "<invalid>";
 }
 
 }
@@ -6,7 +6,7 @@
 #include <atomic>
 #include <functional>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 #include "rpc/config.h"
 #include "rpc/msgpack.hpp"
@@ -18,6 +18,7 @@
 #include "rpc/detail/not.h"
 #include "rpc/detail/response.h"
 #include "rpc/detail/make_unique.h"
+#include "rpc/detail/name_id.h"
 
 namespace rpc {
 
@@ -81,10 +82,17 @@ public:
     detail::response dispatch(RPCLIB_MSGPACK::object const &msg,
                               bool suppress_exceptions = false);
 
-    //! \brief This functor type unifies the interfaces of functions that are
-    //!        called remotely
-    using adaptor_type = std::function<std::unique_ptr<RPCLIB_MSGPACK::object_handle>(
-        RPCLIB_MSGPACK::object const &)>;
+    //! \brief Processes a call or notification and packs the response
+    //! straight into a caller-owned buffer.
+    //! \param msg The messagepack object that contains the call.
+    //! \param out Receives the packed response. It is cleared first, so the
+    //! same buffer can be reused for every call without reallocating.
+    //! \param suppress_exceptions If true, exceptions will be caught and
+    //! written as response for the client.
+    //! \returns True if a response was written to out (calls), false if
+    //! there is nothing to send back (notifications).
+    bool dispatch(RPCLIB_MSGPACK::object const &msg, RPCLIB_MSGPACK::sbuffer &out,
+                  bool suppress_exceptions = false);
 
     //! \brief This is the type of messages as per the msgpack-rpc spec.
     using call_t = std::tuple<int8_t, uint32_t, std::string, RPCLIB_MSGPACK::object>;
@@ -93,6 +101,19 @@ public:
     using notification_t = std::tuple<int8_t, std::string, RPCLIB_MSGPACK::object>;
 
 private:
+    using packer_type = RPCLIB_MSGPACK::packer<RPCLIB_MSGPACK::sbuffer>;
+
+    //! \brief A bound functor. The thunk converts the arguments, calls the
+    //! functor and packs its result; it is a plain function pointer, so
+    //! calling it does not allocate.
+    struct handler {
+        uint32_t id;
+        std::string name;
+        std::shared_ptr<void> func;
+        void (*thunk)(handler const &h, RPCLIB_MSGPACK::object const &args,
+                      packer_type &pk);
+    };
+
     //! \brief Checks the argument count and throws an exception if
     //! it is not the expected amount.
     static void enforce_arg_count(std::string const &func, std::size_t found,
@@ -100,20 +121,35 @@ private:
 
     void enforce_unique_name(std::string const &func);
 
+    //! \brief Inserts a handler into the table, which is kept sorted by id.
+    void add_handler(std::string const &name, std::shared_ptr<void> func,
+                     decltype(handler::thunk) thunk);
+
+    //! \brief Finds the handler for a call's method field, which is either
+    //! the function name or its name id. Returns nullptr if none is bound.
+    handler const *find(RPCLIB_MSGPACK::object const &method) const;
+
+    //! \brief Binary search of the handler table by name id.
+    handler const *find(uint32_t id) const;
+
+    //! \brief Describes a method field for error messages.
+    static std::string method_name(RPCLIB_MSGPACK::object const &method);
+
     //! \brief Dispatches a call (which will have a response).
-    detail::response dispatch_call(RPCLIB_MSGPACK::object const &msg,
-                                   bool suppress_exceptions = false);
+    void dispatch_call(RPCLIB_MSGPACK::object const &msg,
+                       RPCLIB_MSGPACK::sbuffer &out,
+                       bool suppress_exceptions = false);
 
     //! \brief Dispatches a notification (which will not have a response)
-    detail::response dispatch_notification(RPCLIB_MSGPACK::object const &msg,
-                                           bool suppress_exceptions = false);
-
-    template <typename T> RPCLIB_MSGPACK::object pack(T &&arg);
+    void dispatch_notification(RPCLIB_MSGPACK::object const &msg,
+                               bool suppress_exceptions = false);
 
     enum class request_type { call = 0, notification = 2 };
 
 private:
-    std::unordered_map<std::string, adaptor_type> funcs_;
+    //! \brief Sorted by id. Bound functors are looked up by binary search,
+    //! names are first turned into their id, so nothing is hashed per call.
+    std::vector<handler> handlers_;
     RPCLIB_CREATE_LOG_CHANNEL(dispatcher)
 };
 }
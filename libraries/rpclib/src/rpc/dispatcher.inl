@@ -1,9 +1,7 @@
-
 namespace rpc {
 namespace detail {
 
 template <typename F> void dispatcher::bind(std::string const &name, F func) {
-    enforce_unique_name(name);
     bind(name, func, typename detail::func_kind_info<F>::result_kind(),
          typename detail::func_kind_info<F>::args_kind());
 }
@@ -12,68 +10,58 @@ template <typename F>
 void dispatcher::bind(std::string const &name, F func,
                       detail::tags::void_result const &,
                       detail::tags::zero_arg const &) {
-    enforce_unique_name(name);
-    funcs_.insert(
-        std::make_pair(name, [func, name](RPCLIB_MSGPACK::object const &args) {
-            enforce_arg_count(name, 0, args.via.array.size);
-            func();
-            return rpc::detail::make_unique<RPCLIB_MSGPACK::object_handle>();
-        }));
+    add_handler(name, std::make_shared<F>(func),
+                [](handler const &h, RPCLIB_MSGPACK::object const &args,
+                   packer_type &pk) {
+        enforce_arg_count(h.name, 0, args.via.array.size);
+        (*static_cast<F *>(h.func.get()))();
+        pk.pack_nil();
+    });
 }
 
 template <typename F>
 void dispatcher::bind(std::string const &name, F func,
                       detail::tags::void_result const &,
                       detail::tags::nonzero_arg const &) {
-    using detail::func_traits;
-    using args_type = typename func_traits<F>::args_type;
-
-    enforce_unique_name(name);
-    funcs_.insert(
-        std::make_pair(name, [func, name](RPCLIB_MSGPACK::object const &args) {
-            constexpr int args_count = std::tuple_size<args_type>::value;
-            enforce_arg_count(name, args_count, args.via.array.size);
-            args_type args_real;
-            args.convert(args_real);
-            detail::call(func, args_real);
-            return rpc::detail::make_unique<RPCLIB_MSGPACK::object_handle>();
-        }));
+    add_handler(name, std::make_shared<F>(func),
+                [](handler const &h, RPCLIB_MSGPACK::object const &args,
+                   packer_type &pk) {
+        using args_type = typename detail::func_traits<F>::args_type;
+        constexpr int args_count = std::tuple_size<args_type>::value;
+        enforce_arg_count(h.name, args_count, args.via.array.size);
+        args_type args_real;
+        args.convert(args_real);
+        detail::call(*static_cast<F *>(h.func.get()), args_real);
+        pk.pack_nil();
+    });
 }
 
 template <typename F>
 void dispatcher::bind(std::string const &name, F func,
                       detail::tags::nonvoid_result const &,
                       detail::tags::zero_arg const &) {
-    using detail::func_traits;
-
-    enforce_unique_name(name);
-    funcs_.insert(std::make_pair(name, [func,
-                                        name](RPCLIB_MSGPACK::object const &args) {
-        enforce_arg_count(name, 0, args.via.array.size);
-        auto z = rpc::detail::make_unique<RPCLIB_MSGPACK::zone>();
-        auto result = RPCLIB_MSGPACK::object(func(), *z);
-        return rpc::detail::make_unique<RPCLIB_MSGPACK::object_handle>(result, std::move(z));
-    }));
+    add_handler(name, std::make_shared<F>(func),
+                [](handler const &h, RPCLIB_MSGPACK::object const &args,
+                   packer_type &pk) {
+        enforce_arg_count(h.name, 0, args.via.array.size);
+        pk.pack((*static_cast<F *>(h.func.get()))());
+    });
 }
 
 template <typename F>
 void dispatcher::bind(std::string const &name, F func,
                       detail::tags::nonvoid_result const &,
                       detail::tags::nonzero_arg const &) {
-    using detail::func_traits;
-    using args_type = typename func_traits<F>::args_type;
-
-    enforce_unique_name(name);
-    funcs_.insert(std::make_pair(name, [func,
-                                        name](RPCLIB_MSGPACK::object const &args) {
+    add_handler(name, std::make_shared<F>(func),
+                [](handler const &h, RPCLIB_MSGPACK::object const &args,
+                   packer_type &pk) {
+        using args_type = typename detail::func_traits<F>::args_type;
         constexpr int args_count = std::tuple_size<args_type>::value;
-        enforce_arg_count(name, args_count, args.via.array.size);
+        enforce_arg_count(h.name, args_count, args.via.array.size);
         args_type args_real;
         args.convert(args_real);
-        auto z = rpc::detail::make_unique<RPCLIB_MSGPACK::zone>();
-        auto result = RPCLIB_MSGPACK::object(detail::call(func, args_real), *z);
-        return rpc::detail::make_unique<RPCLIB_MSGPACK::object_handle>(result, std::move(z));
-    }));
+        pk.pack(detail::call(*static_cast<F *>(h.func.get()), args_real));
+    });
 }
 }
 }